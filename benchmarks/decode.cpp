@@ -13,8 +13,9 @@
 #include "../external/s_indexes/include/s_index.hpp"
 #include "../external/s_indexes/include/decode.hpp"
 
-#define INDEXES                                                       \
-    (pef_opt)(bic)(maskedvbyte)(optpfor)(simple16)(qmx)(delta)(rice)( \
+#define INDEXES                                                         \
+    (pef_opt)(bic)(maskedvbyte)(optpfor)(simdfastpfor)(simdbp128)(      \
+        simple16)(qmx)(delta)(rice)(rice_table)(tans)(                  \
         single_packed_dint)(opt_vbyte)
 
 void perftest_slicing(char const* index_filename) {
@@ -1,4 +1,6 @@
+#include <fstream>
 #include <iostream>
+#include <memory>
 
 #include <boost/algorithm/string/classification.hpp>
 #include <boost/algorithm/string/split.hpp>
@@ -6,6 +8,7 @@
 #include <succinct/mapper.hpp>
 
 #include "index_types.hpp"
+#include "query_cache.hpp"
 #include "util.hpp"
 #include "test_common.hpp"
 
@@ -18,7 +21,7 @@
 using namespace ds2i;
 
 void perftest_slicing(const char* index_filename, uint32_t num_queries,
-                      essentials::json_lines& log) {
+                      essentials::json_lines& log, std::ostream* times_out) {
     std::vector<term_id_vec> queries;
     queries.reserve(num_queries);
     term_id_vec q;
@@ -43,10 +46,12 @@ void perftest_slicing(const char* index_filename, uint32_t num_queries,
 
     std::cout << "Executing " << num_queries << " OR queries" << std::endl;
     essentials::timer_type t;
+    std::vector<double> musecs;
     for (int run = 0; run != testing::runs; ++run) {
         t.start();
 
         for (uint32_t i = 0; i != num_queries; ++i) {
+            auto query_tick = get_time_usecs();
             uint64_t size = 0;
             // if (queries[i].size() == 1) {
             //     size = index[queries[i][0]].decode(out.data());
@@ -61,6 +66,7 @@ void perftest_slicing(const char* index_filename, uint32_t num_queries,
                 }
                 size = sliced::union_many(sequences, out.data());
             }
+            if (run != 0) musecs.push_back(get_time_usecs() - query_tick);
             total += size;
         }
 
@@ -70,11 +76,13 @@ void perftest_slicing(const char* index_filename, uint32_t num_queries,
 
     double avg_ms_per_query = (avg / num_queries) / 1000;
     log.add("avg_ms_per_query", std::to_string(avg_ms_per_query));
+    log_query_times(musecs, num_queries, log, times_out);
 }
 
 template <typename Enum>
 size_t boolean_or_query(uint32_t num_docs, std::vector<Enum>& enums,
-                        std::vector<uint32_t>& out) {
+                        std::vector<uint32_t>& out,
+                        bulk_or_merger& /* merger */, std::false_type) {
     uint32_t cur_doc = std::min_element(enums.begin(), enums.end(),
                                         [](auto const& l, auto const& r) {
                                             return l.docid() < r.docid();
@@ -95,9 +103,34 @@ size_t boolean_or_query(uint32_t num_docs, std::vector<Enum>& enums,
     return size;
 }
 
+// the lists of the Elias-Fano indexes are decoded in bulk and merged as
+// arrays
+template <typename Enum>
+size_t boolean_or_query(uint32_t num_docs, std::vector<Enum>& enums,
+                        std::vector<uint32_t>& out, bulk_or_merger& merger,
+                        std::true_type) {
+    return merger(enums, num_docs, out.data());
+}
+
+template <typename Enum>
+size_t boolean_or_query(uint32_t num_docs, std::vector<Enum>& enums,
+                        std::vector<uint32_t>& out, bulk_or_merger& merger) {
+    return boolean_or_query(num_docs, enums, out, merger,
+                            typename has_bulk_decode<Enum>::type());
+}
+
+// the roaring lists are merged a container at a time by CRoaring
+size_t boolean_or_query(uint32_t /* num_docs */,
+                        std::vector<roaring_index::document_enumerator>& enums,
+                        std::vector<uint32_t>& out,
+                        bulk_or_merger& /* merger */) {
+    return roaring_union(enums, out.data());
+}
+
 template <typename Index>
 void perftest(const char* index_filename, uint32_t num_queries,
-              essentials::json_lines& log) {
+              essentials::json_lines& log, query_cache* cache,
+              std::ostream* times_out) {
     using namespace ds2i;
 
     LOAD_INDEX
@@ -121,17 +154,30 @@ void perftest(const char* index_filename, uint32_t num_queries,
 
     typedef typename Index::document_enumerator enum_type;
     std::vector<enum_type> qq;
+    bulk_or_merger merger;
 
     std::cout << "Executing " << num_queries << " OR queries" << std::endl;
     essentials::timer_type t;
+    cached_result cached;
+    std::vector<double> musecs;
     for (int run = 0; run != testing::runs; ++run) {
+        if (cache) cache->clear();
         t.start();
         for (uint32_t i = 0; i != num_queries; ++i) {
-            qq.clear();
-            for (auto term : queries[i]) {
-                qq.push_back(index[term]);
+            auto query_tick = get_time_usecs();
+            uint64_t size = 0;
+            // queries are already sorted and without duplicates
+            if (cache && cache->lookup(queries[i], cached)) {
+                size = cached.results;
+            } else {
+                qq.clear();
+                for (auto term : queries[i]) {
+                    qq.push_back(index[term]);
+                }
+                size = boolean_or_query(num_docs, qq, out, merger);
+                if (cache) cache->insert(queries[i], cached_result{size, {}});
             }
-            uint64_t size = boolean_or_query(num_docs, qq, out);
+            if (run != 0) musecs.push_back(get_time_usecs() - query_tick);
             total += size;
             // for (uint64_t i = 0; i != size; ++i) {
             //     std::cout << out[i] << "\n";
@@ -143,6 +189,11 @@ void perftest(const char* index_filename, uint32_t num_queries,
 
     double avg_ms_per_query = (avg / num_queries) / 1000;
     log.add("avg_ms_per_query", std::to_string(avg_ms_per_query));
+    log_query_times(musecs, num_queries, log, times_out);
+    if (cache) {  // hit rate of the last run
+        log.add("cache_policy", cache->policy_name());
+        log.add("cache_hit_rate", std::to_string(cache->hit_rate()));
+    }
 }
 
 int main(int argc, const char** argv) {
@@ -151,7 +202,9 @@ int main(int argc, const char** argv) {
     int mandatory = 4;
     if (argc < mandatory) {
         std::cerr << argv[0]
-                  << " index_type index_filename num_queries < query_log"
+                  << " index_type index_filename num_queries "
+                     "[--cache <policy>:<MiB>] [--cache-train <query_log>] "
+                     "[--dump-times <filename>] < query_log"
                   << std::endl;
         return 1;
     }
@@ -160,13 +213,55 @@ int main(int argc, const char** argv) {
     const char* index_filename = argv[2];
     uint32_t num_queries = std::atoi(argv[3]);
 
+    std::unique_ptr<query_cache> cache;
+    std::vector<term_id_vec> cache_training;
+    std::ofstream times_file;
+    std::ostream* times_out = nullptr;
+    for (int i = mandatory; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--cache" && i + 1 < argc) {
+            std::vector<std::string> values;
+            std::string spec = argv[++i];
+            boost::algorithm::split(values, spec, boost::is_any_of(":"));
+            if (values.size() != 2) {
+                throw std::invalid_argument("Cache must be <policy>:<MiB>");
+            }
+            cache.reset(
+                new query_cache(query_cache::parse_policy(values[0]),
+                                std::stoull(values[1]) * constants::MiB));
+        } else if (arg == "--cache-train" && i + 1 < argc) {
+            cache_training = read_queries(argv[++i]);
+        } else if (arg == "--dump-times" && i + 1 < argc) {
+            times_file.open(argv[++i]);
+            times_out = &times_file;
+        } else {
+            // a bare <policy>:<MiB>, as the cache used to be given, would
+            // otherwise run the benchmark without a cache
+            throw std::invalid_argument(
+                "Unknown argument " + arg +
+                " (the cache is given as --cache <policy>:<MiB>)");
+        }
+    }
+
+    // the static part of static_dynamic is trained on a separate log, or
+    // all its hits on the replayed queries would be guaranteed
+    if (cache) {
+        if (cache->policy() == query_cache::policy_type::static_dynamic &&
+            cache_training.empty()) {
+            throw std::invalid_argument(
+                "The static_dynamic cache needs a training log other than "
+                "the replayed one: --cache-train <query_log>");
+        }
+        cache->set_static_queries(cache_training, false);
+    }
+
     essentials::json_lines log;
     log.new_line();
     log.add("index_type", index_type);
     log.add("query_type", "or");
 
     if (index_type == "slicing") {
-        perftest_slicing(index_filename, num_queries, log);
+        perftest_slicing(index_filename, num_queries, log, times_out);
         log.print();
         return 0;
     }
@@ -175,12 +270,17 @@ int main(int argc, const char** argv) {
 #define LOOP_BODY(R, DATA, T)                                                \
     }                                                                        \
     else if (index_type == BOOST_PP_STRINGIZE(T)) {                          \
-        perftest<BOOST_PP_CAT(T, _index)>(index_filename, num_queries, log); \
+        perftest<BOOST_PP_CAT(T, _index)>(index_filename, num_queries, log,  \
+                                          cache.get(), times_out);           \
         /**/
 
         BOOST_PP_SEQ_FOR_EACH(LOOP_BODY, _, DS2I_INDEX_TYPES);
 #undef LOOP_BODY
-    } else {
+    } else if (!with_paired_index_type(index_type, [&](auto tag) {
+                   perftest<typename decltype(tag)::type>(
+                       index_filename, num_queries, log, cache.get(),
+                       times_out);
+               })) {
         logger() << "ERROR: Unknown index type " << index_type << std::endl;
     }
     log.print();
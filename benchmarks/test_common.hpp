@@ -25,6 +25,22 @@ bool read_query_and_remove_duplicates(term_id_vec& ret,
     return true;
 }
 
+// Adds the distribution of the per-query times (in microseconds, stored
+// run after run) to the log and, if requested, dumps them as
+// <query_id> <musec> lines.
+void log_query_times(std::vector<double> const& musecs, uint32_t num_queries,
+                     essentials::json_lines& log, std::ostream* times_out) {
+    latency_distribution(musecs).for_each_stat(
+        [&](const char* name, double value) {
+            log.add(name, std::to_string(value));
+        });
+    if (times_out) {
+        for (size_t i = 0; i != musecs.size(); ++i) {
+            *times_out << i % num_queries << '\t' << musecs[i] << '\n';
+        }
+    }
+}
+
 #define LOAD_INDEX                                          \
     Index index;                                            \
     boost::iostreams::mapped_file_source m(index_filename); \
@@ -0,0 +1,106 @@
+#include <iostream>
+#include <random>
+
+#include "util.hpp"
+#include "test_common.hpp"
+
+using namespace ds2i;
+
+// The float-only binary heap used by the ranked operators before
+// topk_queue kept docids, as a baseline.
+struct binary_heap_topk_queue {
+    binary_heap_topk_queue(uint64_t k)
+        : m_k(k) {}
+
+    bool insert(float score, uint64_t /* docid */) {
+        if (m_q.size() < m_k) {
+            m_q.push_back(score);
+            std::push_heap(m_q.begin(), m_q.end(), std::greater<float>());
+            return true;
+        } else {
+            if (score > m_q.front()) {
+                std::pop_heap(m_q.begin(), m_q.end(), std::greater<float>());
+                m_q.back() = score;
+                std::push_heap(m_q.begin(), m_q.end(), std::greater<float>());
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void finalize() {
+        std::sort_heap(m_q.begin(), m_q.end(), std::greater<float>());
+    }
+
+    std::vector<float> const& topk() const {
+        return m_q;
+    }
+
+    void clear() {
+        m_q.clear();
+    }
+
+private:
+    uint64_t m_k;
+    std::vector<float> m_q;
+};
+
+template <typename Queue>
+void perftest(std::string const& queue_type, uint64_t k,
+              std::string const& distribution,
+              std::vector<float> const& scores) {
+    Queue queue(k);
+    size_t total = 0;
+    essentials::timer_type t;
+    for (int run = 0; run != testing::runs; ++run) {
+        t.start();
+        queue.clear();
+        for (size_t i = 0; i != scores.size(); ++i) {
+            total += queue.insert(scores[i], i);
+        }
+        queue.finalize();
+        t.stop();
+        total += queue.topk().size();
+    }
+    std::cout << "Ignore: " << total << std::endl;
+    t.discard_first();
+
+    essentials::json_lines log;
+    log.new_line();
+    log.add("queue_type", queue_type);
+    log.add("k", std::to_string(k));
+    log.add("distribution", distribution);
+    log.add("num_scores", std::to_string(scores.size()));
+    log.add("avg_ns_per_insert",
+            std::to_string(t.average() * 1000 / scores.size()));
+    log.print();
+}
+
+int main(int argc, const char** argv) {
+    uint64_t num_scores = 10000000;
+    if (argc > 1) {
+        num_scores = std::stoull(argv[1]);
+    }
+
+    std::mt19937_64 rng(13);
+    std::vector<float> random_scores(num_scores);
+    // BM25 scores are mostly low with a long tail of high ones
+    std::exponential_distribution<float> dist(1.0);
+    for (auto& s : random_scores) s = dist(rng);
+
+    // worst case: every score enters the queue
+    std::vector<float> increasing_scores(random_scores);
+    std::sort(increasing_scores.begin(), increasing_scores.end());
+
+    for (uint64_t k : {10, 100, 1000}) {
+        for (auto const& d :
+             {std::make_pair("random", &random_scores),
+              std::make_pair("increasing", &increasing_scores)}) {
+            perftest<binary_heap_topk_queue>("binary_heap", k, d.first,
+                                             *d.second);
+            perftest<topk_queue>("topk_queue", k, d.first, *d.second);
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,319 @@
+#pragma once
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <unordered_map>
+
+#include <succinct/mappable_vector.hpp>
+
+#if defined(__SSSE3__)
+#include <tmmintrin.h>
+#endif
+
+#include "dint_configuration.hpp"
+#include "hash_utils.hpp"
+#include "util.hpp"
+
+namespace ds2i {
+
+// Dictionary for codewords of 8 bits: each entry is packed in a slot of 16
+// bytes with the smallest width (1, 2 or 4 bytes) that fits its values, so
+// that the 256 entries take 4KB and stay in L1. An entry is expanded with
+// one load and a byte shuffle per 4 integers, with the shuffle masks of its
+// width; the entries that do not fit in a slot (more than 8 values of 16
+// bits, or more than 4 of 32 bits) are not added.
+template <uint32_t t_num_entries, uint32_t t_max_entry_size>
+struct compact_dictionary {
+    static_assert(t_max_entry_size == 16,
+                  "Each of the 16 bytes of a slot can be a value");
+    static_assert(t_num_entries <= 256, "The codewords must fit in 8 bits");
+    static const uint32_t num_entries = t_num_entries;
+    static const uint32_t max_entry_size = t_max_entry_size;
+    static const uint32_t invalid_index = uint32_t(-1);
+    static const uint32_t reserved = EXCEPTIONS + 5;
+
+    static const uint32_t slot_bytes = 16;
+    static const uint32_t widths = 3;  // 1, 2 and 4 bytes per value
+    // an entry descriptor has the entry size (up to 256 for the runs) in
+    // the low bits and the width code above them
+    static const uint32_t width_shift = 9;
+    static const uint32_t size_mask = (uint32_t(1) << width_shift) - 1;
+
+    static uint32_t width_code(uint32_t const* entry, uint32_t entry_size) {
+        uint32_t max = *std::max_element(entry, entry + entry_size);
+        if (max < (uint32_t(1) << 8)) return 0;
+        if (max < (uint32_t(1) << 16)) return 1;
+        return 2;
+    }
+
+    static uint32_t width_bytes(uint32_t code) {
+        return uint32_t(1) << code;
+    }
+
+    struct builder {
+        static const uint32_t num_entries = compact_dictionary::num_entries;
+        static const uint32_t max_entry_size =
+            compact_dictionary::max_entry_size;
+        static const uint32_t invalid_index =
+            compact_dictionary::invalid_index;
+        static const uint32_t reserved = compact_dictionary::reserved;
+
+        builder() : m_size(reserved) {}
+
+        void init() {
+            m_size = reserved;
+            m_descriptors.assign(num_entries, 0);
+            m_slots.assign(num_entries * slot_bytes, 0);
+
+            // the exceptions are not copied, the runs are slots of 0s
+            for (uint32_t i = 0; i != EXCEPTIONS; ++i) {
+                m_descriptors[i] = 1;
+            }
+            for (uint32_t i = EXCEPTIONS, size = 256; i != reserved;
+                 ++i, size /= 2) {
+                m_descriptors[i] = size;
+            }
+        }
+
+        size_t load_from_file(std::string dict_file) {
+            std::ifstream ifs(dict_file);
+            return load(ifs);
+        }
+
+        bool try_store_to_file(std::string dict_file) const {
+            std::ofstream ofs(dict_file);
+            if (ofs) {
+                write(ofs);
+                return true;
+            }
+            return false;
+        }
+
+        void write(std::ofstream& dictionary_file) const {
+            dictionary_file.write(reinterpret_cast<char const*>(&m_size),
+                                  sizeof(uint32_t));
+            dictionary_file.write(
+                reinterpret_cast<char const*>(m_descriptors.data()),
+                m_size * sizeof(uint16_t));
+            dictionary_file.write(reinterpret_cast<char const*>(m_slots.data()),
+                                  m_size * slot_bytes);
+        }
+
+        size_t load(std::ifstream& dictionary_file) {
+            uint32_t size = 0;
+            dictionary_file.read(reinterpret_cast<char*>(&size),
+                                 sizeof(uint32_t));
+            init();
+            m_size = size;
+            dictionary_file.read(reinterpret_cast<char*>(m_descriptors.data()),
+                                 m_size * sizeof(uint16_t));
+            dictionary_file.read(reinterpret_cast<char*>(m_slots.data()),
+                                 m_size * slot_bytes);
+            return sizeof(uint32_t) +
+                   m_size * (sizeof(uint16_t) + slot_bytes);
+        }
+
+        bool full() {
+            return m_size == num_entries;
+        }
+
+        bool append(uint32_t const* entry, uint32_t entry_size,
+                    uint32_t /*dictionary_id*/) {
+            assert(entry_size > 0 and entry_size <= max_entry_size);
+            if (full()) {
+                return false;
+            }
+            uint32_t code = width_code(entry, entry_size);
+            uint32_t bytes = width_bytes(code);
+            if (entry_size * bytes > slot_bytes) {
+                return false;
+            }
+
+            // little-endian values of the given width
+            uint8_t* slot = &m_slots[m_size * slot_bytes];
+            for (uint32_t i = 0; i != entry_size; ++i) {
+                memcpy(slot + i * bytes, entry + i, bytes);
+            }
+            m_descriptors[m_size] = uint16_t(entry_size | code << width_shift);
+            ++m_size;
+            return true;
+        }
+
+        void build() {}
+
+        void prepare_for_encoding() {
+            std::vector<uint32_t> run(256, 0);
+            uint32_t i = EXCEPTIONS;
+            for (uint32_t n = 256; n >= 16; n /= 2, ++i) {
+                uint64_t hash = hash_bytes64(run.data(), n);
+                m_map[hash] = i;
+            }
+            uint32_t entry[max_entry_size];
+            for (; i < size(); ++i) {
+                uint32_t entry_size = get(i, entry);
+                uint64_t hash = hash_bytes64(entry, entry_size);
+                m_map[hash] = i;
+            }
+        }
+
+        uint32_t lookup(uint32_t const* begin, uint32_t entry_size) const {
+            uint64_t hash = hash_bytes64(begin, entry_size);
+            auto it = m_map.find(hash);
+            if (it != m_map.end()) {
+                assert((*it).second < num_entries);
+                return (*it).second;
+            }
+            return invalid_index;
+        }
+
+        void build(compact_dictionary& dict) {
+            dict.m_descriptors.steal(m_descriptors);
+            dict.m_slots.steal(m_slots);
+            builder().swap(*this);
+        }
+
+        void swap(builder& other) {
+            std::swap(m_size, other.m_size);
+            m_descriptors.swap(other.m_descriptors);
+            m_slots.swap(other.m_slots);
+            m_map.swap(other.m_map);
+        }
+
+        uint32_t size() const {
+            return m_size;
+        }
+
+        static std::string type() {
+            return "compact";
+        }
+
+        // print vocabulary entries usage
+        void print_usage() {
+            std::vector<uint32_t> entries(widths);
+            for (uint32_t i = reserved; i < size(); ++i) {
+                ++entries[m_descriptors[i] >> width_shift];
+            }
+            for (uint32_t code = 0; code != widths; ++code) {
+                std::cout << "entries of " << width_bytes(code)
+                          << "-byte values: " << entries[code] << " ("
+                          << entries[code] * 100.0 / num_entries << "%)"
+                          << std::endl;
+            }
+        }
+
+        // writes the values of entry i to out and returns its size
+        uint32_t get(uint32_t i, uint32_t* out) const {
+            assert(i < size());
+            uint32_t entry_size = m_descriptors[i] & size_mask;
+            uint32_t bytes = width_bytes(m_descriptors[i] >> width_shift);
+            uint8_t const* slot = &m_slots[i * slot_bytes];
+            for (uint32_t j = 0; j != entry_size; ++j) {
+                out[j] = 0;
+                memcpy(out + j, slot + j * bytes, bytes);
+            }
+            return entry_size;
+        }
+
+    private:
+        uint32_t m_size;
+        std::vector<uint16_t> m_descriptors;
+        std::vector<uint8_t> m_slots;
+
+        // map from hash codes to table indexes, used during encoding
+        std::unordered_map<uint64_t, uint32_t> m_map;
+    };
+
+    compact_dictionary() {}
+
+    // writes max_entry_size integers to out, of which the first returned
+    // ones are the entry (the runs longer than max_entry_size rely on the
+    // output being zeroed, as with the other dictionaries)
+    uint32_t copy(uint32_t i, uint32_t* out) const {
+#if defined(__SSSE3__)
+        return copy_ssse3(i, out);
+#else
+        return copy_scalar(i, out);
+#endif
+    }
+
+    // the implementations of copy(), both available to test them against
+    // each other
+    uint32_t copy_scalar(uint32_t i, uint32_t* out) const {
+        assert(i < num_entries);
+        uint32_t descriptor = m_descriptors[i];
+        uint8_t const* slot = &m_slots[i * slot_bytes];
+        uint32_t bytes = width_bytes(descriptor >> width_shift);
+        for (uint32_t j = 0; j != max_entry_size; ++j) {
+            out[j] = 0;
+            if ((j + 1) * bytes <= slot_bytes) {
+                memcpy(out + j, slot + j * bytes, bytes);
+            }
+        }
+        return descriptor & size_mask;
+    }
+
+#if defined(__SSSE3__)
+    uint32_t copy_ssse3(uint32_t i, uint32_t* out) const {
+        assert(i < num_entries);
+        uint32_t descriptor = m_descriptors[i];
+        uint8_t const* slot = &m_slots[i * slot_bytes];
+        __m128i const* masks =
+            shuffle_masks::get().masks[descriptor >> width_shift];
+        __m128i data = _mm_loadu_si128(reinterpret_cast<__m128i const*>(slot));
+        __m128i* dst = reinterpret_cast<__m128i*>(out);
+        _mm_storeu_si128(dst + 0, _mm_shuffle_epi8(data, masks[0]));
+        _mm_storeu_si128(dst + 1, _mm_shuffle_epi8(data, masks[1]));
+        _mm_storeu_si128(dst + 2, _mm_shuffle_epi8(data, masks[2]));
+        _mm_storeu_si128(dst + 3, _mm_shuffle_epi8(data, masks[3]));
+        return descriptor & size_mask;
+    }
+#endif
+
+    void swap(compact_dictionary& other) {
+        m_descriptors.swap(other.m_descriptors);
+        m_slots.swap(other.m_slots);
+    }
+
+    template <typename Visitor>
+    void map(Visitor& visit) {
+        visit(m_descriptors, "m_descriptors")(m_slots, "m_slots");
+    }
+
+private:
+#if defined(__SSSE3__)
+    // for each width, the masks that move each value of the slot to the
+    // low bytes of its 32-bit lane and zero the others (0x80)
+    struct shuffle_masks {
+        __m128i masks[widths][max_entry_size / 4];
+
+        shuffle_masks() {
+            for (uint32_t code = 0; code != widths; ++code) {
+                uint32_t bytes = width_bytes(code);
+                for (uint32_t k = 0; k != max_entry_size / 4; ++k) {
+                    alignas(16) uint8_t mask[16];
+                    for (uint32_t b = 0; b != 16; ++b) {
+                        uint32_t value = 4 * k + b / 4;
+                        uint32_t byte = value * bytes + b % 4;
+                        bool inside = b % 4 < bytes and
+                                      (value + 1) * bytes <= slot_bytes;
+                        mask[b] = inside ? uint8_t(byte) : 0x80;
+                    }
+                    masks[code][k] = _mm_load_si128(
+                        reinterpret_cast<__m128i const*>(mask));
+                }
+            }
+        }
+
+        static shuffle_masks const& get() {
+            static const shuffle_masks instance;
+            return instance;
+        }
+    };
+#endif
+
+    succinct::mapper::mappable_vector<uint16_t> m_descriptors;
+    succinct::mapper::mappable_vector<uint8_t> m_slots;
+};
+}  // namespace ds2i
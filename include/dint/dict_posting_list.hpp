@@ -1,6 +1,7 @@
 #pragma once
 
 #include "succinct/util.hpp"
+#include "prefix_sum.hpp"
 #include "util.hpp"
 
 namespace ds2i {
@@ -108,8 +109,7 @@ struct dict_posting_list {
             uint32_t max = ((uint32_t const*)block_maxs)[i];
             Coder::decode(*docs_dict, ptr, out,
                           max - cur_base - (block_size - 1), block_size);
-
-            PREFIX_SUM
+            prefix_sum_d1(out, block_size, cur_base);
 
             endpoint = ((uint32_t const*)block_endpoints)[i];
             out += block_size;
@@ -121,8 +121,7 @@ struct dict_posting_list {
         uint32_t max = ((uint32_t const*)block_maxs)[blocks - 1];
         uint32_t size = n - (blocks - 1) * block_size;
         Coder::decode(*docs_dict, ptr, out, max - cur_base - (size - 1), size);
-
-        PREFIX_SUM
+        prefix_sum_d1(out, size, cur_base);
 
         out += size;
         return uint32_t(out - in);
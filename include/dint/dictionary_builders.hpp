@@ -64,10 +64,18 @@ struct decreasing_static_frequencies {
                 n = stats.blocks[s].size();
             }
 
-            auto it = stats.blocks[s].begin();
-            for (uint64_t i = 0; i != n; ++i, ++it) {
+            // the dictionaries can reject an entry that does not fit their
+            // layout: the next candidates take its place
+            uint64_t appended = 0;
+            for (auto it = stats.blocks[s].begin();
+                 it != stats.blocks[s].end() and appended != n and
+                 !dict_builder.full();
+                 ++it) {
                 auto const& block = *it;
-                dict_builder.append(block.data.data(), block.data.size(), s);
+                if (dict_builder.append(block.data.data(), block.data.size(),
+                                        s)) {
+                    ++appended;
+                }
             }
         }
 
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "dint_configuration.hpp"
+#include "compact_dictionary.hpp"
 #include "rectangular_dictionary.hpp"
 #include "single_dictionary.hpp"
 #include "multi_dictionary.hpp"
@@ -15,6 +16,9 @@ using single_dictionary_packed_type =
 using single_dictionary_overlapped_type =
     single_dictionary<constants::num_entries, constants::max_entry_size,
                       overlap_policy>;
+using single_dictionary_compact_type =
+    compact_dictionary<constants::compact_num_entries,
+                       constants::max_entry_size>;
 
 using multi_dictionary_packed_type =
     multi_dictionary<constants::num_entries, constants::max_entry_size,
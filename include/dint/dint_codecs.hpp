@@ -6,9 +6,14 @@
 
 namespace ds2i {
 
-struct dint_block {
+// Decoder of the blocks of codewords of type Codeword (uint16_t, or
+// uint8_t for dictionaries of 256 entries); the exceptions follow their
+// codeword.
+template <typename Codeword>
+struct basic_dint_block {
     static const uint64_t block_size = constants::block_size;
     static const uint64_t overflow = 256;
+    static const uint32_t codeword_bits = 8 * sizeof(Codeword);
 
     template <typename Dictionary>
     static uint8_t const* decode(Dictionary const& dict, uint8_t const* in,
@@ -18,8 +23,7 @@ struct dint_block {
             return interpolative_block::decode(in, out, sum_of_values, n);
         }
 
-        uint16_t const* ptr = reinterpret_cast<uint16_t const*>(in);
-        // uint8_t const* ptr = in; // if b = 8
+        Codeword const* ptr = reinterpret_cast<Codeword const*>(in);
         for (size_t i = 0; i != n; ++ptr) {
             uint32_t index = *ptr;
             uint32_t decoded_ints = 1;
@@ -27,16 +31,11 @@ struct dint_block {
                 decoded_ints = dict.copy(index, out);
             } else {
                 if (index == 1) {  // 4-byte exception
-                    *out = *(reinterpret_cast<uint32_t const*>(++ptr));
-                    ++ptr;
-                    // if b = 8
-                    // *out = *(reinterpret_cast<uint32_t const*>(++ptr));
-                    // ptr += 3;
+                    *out = *(reinterpret_cast<uint32_t const*>(ptr + 1));
+                    ptr += 4 / sizeof(Codeword);
                 } else {  // 2-byte exception
-                    *out = *(++ptr);
-                    // if b = 8
-                    // *out = *(reinterpret_cast<uint16_t const*>(++ptr));
-                    // ptr += 1;
+                    *out = *(reinterpret_cast<uint16_t const*>(ptr + 1));
+                    ptr += 2 / sizeof(Codeword);
                 }
             }
             out += decoded_ints;
@@ -44,11 +43,11 @@ struct dint_block {
         }
 
         return reinterpret_cast<uint8_t const*>(ptr);
-        // if b = 8
-        // return ptr;
     }
 };
 
+typedef basic_dint_block<uint16_t> dint_block;
+
 struct greedy_dint_single_dict_block {
     static const uint64_t block_size = constants::block_size;
     static const uint64_t overflow = dint_block::overflow;
@@ -138,17 +137,25 @@ private:
     }
 };
 
-struct opt_dint_single_dict_block {
+// Optimal parsing of the blocks into codewords of type Codeword, with a
+// single dictionary.
+template <typename Codeword>
+struct basic_opt_dint_single_dict_block {
     static const uint64_t block_size = constants::block_size;
-    static const uint64_t overflow = dint_block::overflow;
+    static const uint64_t overflow = basic_dint_block<Codeword>::overflow;
 
+    // the costs are in bytes: a codeword of b bits, followed by 2 or 4
+    // bytes for the exceptions
     template <typename Builder>
     static void encode(Builder& builder, uint32_t const* begin, uint64_t n,
                        std::vector<uint8_t>& out, uint32_t b) {
+        uint32_t codeword_cost = b / 8;
+        uint32_t small_exception_cost = codeword_cost + 2;
+        uint32_t large_exception_cost = codeword_cost + 4;
         std::vector<node> path(n + 2);
         path[0] = {0, 1, 0};  // dummy node
         for (uint32_t i = 1; i < n + 1; ++i) {
-            path[i] = {i - 1, 1, 3 * i};
+            path[i] = {i - 1, 1, large_exception_cost * i};
         }
 
         for (uint32_t i = 0; i < n; ++i) {
@@ -171,7 +178,7 @@ struct opt_dint_single_dict_block {
                     ++index;
                 }
                 while (k >= 16) {
-                    uint32_t c = path[i].cost + 1;
+                    uint32_t c = path[i].cost + codeword_cost;
                     if (path[i + k].cost > c) {
                         path[i + k] = {i, index, c};
                     }
@@ -186,18 +193,18 @@ struct opt_dint_single_dict_block {
                 uint32_t len = std::min<uint32_t>(sub_block_size, n - i);
                 index = builder.lookup(begin + i, len);
                 if (index != Builder::invalid_index) {
-                    uint32_t c = path[i].cost + 1;
+                    uint32_t c = path[i].cost + codeword_cost;
                     if (path[i + len].cost > c) {
                         path[i + len] = {i, index, c};
                     }
                 } else {
                     if (sub_block_size == 1) {  // exceptions
                         uint32_t exception = begin[i];
-                        uint32_t c = path[i].cost + 2;  // small exception cost
+                        uint32_t c = path[i].cost + small_exception_cost;
                         index = 0;
 
                         if (exception > 65536 - 1) {
-                            c += 1;  // large exception cost
+                            c = path[i].cost + large_exception_cost;
                             index = 1;
                         }
 
@@ -263,14 +270,15 @@ struct opt_dint_single_dict_block {
             return;
         }
 
-        encode(builder, in, n, out, constants::log2_num_entries);
+        encode(builder, in, n, out, basic_dint_block<Codeword>::codeword_bits);
     }
 
     template <typename Dictionary>
     static uint8_t const* decode(Dictionary const& dict, uint8_t const* in,
                                  uint32_t* out, uint32_t sum_of_values,
                                  size_t n) {
-        return dint_block::decode(dict, in, out, sum_of_values, n);
+        return basic_dint_block<Codeword>::decode(dict, in, out,
+                                                  sum_of_values, n);
     }
 
 private:
@@ -282,6 +290,10 @@ private:
     }
 };
 
+typedef basic_opt_dint_single_dict_block<uint16_t> opt_dint_single_dict_block;
+// 8-bit codewords, for dictionaries of 256 entries
+typedef basic_opt_dint_single_dict_block<uint8_t> opt_dint8_single_dict_block;
+
 struct opt_dint_multi_dict_block {
     static const uint64_t block_size = constants::block_size;
     static const uint64_t overflow = dint_block::overflow;
@@ -26,5 +26,9 @@ static const uint32_t target_sizes[] = {16, 8, 4, 2, 1};
 static const uint32_t num_entries = 65536;
 static const uint32_t log2_num_entries = 16;
 static const uint32_t num_target_sizes = std::log2(max_entry_size) + 1;
+
+// b = 8, for compact_dictionary
+static const uint32_t compact_num_entries = 256;
+static const uint32_t log2_compact_num_entries = 8;
 }  // namespace constants
 }  // namespace ds2i
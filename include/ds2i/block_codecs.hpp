@@ -1,5 +1,7 @@
 #pragma once
 
+#include <numeric>
+
 #include "FastPFor/headers/VarIntG8IU.h"
 #include "FastPFor/headers/optpfor.h"
 #include "FastPFor/headers/variablebyte.h"
@@ -13,9 +15,14 @@
 #include "varintgb.h"
 #include "interpolative_coding.hpp"
 
+#include "bytes_bit_writer.hpp"
 #include "qmx_codec.hpp"
+#include "prefix_sum.hpp"
+#include "simd_bitpacking.hpp"
 #include "succinct/util.hpp"
 #include "integer_codes.hpp"
+#include "table_codes.hpp"
+#include "tans.hpp"
 #include "util.hpp"
 #include "tables.hpp"
 
@@ -109,8 +116,25 @@ public:
     }
 };
 
-struct interpolative_block {
-    static const uint64_t block_size = constants::block_size;
+// Appends to out what encode(ptr) writes at ptr, at most max_bytes bytes,
+// given that it returns how many it wrote: the block is encoded in place
+// at the end of the output, which keeps its capacity from block to block.
+template <typename Encoder>
+inline void encode_in_place(std::vector<uint8_t>& out, size_t max_bytes,
+                            Encoder encode) {
+    size_t begin = out.size();
+    out.resize(begin + max_bytes);
+    size_t written = encode(out.data() + begin);
+    assert(written <= max_bytes);
+    out.resize(begin + written);
+}
+
+// The codecs templated on BlockSize have a typedef for the default
+// constants::block_size (for example basic_optpfor_block<BlockSize> and
+// optpfor_block).
+template <uint64_t BlockSize>
+struct basic_interpolative_block {
+    static const uint64_t block_size = BlockSize;
     static const uint64_t overflow = 0;
 
     static void encode(uint32_t const* in, uint32_t sum_of_values, size_t n,
@@ -159,8 +183,14 @@ struct interpolative_block {
     }
 };
 
-struct optpfor_block {
-    struct codec_type : FastPFor::OPTPFor<4, FastPFor::Simple16<false>> {
+typedef basic_interpolative_block<constants::block_size> interpolative_block;
+
+template <uint64_t BlockSize>
+struct basic_optpfor_block {
+    static_assert(BlockSize % 32 == 0, "OptPFor packs groups of 32 integers");
+
+    struct codec_type
+        : FastPFor::OPTPFor<BlockSize / 32, FastPFor::Simple16<false>> {
         uint8_t const* force_b;
 
         uint32_t findBestB(const uint32_t* in, uint32_t len) {
@@ -174,6 +204,7 @@ struct optpfor_block {
             uint32_t b = 0;
             uint32_t bsize = std::numeric_limits<uint32_t>::max();
             const uint32_t mb = FastPFor::maxbits(in, in + len);
+            auto const& possLogs = codec_type::possLogs;
             uint32_t i = 0;
             while (mb > 28 + possLogs[i])
                 ++i;  // some schemes such as Simple16 don't code numbers
@@ -181,7 +212,7 @@ struct optpfor_block {
 
             for (; i < possLogs.size(); i++) {
                 if (possLogs[i] > mb && possLogs[i] >= mb) break;
-                const uint32_t csize = tryB(possLogs[i], in, len);
+                const uint32_t csize = this->tryB(possLogs[i], in, len);
 
                 if (csize <= bsize) {
                     b = possLogs[i];
@@ -192,7 +223,7 @@ struct optpfor_block {
         }
     };
 
-    static const uint64_t block_size = codec_type::BlockSize;
+    static const uint64_t block_size = BlockSize;
     static const uint64_t overflow = 0;
 
     static void encode(uint32_t const* in, uint32_t sum_of_values, size_t n,
@@ -204,7 +235,8 @@ struct optpfor_block {
         assert(n <= block_size);
 
         if (n < block_size) {
-            interpolative_block::encode(in, sum_of_values, n, out);
+            basic_interpolative_block<BlockSize>::encode(in, sum_of_values, n,
+                                                         out);
             return;
         }
 
@@ -225,7 +257,8 @@ struct optpfor_block {
         assert(n <= block_size);
 
         if (DS2I_UNLIKELY(n < block_size)) {
-            return interpolative_block::decode(in, out, sum_of_values, n);
+            return basic_interpolative_block<BlockSize>::decode(
+                in, out, sum_of_values, n);
         }
 
         size_t out_len = block_size;
@@ -238,6 +271,177 @@ struct optpfor_block {
     }
 };
 
+typedef basic_optpfor_block<constants::block_size> optpfor_block;
+
+inline uint32_t bits_of(uint32_t x) {
+    return x ? floor_log2(x) + 1 : 0;
+}
+
+// SIMD-BP128: full blocks are packed with the bit width of their largest
+// value, partial blocks are encoded with interpolative coding.
+struct simdbp128_block {
+    static const uint64_t block_size = constants::block_size;
+    static const uint64_t overflow = 0;
+    static_assert(block_size == simd_bitpacking::block_size,
+                  "SIMD-BP128 needs blocks of 128 integers");
+
+    static void encode(uint32_t const* in, uint32_t sum_of_values, size_t n,
+                       std::vector<uint8_t>& out) {
+        thread_local std::vector<uint32_t> buf(
+            simd_bitpacking::packed_words(32));
+        assert(n <= block_size);
+
+        if (n < block_size) {
+            interpolative_block::encode(in, sum_of_values, n, out);
+            return;
+        }
+
+        uint32_t all_bits = 0;
+        for (size_t i = 0; i < n; ++i) all_bits |= in[i];
+        uint32_t b = bits_of(all_bits);
+        out.push_back(b);
+        simd_bitpacking::pack(in, b, buf.data());
+        uint8_t const* bufptr = reinterpret_cast<uint8_t const*>(buf.data());
+        out.insert(out.end(), bufptr,
+                   bufptr + simd_bitpacking::packed_words(b) * 4);
+    }
+
+    static uint8_t const* DS2I_NOINLINE decode(uint8_t const* in, uint32_t* out,
+                                               uint32_t sum_of_values,
+                                               size_t n) {
+        assert(n <= block_size);
+
+        if (DS2I_UNLIKELY(n < block_size)) {
+            return interpolative_block::decode(in, out, sum_of_values, n);
+        }
+
+        uint32_t b = *in++;
+        simd_bitpacking::unpack(reinterpret_cast<uint32_t const*>(in), b, out);
+        return in + simd_bitpacking::packed_words(b) * 4;
+    }
+
+    // decode() of docid gaps followed by prefix_sum_d1(out, n, base)
+    static uint8_t const* DS2I_NOINLINE decode_prefix_sum(
+        uint8_t const* in, uint32_t* out, uint32_t sum_of_values, size_t n,
+        uint32_t base) {
+        assert(n <= block_size);
+
+        if (DS2I_UNLIKELY(n < block_size)) {
+            in = interpolative_block::decode(in, out, sum_of_values, n);
+            prefix_sum_d1(out, n, base);
+            return in;
+        }
+
+        uint32_t b = *in++;
+        simd_bitpacking::unpack_prefix_sum(
+            reinterpret_cast<uint32_t const*>(in), b, out, base);
+        return in + simd_bitpacking::packed_words(b) * 4;
+    }
+};
+
+// SIMD-FastPFor: full blocks are packed with the bit width that minimizes
+// the block size, the values that do not fit (exceptions) are patched
+// after unpacking. After the bit width and the number of exceptions come
+// the packed low bits, the positions of the exceptions and their high
+// bits, in variable-byte. Partial blocks use interpolative coding.
+struct simdfastpfor_block {
+    static const uint64_t block_size = constants::block_size;
+    static const uint64_t overflow = 0;
+    static_assert(block_size == simd_bitpacking::block_size,
+                  "SIMD-FastPFor needs blocks of 128 integers");
+
+    static void encode(uint32_t const* in, uint32_t sum_of_values, size_t n,
+                       std::vector<uint8_t>& out) {
+        thread_local std::vector<uint32_t> buf(
+            simd_bitpacking::packed_words(32));
+        assert(n <= block_size);
+
+        if (n < block_size) {
+            interpolative_block::encode(in, sum_of_values, n, out);
+            return;
+        }
+
+        uint32_t b = best_b(in);
+        uint32_t num_exceptions = 0;
+        uint8_t positions[block_size];
+        uint32_t high_bits[block_size];
+        if (b < 32) {
+            for (size_t i = 0; i < n; ++i) {
+                if (in[i] >> b) {
+                    positions[num_exceptions] = i;
+                    high_bits[num_exceptions] = in[i] >> b;
+                    ++num_exceptions;
+                }
+            }
+        }
+
+        out.push_back(b);
+        out.push_back(num_exceptions);
+        simd_bitpacking::pack(in, b, buf.data());
+        uint8_t const* bufptr = reinterpret_cast<uint8_t const*>(buf.data());
+        out.insert(out.end(), bufptr,
+                   bufptr + simd_bitpacking::packed_words(b) * 4);
+        out.insert(out.end(), positions, positions + num_exceptions);
+        encode_in_place(out, 5 * num_exceptions, [&](uint8_t* ptr) {
+            size_t written;
+            TightVariableByte::encode(high_bits, num_exceptions, ptr, written);
+            return written;
+        });
+    }
+
+    static uint8_t const* DS2I_NOINLINE decode(uint8_t const* in, uint32_t* out,
+                                               uint32_t sum_of_values,
+                                               size_t n) {
+        assert(n <= block_size);
+
+        if (DS2I_UNLIKELY(n < block_size)) {
+            return interpolative_block::decode(in, out, sum_of_values, n);
+        }
+
+        uint32_t b = in[0];
+        uint32_t num_exceptions = in[1];
+        in += 2;
+        simd_bitpacking::unpack(reinterpret_cast<uint32_t const*>(in), b, out);
+        in += simd_bitpacking::packed_words(b) * 4;
+
+        if (DS2I_UNLIKELY(num_exceptions)) {
+            uint32_t high_bits[block_size];
+            uint8_t const* positions = in;
+            in = TightVariableByte::decode(in + num_exceptions, high_bits,
+                                           num_exceptions);
+            for (uint32_t i = 0; i < num_exceptions; ++i) {
+                out[positions[i]] |= high_bits[i] << b;
+            }
+        }
+        return in;
+    }
+
+private:
+    static uint32_t vbyte_bytes(uint32_t x) {
+        return std::max<uint32_t>(1, (bits_of(x) + 6) / 7);
+    }
+
+    static uint32_t best_b(uint32_t const* in) {
+        uint32_t max_b = 0;
+        for (size_t i = 0; i < block_size; ++i) {
+            max_b = std::max(max_b, bits_of(in[i]));
+        }
+        uint32_t best = max_b;
+        uint64_t best_cost = 16 * max_b;
+        for (uint32_t b = 0; b < max_b; ++b) {
+            uint64_t cost = 16 * b;
+            for (size_t i = 0; i < block_size && cost < best_cost; ++i) {
+                if (in[i] >> b) cost += 1 + vbyte_bytes(in[i] >> b);
+            }
+            if (cost < best_cost) {
+                best = b;
+                best_cost = cost;
+            }
+        }
+        return best;
+    }
+};
+
 struct varint_G8IU_block {
     static const uint64_t block_size = constants::block_size;
     static const uint64_t overflow = 0;
@@ -326,15 +530,17 @@ struct varint_G8IU_block {
     }
 };
 
-struct qmx_block {
-    static const uint64_t block_size = constants::block_size;
+template <uint64_t BlockSize>
+struct basic_qmx_block {
+    static const uint64_t block_size = BlockSize;
     static const uint64_t overflow = 512;
 
     static void encode(uint32_t const* in, uint32_t sum_of_values, size_t n,
                        std::vector<uint8_t>& out) {
         assert(n <= block_size);
         if (n < block_size) {
-            interpolative_block::encode(in, sum_of_values, n, out);
+            basic_interpolative_block<BlockSize>::encode(in, sum_of_values, n,
+                                                         out);
             return;
         }
         thread_local QMX::codec<block_size> qmx_codec;
@@ -353,7 +559,8 @@ struct qmx_block {
         assert(n <= block_size);
 
         if (DS2I_UNLIKELY(n < block_size)) {
-            return interpolative_block::decode(in, out, sum_of_values, n);
+            return basic_interpolative_block<BlockSize>::decode(
+                in, out, sum_of_values, n);
         }
 
         uint32_t enc_len = 0;
@@ -363,16 +570,19 @@ struct qmx_block {
     }
 };
 
+typedef basic_qmx_block<constants::block_size> qmx_block;
+
 struct vbyte_block {
     static const uint64_t block_size = constants::block_size;
     static const uint64_t overflow = 0;
 
     static void encode(uint32_t const* in, uint32_t /* sum_of_values */,
                        size_t n, std::vector<uint8_t>& out) {
-        std::vector<uint8_t> buf(2 * 4 * block_size);
-        size_t out_len = buf.size();
-        TightVariableByte::encode(in, n, buf.data(), out_len);
-        out.insert(out.end(), buf.data(), buf.data() + out_len);
+        encode_in_place(out, 5 * n, [&](uint8_t* ptr) {
+            size_t written;
+            TightVariableByte::encode(in, n, ptr, written);
+            return written;
+        });
     }
 
     static uint8_t const* decode(uint8_t const* in, uint32_t* out,
@@ -381,6 +591,94 @@ struct vbyte_block {
     }
 };
 
+// Bitmap of the docids of a block, that is, the unary codes of its values,
+// for the dense lists: the docids are decoded a word at a time as the
+// positions of the ones. The blocks whose bitmap would be longer than 8
+// bits per value, which vbyte never exceeds, are written with vbyte. A
+// block whose sum_of_values is not given (frequencies) starts with it.
+struct bitmap_block {
+    static const uint64_t block_size = constants::block_size;
+    static const uint64_t overflow = 0;
+
+    static void encode(uint32_t const* in, uint32_t sum_of_values, size_t n,
+                       std::vector<uint8_t>& out) {
+        assert(n <= block_size);
+        if (sum_of_values == uint32_t(-1)) {
+            // only needed exactly when the block is a bitmap
+            sum_of_values = uint32_t(std::min<uint64_t>(
+                std::accumulate(in, in + n, uint64_t(0)), 8 * n));
+            TightVariableByte::encode_single(sum_of_values, out);
+        }
+        if (!is_bitmap(sum_of_values, n)) {
+            vbyte_block::encode(in, sum_of_values, n, out);
+            return;
+        }
+        bytes_bit_writer bw(out);
+        for (size_t i = 0; i != n; ++i) {
+            uint64_t zeros = in[i];
+            for (; zeros >= 64; zeros -= 64) bw.append_bits(0, 64);
+            write_unary(bw, zeros);
+        }
+        bw.flush();
+    }
+
+    static uint8_t const* decode(uint8_t const* in, uint32_t* out,
+                                 uint32_t sum_of_values, size_t n) {
+        assert(n <= block_size);
+        if (sum_of_values == uint32_t(-1)) {
+            in = TightVariableByte::decode(in, &sum_of_values, 1);
+        }
+        if (!is_bitmap(sum_of_values, n)) {
+            return vbyte_block::decode(in, out, sum_of_values, n);
+        }
+        // the prefix sums of the values, then the values
+        in = decode_ones<true>(in, sum_of_values, n, 0, out);
+        for (size_t i = n - 1; i > 0; --i) out[i] -= out[i - 1];
+        return in;
+    }
+
+    static uint8_t const* decode_prefix_sum(uint8_t const* in, uint32_t* out,
+                                            uint32_t sum_of_values, size_t n,
+                                            uint32_t base) {
+        assert(n <= block_size);
+        if (sum_of_values == uint32_t(-1)) {
+            in = TightVariableByte::decode(in, &sum_of_values, 1);
+        }
+        if (!is_bitmap(sum_of_values, n)) {
+            in = vbyte_block::decode(in, out, sum_of_values, n);
+            prefix_sum_d1(out, n, base);
+            return in;
+        }
+        return decode_ones<false>(in, sum_of_values, n, base, out);
+    }
+
+private:
+    static bool is_bitmap(uint32_t sum_of_values, size_t n) {
+        return uint64_t(sum_of_values) + n <= 8 * n;
+    }
+
+    // writes to out base plus the positions of the n ones of the bitmap
+    // at in, minus their ranks with MinusRank; the bitmap is read a word
+    // at a time, but not past its last byte
+    template <bool MinusRank>
+    static uint8_t const* decode_ones(uint8_t const* in,
+                                      uint32_t sum_of_values, size_t n,
+                                      uint32_t base, uint32_t* out) {
+        size_t bytes =
+            succinct::util::ceil_div(uint64_t(sum_of_values) + n, 8);
+        uint32_t word_base = base;
+        size_t i = 0;
+        for (size_t pos = 0; i != n; pos += 8, word_base += 64) {
+            uint64_t w = 0;
+            std::memcpy(&w, in + pos, std::min<size_t>(8, bytes - pos));
+            for (; w; w &= w - 1, ++i) {
+                out[i] = word_base + __builtin_ctzll(w) - (MinusRank ? i : 0);
+            }
+        }
+        return in + bytes;
+    }
+};
+
 struct simple16_block {
     static const uint64_t block_size = constants::block_size;
     static const uint64_t overflow = 512;
@@ -390,8 +688,7 @@ struct simple16_block {
                        size_t n, std::vector<uint8_t>& out) {
         thread_local codec_type simple16_codec;
         assert(n <= block_size);
-        // XXX this could be threadlocal static
-        std::vector<uint8_t> buf(2 * 8 * block_size);
+        thread_local std::vector<uint8_t> buf(2 * 8 * block_size);
         size_t out_len = buf.size();
         simple16_codec.encodeArray(
             in, n, reinterpret_cast<uint32_t*>(buf.data()), out_len);
@@ -419,8 +716,7 @@ struct simple9_block {
                        size_t n, std::vector<uint8_t>& out) {
         thread_local codec_type codec;
         assert(n <= block_size);
-        // XXX this could be threadlocal static
-        std::vector<uint8_t> buf(2 * 8 * block_size);
+        thread_local std::vector<uint8_t> buf(2 * 8 * block_size);
         size_t out_len = buf.size();
         codec.encodeArray(in, n, reinterpret_cast<uint32_t*>(buf.data()),
                           out_len);
@@ -448,8 +744,7 @@ struct simple8b_block {
                        size_t n, std::vector<uint8_t>& out) {
         thread_local codec_type codec;
         assert(n <= block_size);
-        // XXX this could be threadlocal static
-        std::vector<uint8_t> buf(2 * 8 * block_size);
+        thread_local std::vector<uint8_t> buf(2 * 8 * block_size);
         size_t out_len = buf.size();
         codec.encodeArray(in, n, reinterpret_cast<uint32_t*>(buf.data()),
                           out_len);
@@ -468,16 +763,18 @@ struct simple8b_block {
     }
 };
 
-struct streamvbyte_block {
-    static const uint64_t block_size = constants::block_size;
+template <uint64_t BlockSize>
+struct basic_streamvbyte_block {
+    static const uint64_t block_size = BlockSize;
     static const uint64_t overflow = 512;
 
     static void encode(uint32_t const* in, uint32_t /*universe*/, uint32_t n,
                        std::vector<uint8_t>& out) {
         uint32_t* src = const_cast<uint32_t*>(in);
-        std::vector<uint8_t> buf(streamvbyte_max_compressedbytes(n));
-        size_t out_len = streamvbyte_encode(src, n, buf.data());
-        out.insert(out.end(), buf.data(), buf.data() + out_len);
+        encode_in_place(out, streamvbyte_max_compressedbytes(n),
+                        [&](uint8_t* ptr) {
+                            return streamvbyte_encode(src, n, ptr);
+                        });
     }
 
     static uint8_t const* decode(uint8_t const* in, uint32_t* out,
@@ -487,6 +784,8 @@ struct streamvbyte_block {
     }
 };
 
+typedef basic_streamvbyte_block<constants::block_size> streamvbyte_block;
+
 struct maskedvbyte_block {
     static const uint64_t block_size = constants::block_size;
     static const uint64_t overflow = 512;
@@ -494,9 +793,9 @@ struct maskedvbyte_block {
     static void encode(uint32_t const* in, uint32_t /*universe*/, uint32_t n,
                        std::vector<uint8_t>& out) {
         uint32_t* src = const_cast<uint32_t*>(in);
-        std::vector<uint8_t> buf(2 * n * sizeof(uint32_t));
-        size_t out_len = vbyte_encode(src, n, buf.data());
-        out.insert(out.end(), buf.data(), buf.data() + out_len);
+        encode_in_place(out, 2 * n * sizeof(uint32_t), [&](uint8_t* ptr) {
+            return vbyte_encode(src, n, ptr);
+        });
     }
 
     static uint8_t const* decode(uint8_t const* in, uint32_t* out,
@@ -513,9 +812,9 @@ struct varintgb_block {
     static void encode(uint32_t const* in, uint32_t /*universe*/, uint32_t n,
                        std::vector<uint8_t>& out) {
         thread_local VarIntGB<false> varintgb_codec;
-        thread_local std::vector<uint8_t> buf(2 * n * sizeof(uint32_t));
-        size_t out_len = varintgb_codec.encodeArray(in, n, buf.data());
-        out.insert(out.end(), buf.data(), buf.data() + out_len);
+        encode_in_place(out, 2 * n * sizeof(uint32_t), [&](uint8_t* ptr) {
+            return varintgb_codec.encodeArray(in, n, ptr);
+        });
     }
 
     static uint8_t const* decode(uint8_t const* in, uint32_t* out,
@@ -533,12 +832,9 @@ struct gamma_block {
     static void encode(uint32_t const* in, uint32_t /* sum_of_values */,
                        size_t n, std::vector<uint8_t>& out) {
         assert(n <= block_size);
-        succinct::bit_vector_builder bvb;
-        for (size_t i = 0; i != n; ++i, ++in) write_gamma(bvb, *in);
-        auto const& bits = bvb.move_bits();
-        uint8_t const* bufptr = (uint8_t const*)bits.data();
-        uint64_t num_bytes = succinct::util::ceil_div(bvb.size(), 8);
-        out.insert(out.end(), bufptr, bufptr + num_bytes);
+        bytes_bit_writer bw(out);
+        for (size_t i = 0; i != n; ++i, ++in) write_gamma(bw, *in);
+        bw.flush();
     }
 
     static uint8_t const* decode(uint8_t const* in, uint32_t* out,
@@ -556,12 +852,9 @@ struct delta_block {
     static void encode(uint32_t const* in, uint32_t /* sum_of_values */,
                        size_t n, std::vector<uint8_t>& out) {
         assert(n <= block_size);
-        succinct::bit_vector_builder bvb;
-        for (size_t i = 0; i != n; ++i, ++in) write_delta(bvb, *in);
-        auto const& bits = bvb.move_bits();
-        uint8_t const* bufptr = (uint8_t const*)bits.data();
-        uint64_t num_bytes = succinct::util::ceil_div(bvb.size(), 8);
-        out.insert(out.end(), bufptr, bufptr + num_bytes);
+        bytes_bit_writer bw(out);
+        for (size_t i = 0; i != n; ++i, ++in) write_delta(bw, *in);
+        bw.flush();
     }
 
     static uint8_t const* decode(uint8_t const* in, uint32_t* out,
@@ -579,13 +872,14 @@ struct delta_table_block {
     static void encode(uint32_t const* in, uint32_t /* sum_of_values */,
                        size_t n, std::vector<uint8_t>& out) {
         assert(n <= block_size);
-        succinct::bit_vector_builder bvb;
-        for (size_t i = 0; i != n; ++i, ++in) write_delta(bvb, *in);
-        auto const& bits = bvb.move_bits();
-        uint8_t const* bufptr = (uint8_t const*)bits.data();
-        uint64_t num_bytes = succinct::util::ceil_div(bvb.size(), 8);
-        TightVariableByte::encode_single(num_bytes, out);
-        out.insert(out.end(), bufptr, bufptr + num_bytes);
+        // the codes go to a scratch buffer, as their length comes first
+        thread_local std::vector<uint8_t> buf;
+        buf.clear();
+        bytes_bit_writer bw(buf);
+        for (size_t i = 0; i != n; ++i, ++in) write_delta(bw, *in);
+        bw.flush();
+        TightVariableByte::encode_single(buf.size(), out);
+        out.insert(out.end(), buf.begin(), buf.end());
     }
 
     static uint8_t const* decode(uint8_t const* in, uint32_t* out,
@@ -633,26 +927,30 @@ struct rice_block {
                        size_t n, std::vector<uint8_t>& out) {
         assert(n <= block_size);
 
-        std::vector<succinct::bit_vector_builder> bvbs(parameters);
+        // the sizes of the codes are computed for every parameter, and
+        // only the smallest encoding is written
         uint64_t min_index = 0;
         uint64_t min_size = -1;
         for (uint64_t p = 0; p != parameters; ++p) {
-            bvbs[p].append_bits(p, selector_bits);
             uint64_t k = p + 1;
-            uint64_t divisor = uint64_t(1) << k;
-            for (size_t i = 0; i != n; ++i) {
-                write_rice(bvbs[p], in[i], k, divisor);
-                if (bvbs[p].size() >= min_size) break;
+            uint64_t size = selector_bits;
+            for (size_t i = 0; i != n && size < min_size; ++i) {
+                // gamma code of the quotient and k bits of remainder
+                uint64_t q = in[i] >> k;
+                size += 2 * succinct::broadword::msb(q + 1) + 1 + k;
             }
-            if (bvbs[p].size() >= min_size) continue;
-            min_size = bvbs[p].size();
+            if (size >= min_size) continue;
+            min_size = size;
             min_index = p;
         }
 
-        auto const& bits = bvbs[min_index].move_bits();
-        uint8_t const* bufptr = (uint8_t const*)bits.data();
-        uint64_t num_bytes = succinct::util::ceil_div(min_size, 8);
-        out.insert(out.end(), bufptr, bufptr + num_bytes);
+        bytes_bit_writer bw(out);
+        bw.append_bits(min_index, selector_bits);
+        uint64_t k = min_index + 1;
+        uint64_t divisor = uint64_t(1) << k;
+        for (size_t i = 0; i != n; ++i) write_rice(bw, in[i], k, divisor);
+        bw.flush();
+        assert(bw.size() == min_size);
     }
 
     static uint8_t const* decode(uint8_t const* in, uint32_t* out,
@@ -676,14 +974,11 @@ struct zeta_block {
     static void encode(uint32_t const* in, uint32_t /* sum_of_values */,
                        size_t n, std::vector<uint8_t>& out) {
         assert(n <= block_size);
-        succinct::bit_vector_builder bvb;
+        bytes_bit_writer bw(out);
         for (size_t i = 0; i != n; ++i, ++in) {
-            write_zeta(bvb, *in, k);
+            write_zeta(bw, *in, k);
         }
-        auto const& bits = bvb.move_bits();
-        uint8_t const* bufptr = (uint8_t const*)bits.data();
-        uint64_t num_bytes = succinct::util::ceil_div(bvb.size(), 8);
-        out.insert(out.end(), bufptr, bufptr + num_bytes);
+        bw.flush();
     }
 
     static uint8_t const* decode(uint8_t const* in, uint32_t* out,
@@ -695,4 +990,261 @@ struct zeta_block {
         return in + succinct::util::ceil_div(it.position(), 8);
     }
 };
+
+// gamma_block, zeta_block and rice_block with the same format, decoded
+// with multi_symbol_table and a buffered_bit_reader.
+struct gamma_table_block {
+    static const uint64_t block_size = constants::block_size;
+    static const uint64_t overflow = 0;
+
+    static void encode(uint32_t const* in, uint32_t sum_of_values, size_t n,
+                       std::vector<uint8_t>& out) {
+        gamma_block::encode(in, sum_of_values, n, out);
+    }
+
+    static uint8_t const* decode(uint8_t const* in, uint32_t* out,
+                                 uint32_t /* sum_of_values */, size_t n) {
+        static const multi_symbol_table table(
+            [](bits_enumerator& it) { return read_gamma(it); });
+        buffered_bit_reader r(in);
+        decode_multi_symbol(r, table, out, n,
+                            [](buffered_bit_reader& reader) {
+                                return read_gamma(reader);
+                            });
+        return in + succinct::util::ceil_div(r.position(), 8);
+    }
+};
+
+struct rice_table_block {
+    static const uint64_t block_size = constants::block_size;
+    static const uint64_t overflow = 0;
+
+    static void encode(uint32_t const* in, uint32_t sum_of_values, size_t n,
+                       std::vector<uint8_t>& out) {
+        rice_block::encode(in, sum_of_values, n, out);
+    }
+
+    static uint8_t const* decode(uint8_t const* in, uint32_t* out,
+                                 uint32_t /* sum_of_values */, size_t n) {
+        // one table for each parameter k = selector + 1
+        static const multi_symbol_table tables[rice_block::parameters] = {
+            table(1), table(2), table(3), table(4)};
+        static_assert(rice_block::parameters == 4, "One table per parameter");
+        buffered_bit_reader r(in);
+        r.refill();
+        uint64_t selector = r.take(rice_block::selector_bits);
+        uint64_t k = selector + 1;
+        decode_multi_symbol(r, tables[selector], out, n,
+                            [k](buffered_bit_reader& reader) {
+                                return read_rice(reader, k);
+                            });
+        return in + succinct::util::ceil_div(r.position(), 8);
+    }
+
+private:
+    static multi_symbol_table table(uint64_t k) {
+        return multi_symbol_table([k](bits_enumerator& it) {
+            return read_rice(it, k, uint64_t(1) << k);
+        });
+    }
+};
+
+struct zeta_table_block {
+    static const uint64_t block_size = constants::block_size;
+    static const uint64_t overflow = 0;
+
+    static void encode(uint32_t const* in, uint32_t sum_of_values, size_t n,
+                       std::vector<uint8_t>& out) {
+        zeta_block::encode(in, sum_of_values, n, out);
+    }
+
+    static uint8_t const* decode(uint8_t const* in, uint32_t* out,
+                                 uint32_t /* sum_of_values */, size_t n) {
+        static const uint64_t k = zeta_block::k;
+        static const multi_symbol_table table(
+            [](bits_enumerator& it) { return read_zeta(it, k); });
+        buffered_bit_reader r(in);
+        decode_multi_symbol(r, table, out, n,
+                            [](buffered_bit_reader& reader) {
+                                return read_zeta(reader, k);
+                            });
+        return in + succinct::util::ceil_div(r.position(), 8);
+    }
+};
+
+// Entropy coding with the tANS models of tans_shapes. The low shift bits
+// of the values are written as they are and the rest is coded with one of
+// the shapes; the block starts with a selector of the shape and the shift
+// that give the smallest encoding, followed by the final states of the
+// encoder. The values at even and odd positions go through two
+// interleaved states, so that the decoder looks up the next entry of one
+// while reading the bits of the other. Partial blocks use
+// interpolative_block.
+struct tans_block {
+    static const uint64_t block_size = constants::block_size;
+    static const uint64_t overflow = 0;
+    static const uint64_t shape_bits = 4;
+    static const uint64_t shift_bits = 5;
+    static const uint64_t streams = 2;
+    static_assert(tans_shapes::count <= uint64_t(1) << shape_bits,
+                  "The selector must fit all the shapes");
+
+    static void encode(uint32_t const* in, uint32_t sum_of_values, size_t n,
+                       std::vector<uint8_t>& out) {
+        assert(n <= block_size);
+        if (n < block_size) {
+            interpolative_block::encode(in, sum_of_values, n, out);
+            return;
+        }
+
+        uint64_t shape, shift;
+        select(in, n, shape, shift);
+        tans_model const& model = tans_shapes::get(shape);
+
+        // the encoder goes backwards, so the state bits of each value are
+        // written after its symbol has been encoded
+        uint64_t states[streams];
+        uint32_t state_bits[block_size];
+        uint8_t state_bits_len[block_size];
+        for (size_t i = n; i-- > 0;) {
+            uint64_t& state = states[i % streams];
+            uint64_t s = tans_alphabet::symbol(in[i] >> shift);
+            uint64_t len = 0;
+            if (i + streams >= n) {
+                state = model.initial_state(s);
+            } else {
+                uint64_t next = model.encode(state, s, len);
+                state_bits[i] = uint32_t((tans_model::states + state) &
+                                         ((uint64_t(1) << len) - 1));
+                state = next;
+            }
+            state_bits_len[i] = uint8_t(len);
+        }
+
+        bytes_bit_writer bw(out);
+        bw.append_bits(shape, shape_bits);
+        bw.append_bits(shift, shift_bits);
+        for (uint64_t j = 0; j != streams; ++j) {
+            bw.append_bits(states[j], tans_model::log_states);
+        }
+        uint64_t low_mask = (uint64_t(1) << shift) - 1;
+        for (size_t i = 0; i != n; ++i) {
+            uint64_t high = in[i] >> shift;
+            uint64_t s = tans_alphabet::symbol(uint32_t(high));
+            uint64_t extra = high - tans_alphabet::base(s);
+            bw.append_bits((extra << shift) | (in[i] & low_mask),
+                           tans_alphabet::extra_bits(s) + shift);
+            if (state_bits_len[i]) {
+                bw.append_bits(state_bits[i], state_bits_len[i]);
+            }
+        }
+        bw.flush();
+    }
+
+    static uint8_t const* decode(uint8_t const* in, uint32_t* out,
+                                 uint32_t sum_of_values, size_t n) {
+        assert(n <= block_size);
+        if (DS2I_UNLIKELY(n < block_size)) {
+            return interpolative_block::decode(in, out, sum_of_values, n);
+        }
+
+        buffered_bit_reader r(in);
+        r.refill();
+        uint64_t shape = r.take(shape_bits);
+        uint64_t shift = r.take(shift_bits);
+        tans_model const& model = tans_shapes::get(shape);
+        uint64_t states[streams];
+        for (uint64_t j = 0; j != streams; ++j) {
+            states[j] = r.take(tans_model::log_states);
+        }
+        static_assert(block_size % streams == 0, "Whole rounds of states");
+        size_t i = 0;
+        for (; i != n - streams; i += streams) {
+            for (uint64_t j = 0; j != streams; ++j) {
+                // at most 31 value bits and log_states state bits
+                r.refill();
+                auto const& e = model[states[j]];
+                out[i + j] = uint32_t((uint64_t(e.base) << shift) +
+                                      r.take(e.extra_bits + shift));
+                states[j] = e.next + r.take(e.bits);
+            }
+        }
+        // the states of the last round are those the encoder started from
+        for (uint64_t j = 0; j != streams; ++j) {
+            r.refill();
+            auto const& e = model[states[j]];
+            out[i + j] = uint32_t((uint64_t(e.base) << shift) +
+                                  r.take(e.extra_bits + shift));
+        }
+        return in + succinct::util::ceil_div(r.position(), 8);
+    }
+
+private:
+    // Picks the shape and the shift with the smallest estimated size,
+    // trying the shifts up to two bits past the mean of the values.
+    static void select(uint32_t const* in, size_t n, uint64_t& best_shape,
+                       uint64_t& best_shift) {
+        uint64_t sum = 0;
+        for (size_t i = 0; i != n; ++i) sum += in[i];
+        uint64_t max_shift = std::min<uint64_t>(
+            (uint64_t(1) << shift_bits) - 1,
+            succinct::broadword::msb(sum / n + 1) + 2);
+
+        float best_cost = std::numeric_limits<float>::max();
+        best_shape = best_shift = 0;
+        for (uint64_t shift = 0; shift <= max_shift; ++shift) {
+            uint32_t counts[tans_alphabet::size] = {};
+            for (size_t i = 0; i != n; ++i) {
+                ++counts[tans_alphabet::symbol(in[i] >> shift)];
+            }
+            for (uint64_t shape = 0; shape != tans_shapes::count; ++shape) {
+                tans_model const& model = tans_shapes::get(shape);
+                float cost = float(n * shift);
+                for (uint64_t s = 0; s != tans_alphabet::size; ++s) {
+                    if (!counts[s]) continue;
+                    cost += counts[s] * (model.cost(s) +
+                                         tans_alphabet::extra_bits(s));
+                }
+                if (cost < best_cost) {
+                    best_cost = cost;
+                    best_shape = shape;
+                    best_shift = shift;
+                }
+            }
+        }
+    }
+};
+
+namespace detail {
+
+template <typename BlockCodec>
+auto decode_prefix_sum(uint8_t const* in, uint32_t* out,
+                       uint32_t sum_of_values, size_t n, uint32_t base,
+                       int)
+    -> decltype(BlockCodec::decode_prefix_sum(in, out, sum_of_values, n,
+                                              base)) {
+    return BlockCodec::decode_prefix_sum(in, out, sum_of_values, n, base);
+}
+
+template <typename BlockCodec>
+uint8_t const* decode_prefix_sum(uint8_t const* in, uint32_t* out,
+                                 uint32_t sum_of_values, size_t n,
+                                 uint32_t base, long) {
+    in = BlockCodec::decode(in, out, sum_of_values, n);
+    prefix_sum_d1(out, n, base);
+    return in;
+}
+
+}  // namespace detail
+
+// Decodes a block of n docid gaps into docids starting from base, using
+// the fused BlockCodec::decode_prefix_sum() when the codec has one.
+template <typename BlockCodec>
+inline uint8_t const* decode_prefix_sum(uint8_t const* in, uint32_t* out,
+                                        uint32_t sum_of_values, size_t n,
+                                        uint32_t base) {
+    return detail::decode_prefix_sum<BlockCodec>(in, out, sum_of_values, n,
+                                                 base, 0);
+}
+
 }  // namespace ds2i
@@ -11,6 +11,8 @@ namespace ds2i {
 template <typename BlockCodec, bool Profile = false>
 class block_freq_index {
 public:
+    typedef BlockCodec block_codec_type;
+
     block_freq_index()
         : m_size(0) {}
 
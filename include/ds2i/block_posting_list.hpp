@@ -7,19 +7,78 @@
 
 namespace ds2i {
 
-#define PREFIX_SUM                               \
-    out[0] += cur_base;                          \
-    for (uint32_t k = 1; k != block_size; ++k) { \
-        out[k] += out[k - 1] + 1;                \
+template <typename BlockCodec, bool Profile = false>
+struct block_posting_list;
+
+// Decodes the docid gaps blocks with DocsCodec and the frequencies blocks
+// with FreqsCodec, calling them directly.
+template <typename DocsCodec, typename FreqsCodec>
+struct static_block_decoder {
+    static_block_decoder() {}
+
+    // consumes the list header, if any
+    explicit static_block_decoder(uint8_t const*& /* list */) {}
+
+    uint8_t const* decode_docs(uint8_t const* in, uint32_t* out,
+                               uint32_t sum_of_values, size_t n) const {
+        return DocsCodec::decode(in, out, sum_of_values, n);
     }
 
-template <typename BlockCodec, bool Profile = false>
+    uint8_t const* decode_docs_prefix_sum(uint8_t const* in, uint32_t* out,
+                                          uint32_t sum_of_values, size_t n,
+                                          uint32_t base) const {
+        return ds2i::decode_prefix_sum<DocsCodec>(in, out, sum_of_values, n,
+                                                  base);
+    }
+
+    uint8_t const* decode_freqs(uint8_t const* in, uint32_t* out,
+                                size_t n) const {
+        return FreqsCodec::decode(in, out, uint32_t(-1), n);
+    }
+};
+
+// How the lists of a block codec are written and how their blocks are
+// decoded: by default both the docid gaps and the frequencies are encoded
+// with BlockCodec, which is called directly. Codecs that use different
+// codecs for the two (see paired_block) or that choose the encoding of each
+// list (see hybrid_block) specialize this, the latter to write the choice
+// at the beginning of the list and to resolve it only once, when the list
+// is opened.
+template <typename BlockCodec>
+struct block_list_codec {
+    typedef BlockCodec docs_codec;
+    typedef BlockCodec freqs_codec;
+    typedef static_block_decoder<BlockCodec, BlockCodec> decoder;
+
+    template <typename DocsIterator, typename FreqsIterator>
+    static void write(std::vector<uint8_t>& out, uint32_t n,
+                      DocsIterator docs_begin, FreqsIterator freqs_begin) {
+        block_posting_list<BlockCodec>::encode_blocks(out, n, docs_begin,
+                                                      freqs_begin);
+    }
+};
+
+template <typename BlockCodec, bool Profile>
 struct block_posting_list {
+    typedef typename block_list_codec<BlockCodec>::decoder decoder_type;
+
     template <typename DocsIterator, typename FreqsIterator>
     static void write(std::vector<uint8_t>& out, uint32_t n,
                       DocsIterator docs_begin, FreqsIterator freqs_begin) {
+        block_list_codec<BlockCodec>::write(out, n, docs_begin, freqs_begin);
+    }
+
+    // the list encoded with the docs and freqs codecs of BlockCodec,
+    // without any header
+    template <typename DocsIterator, typename FreqsIterator>
+    static void encode_blocks(std::vector<uint8_t>& out, uint32_t n,
+                              DocsIterator docs_begin,
+                              FreqsIterator freqs_begin) {
         TightVariableByte::encode_single(n, out);
 
+        typedef typename block_list_codec<BlockCodec>::docs_codec docs_codec;
+        typedef typename block_list_codec<BlockCodec>::freqs_codec
+            freqs_codec;
         uint64_t block_size = BlockCodec::block_size;
         uint64_t blocks = succinct::util::ceil_div(n, block_size);
         size_t begin_block_maxs = out.size();
@@ -29,8 +88,8 @@ struct block_posting_list {
 
         DocsIterator docs_it(docs_begin);
         FreqsIterator freqs_it(freqs_begin);
-        std::vector<uint32_t> docs_buf(block_size);
-        std::vector<uint32_t> freqs_buf(block_size);
+        uint32_t docs_buf[BlockCodec::block_size];
+        uint32_t freqs_buf[BlockCodec::block_size];
         uint32_t last_doc(-1);
         uint32_t block_base = 0;
         for (size_t b = 0; b < blocks; ++b) {
@@ -46,11 +105,10 @@ struct block_posting_list {
             }
             *((uint32_t*)&out[begin_block_maxs + 4 * b]) = last_doc;
 
-            BlockCodec::encode(docs_buf.data(),
+            docs_codec::encode(docs_buf,
                                last_doc - block_base - (cur_block_size - 1),
                                cur_block_size, out);
-            BlockCodec::encode(freqs_buf.data(), uint32_t(-1), cur_block_size,
-                               out);
+            freqs_codec::encode(freqs_buf, uint32_t(-1), cur_block_size, out);
             if (b != blocks - 1) {
                 *((uint32_t*)&out[begin_block_endpoints + 4 * b]) =
                     out.size() - begin_blocks;
@@ -91,6 +149,7 @@ struct block_posting_list {
 
     static uint32_t decode(uint8_t const* data, uint32_t* out) {
         static const uint64_t block_size = BlockCodec::block_size;
+        decoder_type decoder(data);
         uint32_t n = 0;
         uint8_t const* base = TightVariableByte::decode(data, &n, 1);
         uint32_t blocks = succinct::util::ceil_div(n, block_size);
@@ -107,10 +166,9 @@ struct block_posting_list {
                 (i ? ((uint32_t const*)block_maxs)[i - 1] : uint32_t(-1)) + 1;
             uint8_t const* ptr = blocks_data + endpoint;
             uint32_t max = ((uint32_t const*)block_maxs)[i];
-            BlockCodec::decode(ptr, out, max - cur_base - (block_size - 1),
-                               block_size);
-
-            PREFIX_SUM
+            decoder.decode_docs_prefix_sum(ptr, out,
+                                           max - cur_base - (block_size - 1),
+                                           block_size, cur_base);
 
             endpoint = ((uint32_t const*)block_endpoints)[i];
             out += block_size;
@@ -121,9 +179,8 @@ struct block_posting_list {
         uint8_t const* ptr = blocks_data + endpoint;
         uint32_t max = ((uint32_t const*)block_maxs)[blocks - 1];
         uint32_t size = n - (blocks - 1) * block_size;
-        BlockCodec::decode(ptr, out, max - cur_base - (size - 1), size);
-
-        PREFIX_SUM
+        decoder.decode_docs_prefix_sum(ptr, out, max - cur_base - (size - 1),
+                                       size, cur_base);
 
         out += size;
         return uint32_t(out - in);
@@ -133,7 +190,8 @@ struct block_posting_list {
     public:
         document_enumerator(uint8_t const* data, uint64_t universe,
                             size_t term_id = 0)
-            : m_n(0)  // just to silence warnings
+            : m_decoder(data)
+            , m_n(0)  // just to silence warnings
             , m_base(TightVariableByte::decode(data, &m_n, 1))
             , m_blocks(succinct::util::ceil_div(m_n, BlockCodec::block_size))
             , m_block_maxs(m_base)
@@ -166,7 +224,7 @@ struct block_posting_list {
                 }
                 decode_docs_block(m_cur_block + 1);
             } else {
-                m_cur_docid += m_docs_buf[m_pos_in_block] + 1;
+                m_cur_docid = m_docs_buf[m_pos_in_block];
             }
         }
 
@@ -186,7 +244,7 @@ struct block_posting_list {
             }
 
             while (docid() < lower_bound) {
-                m_cur_docid += m_docs_buf[++m_pos_in_block] + 1;
+                m_cur_docid = m_docs_buf[++m_pos_in_block];
                 assert(m_pos_in_block < m_cur_block_size);
             }
         }
@@ -233,7 +291,7 @@ struct block_posting_list {
             m_pos_in_block = 0;
             m_cur_docid = m_docs_buf[0];
             while (docid() < lower_bound) {
-                m_cur_docid += m_docs_buf[++m_pos_in_block] + 1;
+                m_cur_docid = m_docs_buf[++m_pos_in_block];
                 assert(m_pos_in_block < m_cur_block_size);
             }
         }
@@ -244,7 +302,7 @@ struct block_posting_list {
                 decode_docs_block(block);
             }
             while (position() < pos) {
-                m_cur_docid += m_docs_buf[++m_pos_in_block] + 1;
+                m_cur_docid = m_docs_buf[++m_pos_in_block];
             }
         }
 
@@ -283,12 +341,12 @@ struct block_posting_list {
                                               : (size() % block_size);
 
                 uint32_t cur_base = (b ? block_max(b - 1) : uint32_t(-1)) + 1;
-                uint8_t const* freq_ptr = BlockCodec::decode(
+                uint8_t const* freq_ptr = m_decoder.decode_docs(
                     ptr, buf.data(),
                     block_max(b) - cur_base - (cur_block_size - 1),
                     cur_block_size);
-                ptr = BlockCodec::decode(freq_ptr, buf.data(), uint32_t(-1),
-                                         cur_block_size);
+                ptr = m_decoder.decode_freqs(freq_ptr, buf.data(),
+                                             cur_block_size);
                 bytes += ptr - freq_ptr;
             }
 
@@ -311,18 +369,19 @@ struct block_posting_list {
 
             void decode_doc_gaps(std::vector<uint32_t>& out) const {
                 out.resize(size);
-                BlockCodec::decode(docs_begin, out.data(), doc_gaps_universe,
-                                   size);
+                decoder.decode_docs(docs_begin, out.data(), doc_gaps_universe,
+                                    size);
             }
 
             void decode_freqs(std::vector<uint32_t>& out) const {
                 out.resize(size);
-                BlockCodec::decode(freqs_begin, out.data(), uint32_t(-1), size);
+                decoder.decode_freqs(freqs_begin, out.data(), size);
             }
 
         private:
             friend class document_enumerator;
 
+            decoder_type decoder;
             uint8_t const* docs_begin;
             uint8_t const* freqs_begin;
             uint8_t const* end;
@@ -344,17 +403,18 @@ struct block_posting_list {
                 uint32_t gaps_universe =
                     block_max(b) - cur_base - (cur_block_size - 1);
 
+                blocks.back().decoder = m_decoder;
                 blocks.back().index = b;
                 blocks.back().size = cur_block_size;
                 blocks.back().docs_begin = ptr;
                 blocks.back().doc_gaps_universe = gaps_universe;
                 blocks.back().max = block_max(b);
 
-                uint8_t const* freq_ptr = BlockCodec::decode(
+                uint8_t const* freq_ptr = m_decoder.decode_docs(
                     ptr, buf.data(), gaps_universe, cur_block_size);
                 blocks.back().freqs_begin = freq_ptr;
-                ptr = BlockCodec::decode(freq_ptr, buf.data(), uint32_t(-1),
-                                         cur_block_size);
+                ptr = m_decoder.decode_freqs(freq_ptr, buf.data(),
+                                             cur_block_size);
                 blocks.back().end = ptr;
             }
 
@@ -378,14 +438,13 @@ struct block_posting_list {
             uint32_t cur_base =
                 (block ? block_max(block - 1) : uint32_t(-1)) + 1;
             m_cur_block_max = block_max(block);
-            m_freqs_block_data = BlockCodec::decode(
+            // the buffer holds docids, not gaps
+            m_freqs_block_data = m_decoder.decode_docs_prefix_sum(
                 block_data, m_docs_buf.data(),
                 m_cur_block_max - cur_base - (m_cur_block_size - 1),
-                m_cur_block_size);
+                m_cur_block_size, cur_base);
             succinct::intrinsics::prefetch(m_freqs_block_data);
 
-            m_docs_buf[0] += cur_base;
-
             m_cur_block = block;
             m_pos_in_block = 0;
             m_cur_docid = m_docs_buf[0];
@@ -397,8 +456,8 @@ struct block_posting_list {
 
         void DS2I_NOINLINE decode_freqs_block() {
             uint8_t const* next_block =
-                BlockCodec::decode(m_freqs_block_data, m_freqs_buf.data(),
-                                   uint32_t(-1), m_cur_block_size);
+                m_decoder.decode_freqs(m_freqs_block_data, m_freqs_buf.data(),
+                                       m_cur_block_size);
             succinct::intrinsics::prefetch(next_block);
             m_freqs_decoded = true;
 
@@ -407,6 +466,7 @@ struct block_posting_list {
             }
         }
 
+        decoder_type m_decoder;  // first, as it consumes the list header
         uint32_t m_n;
         uint8_t const* m_base;
         uint32_t m_blocks;
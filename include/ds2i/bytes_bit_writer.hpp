@@ -0,0 +1,66 @@
+#pragma once
+
+#include <cassert>
+#include <cstring>
+#include <vector>
+
+#include "succinct/util.hpp"
+
+namespace ds2i {
+
+// Writer of bits in the layout of succinct::bit_vector_builder (least
+// significant bit first) that appends them straight to a byte buffer, a
+// word at a time, so that encoding a block only grows the output instead
+// of allocating a builder for it. The last partial word is appended by
+// flush(), rounded up to whole bytes, as the block codecs store them.
+class bytes_bit_writer {
+public:
+    explicit bytes_bit_writer(std::vector<uint8_t>& out)
+        : m_out(out)
+        , m_size(0)
+        , m_buf(0)
+        , m_avail(0) {}
+
+    void append_bits(uint64_t bits, size_t len) {
+        assert(len <= 64);
+        assert(len == 64 || (bits >> len) == 0);
+        if (!len) return;
+        m_size += len;
+        if (m_avail + len < 64) {
+            m_buf |= bits << m_avail;
+            m_avail += len;
+            return;
+        }
+        uint64_t word = m_buf | (bits << m_avail);
+        append_bytes(word, 8);
+        // the bits of the value that did not fit in the word
+        size_t written = 64 - m_avail;
+        m_avail = len - written;
+        m_buf = m_avail ? bits >> written : 0;
+    }
+
+    void flush() {
+        append_bytes(m_buf, succinct::util::ceil_div(m_avail, 8));
+        m_buf = 0;
+        m_avail = 0;
+    }
+
+    // number of bits written, including those not flushed yet
+    uint64_t size() const {
+        return m_size;
+    }
+
+private:
+    void append_bytes(uint64_t word, size_t bytes) {
+        size_t pos = m_out.size();
+        m_out.resize(pos + bytes);
+        std::memcpy(m_out.data() + pos, &word, bytes);
+    }
+
+    std::vector<uint8_t>& m_out;
+    uint64_t m_size;
+    uint64_t m_buf;
+    size_t m_avail;
+};
+
+}  // namespace ds2i
@@ -5,6 +5,7 @@
 #include <succinct/broadword.hpp>
 
 #include "global_parameters.hpp"
+#include "unary_enumerator.hpp"
 #include "util.hpp"
 
 namespace ds2i {
@@ -156,11 +157,17 @@ struct compact_elias_fano {
                 if (DS2I_UNLIKELY(m_position == size())) {
                     m_value = m_of.universe;
                 } else {
-                    succinct::bit_vector::unary_enumerator he =
-                        m_high_enumerator;
+                    unary_enumerator he = m_high_enumerator;
+#if defined(DS2I_FAST_PDEP)
+                    // with pdep, selecting the skip-th one costs about as
+                    // much as a single next
+                    he.skip(skip - 1);
+                    he.next();
+#else
                     for (size_t i = 0; i < skip; ++i) {
                         he.next();
                     }
+#endif
                     m_value = ((he.position() - m_of.higher_bits_offset -
                                 m_position - 1)
                                << m_of.lower_bits) |
@@ -262,7 +269,7 @@ struct compact_elias_fano {
                 uint64_t ptr = position >> m_of.log_sampling1;
                 uint64_t high_pos = pointer1(ptr);
                 uint64_t high_rank = ptr << m_of.log_sampling1;
-                m_high_enumerator = succinct::bit_vector::unary_enumerator(
+                m_high_enumerator = unary_enumerator(
                     *m_bv, m_of.higher_bits_offset + high_pos);
                 to_skip = position - high_rank;
             }
@@ -295,7 +302,7 @@ struct compact_elias_fano {
                 uint64_t high_pos = pointer0(ptr);
                 uint64_t high_rank0 = ptr << m_of.log_sampling0;
 
-                m_high_enumerator = succinct::bit_vector::unary_enumerator(
+                m_high_enumerator = unary_enumerator(
                     *m_bv, m_of.higher_bits_offset + high_pos);
                 to_skip = high_lower_bound - high_rank0;
             }
@@ -360,7 +367,7 @@ struct compact_elias_fano {
             }
 
             enumerator& e;
-            succinct::bit_vector::unary_enumerator high_enumerator;
+            unary_enumerator high_enumerator;
             uint64_t high_base, lower_bits, lower_base, mask;
             succinct::bit_vector const& bv;
         };
@@ -387,7 +394,32 @@ struct compact_elias_fano {
 
         uint64_t m_position;
         uint64_t m_value;
-        succinct::bit_vector::unary_enumerator m_high_enumerator;
+        unary_enumerator m_high_enumerator;
     };
+
+    // writes the values, plus base, to out and returns their number. Only
+    // the high parts are decoded in bulk, expanded from the unary array a
+    // word at a time; the low parts are then read with one unaligned load
+    // each. They start at an arbitrary bit offset of the shared bit vector,
+    // not in the aligned blocks that the SIMD unpackers of
+    // simd_bitpacking.hpp expect.
+    static uint32_t decode(enumerator& it, uint32_t base, uint32_t* out) {
+        offsets const& of = it.m_of;
+        decode_ones<true>(it.m_bv->data().data(), of.higher_bits_offset,
+                          of.n, uint64_t(-1), out);
+        if (of.lower_bits) {
+            uint64_t offset = of.lower_bits_offset;
+            for (uint64_t i = 0; i != of.n; ++i) {
+                uint64_t low = it.m_bv->get_word56(offset) & of.mask;
+                out[i] = ((uint64_t(out[i]) << of.lower_bits) | low) + base;
+                offset += of.lower_bits;
+            }
+        } else {
+            for (uint64_t i = 0; i != of.n; ++i) {
+                out[i] += base;
+            }
+        }
+        return of.n;
+    }
 };
 }  // namespace ds2i
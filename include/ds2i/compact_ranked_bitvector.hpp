@@ -5,6 +5,7 @@
 #include <succinct/broadword.hpp>
 
 #include "global_parameters.hpp"
+#include "unary_enumerator.hpp"
 #include "util.hpp"
 
 namespace ds2i {
@@ -328,28 +329,10 @@ struct compact_ranked_bitvector {
         succinct::bit_vector::unary_enumerator m_enumerator;
     };
 
+    // writes the values, plus base, to out and returns their number
     static uint32_t decode(enumerator& it, uint32_t base, uint32_t* out) {
-        uint64_t const* bitmap = it.m_bv->data().data();
-        uint64_t word_index = it.m_of.bits_offset / 64;
-        uint64_t w = bitmap[word_index];
-        w >>= it.m_of.bits_offset % 64;
-
-        using succinct::util::ceil_div;
-        uint64_t size_in_64bit_words = ceil_div(it.m_of.universe, 64);
-
-        uint32_t size = 0;
-        for (uint64_t i = 0; i != size_in_64bit_words; ++i) {
-            while (w != 0) {
-                uint64_t t = w & (~w + 1);
-                int r = __builtin_ctzll(w);
-                out[size++] = r + base;
-                w ^= t;
-            }
-            base += 64;
-            ++word_index;
-            w = bitmap[word_index];
-        }
-
+        decode_ones<false>(it.m_bv->data().data(), it.m_of.bits_offset,
+                           it.m_of.n, base, out);
         return it.m_of.n;
     }
 };
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <algorithm>
 #include <cstdlib>
 #include <cstdint>
 #include <thread>
@@ -21,6 +22,15 @@ public:
     size_t log_partition_size;
     size_t worker_threads;
 
+    // lists with at least two segments of this many postings are
+    // partitioned a segment per thread, at the cost of up to about
+    // fix_cost bits per cut (0, the default, keeps the exact partition)
+    uint64_t partition_segment_size;
+    // threads used to partition the segments of a list; the lists are
+    // already encoded by worker_threads threads, so by default the two
+    // share the hardware threads
+    size_t partition_threads;
+
     bool heuristic_greedy;
 
 private:
@@ -31,6 +41,10 @@ private:
         fillvar("DS2I_LOG_PART", log_partition_size, 7);
         fillvar("DS2I_THREADS", worker_threads,
                 std::thread::hardware_concurrency());
+        fillvar("DS2I_PARTITION_SEGMENT", partition_segment_size, 0);
+        fillvar("DS2I_PARTITION_THREADS", partition_threads,
+                std::max<size_t>(1, std::thread::hardware_concurrency() /
+                                        std::max<size_t>(1, worker_threads)));
         fillvar("DS2I_HEURISTIC_GREEDY", heuristic_greedy, false);
     }
 
@@ -1,8 +1,12 @@
 #pragma once
 
+#include <algorithm>
 #include <array>
+#include <cassert>
+#include <cmath>
 #include <sstream>
 #include <string>
+#include <vector>
 
 #include <boost/preprocessor/seq/enum.hpp>
 #include <boost/preprocessor/seq/for_each.hpp>
@@ -10,8 +14,9 @@
 
 #include "util.hpp"
 
-#define DS2I_FEATURE_TYPES \
-    (n)(size)(sum_of_logs)(entropy)(nonzeros)(max_b)(pfor_b)(pfor_exceptions)
+#define DS2I_FEATURE_TYPES                                    \
+    (n)(size)(sum_of_logs)(entropy)(nonzeros)(max_b)(pfor_b)( \
+        pfor_exceptions)(long_values)(length_changes)
 
 namespace ds2i {
 namespace time_prediction {
@@ -108,12 +113,107 @@ protected:
     float m_bias;
 };
 
+// Least-squares fit of a predictor to the times measured for the given
+// feature vectors. The features are standardized before solving the normal
+// equations, and the ones that never vary in the samples (such as n for
+// full blocks) get weight 0; the ridge term keeps the system solvable when
+// some features are collinear.
+inline predictor fit_predictor(std::vector<feature_vector> const& samples,
+                               std::vector<double> const& times,
+                               double ridge = 1e-6) {
+    assert(samples.size() == times.size());
+    predictor result;
+    size_t m = samples.size();
+    if (!m) return result;
+
+    std::vector<double> mean(num_features, 0), scale(num_features, 0);
+    for (auto const& s : samples) {
+        for (size_t i = 0; i < num_features; ++i) {
+            mean[i] += s[(feature_type)i];
+        }
+    }
+    for (auto& v : mean) v /= m;
+    for (auto const& s : samples) {
+        for (size_t i = 0; i < num_features; ++i) {
+            double d = s[(feature_type)i] - mean[i];
+            scale[i] += d * d;
+        }
+    }
+    std::vector<size_t> active;
+    for (size_t i = 0; i < num_features; ++i) {
+        scale[i] = std::sqrt(scale[i] / m);
+        if (scale[i] > 0) active.push_back(i);
+    }
+
+    // normal equations in [bias, active features...], as an augmented
+    // matrix of k rows and k + 1 columns
+    size_t k = active.size() + 1;
+    std::vector<std::vector<double>> a(k, std::vector<double>(k + 1, 0));
+    std::vector<double> z(k);
+    for (size_t j = 0; j < m; ++j) {
+        z[0] = 1;
+        for (size_t i = 1; i < k; ++i) {
+            size_t f = active[i - 1];
+            z[i] = (samples[j][(feature_type)f] - mean[f]) / scale[f];
+        }
+        for (size_t r = 0; r < k; ++r) {
+            for (size_t c = 0; c < k; ++c) a[r][c] += z[r] * z[c];
+            a[r][k] += z[r] * times[j];
+        }
+    }
+    for (size_t r = 1; r < k; ++r) a[r][r] += ridge * m;
+
+    // Gaussian elimination with partial pivoting
+    for (size_t c = 0; c < k; ++c) {
+        size_t pivot = c;
+        for (size_t r = c + 1; r < k; ++r) {
+            if (std::abs(a[r][c]) > std::abs(a[pivot][c])) pivot = r;
+        }
+        std::swap(a[c], a[pivot]);
+        if (a[c][c] == 0) continue;
+        for (size_t r = 0; r < k; ++r) {
+            if (r == c || a[r][c] == 0) continue;
+            double factor = a[r][c] / a[c][c];
+            for (size_t i = c; i <= k; ++i) a[r][i] -= factor * a[c][i];
+        }
+    }
+
+    double bias = a[0][0] ? a[0][k] / a[0][0] : 0;
+    for (size_t i = 1; i < k; ++i) {
+        size_t f = active[i - 1];
+        double weight = a[i][i] ? a[i][k] / a[i][i] / scale[f] : 0;
+        result[(feature_type)f] = float(weight);
+        bias -= weight * mean[f];
+    }
+    result.bias() = float(bias);
+    return result;
+}
+
+// byte length of the value in the variable-byte codecs
+inline uint32_t vbyte_length(uint32_t value) {
+    return value ? succinct::broadword::msb(value) / 7 + 1 : 1;
+}
+
 void values_statistics(std::vector<uint32_t> values, feature_vector& f) {
-    std::sort(values.begin(), values.end());
     f[feature_type::n] = values.size();
     if (values.empty())
         return;
 
+    // the byte-oriented decoders branch on the length of each value, so
+    // their speed depends on how often it changes, which the order of the
+    // values determines
+    double long_values = 0;
+    double length_changes = 0;
+    for (size_t i = 0; i < values.size(); ++i) {
+        uint32_t length = vbyte_length(values[i]);
+        if (length > 1) long_values += 1;
+        if (i && length != vbyte_length(values[i - 1])) length_changes += 1;
+    }
+    f[feature_type::long_values] = long_values;
+    f[feature_type::length_changes] = length_changes;
+
+    std::sort(values.begin(), values.end());
+
     uint32_t last_value = values.front();
     size_t group_begin = 0;
     double entropy = 0;
@@ -10,14 +10,7 @@ template <typename Iterator>
 uint32_t decode_sequence(Iterator& it, uint32_t* out) {
     uint32_t partitions = it.m_partitions;
     if (partitions == 1) {
-        uint32_t base = it.m_cur_base;
-        uint32_t n = it.cur_partition_size();
-        it.move(0);
-        for (uint32_t i = 0; i != n; ++i) {
-            uint64_t val = it.next().second;
-            out[i] = val + base;
-        }
-        return n;
+        return it.m_partition_enum.decode(it.m_cur_base, out);
     }
 
     uint32_t* in = out;
@@ -42,11 +35,7 @@ uint32_t decode_sequence(Iterator& it, uint32_t* out) {
                     *(it.m_bv),
                     it.m_sequences_offset + it.m_endpoint + type_bits,
                     it.m_cur_upper_bound - it.m_cur_base + 1, n, it.m_params);
-                ef_enum.move(0);
-                for (uint32_t i = 0; i != n; ++i) {
-                    uint64_t val = ef_enum.read_next();
-                    out[i] = val + base;
-                }
+                compact_elias_fano::decode(ef_enum, base, out);
                 break;
             case indexed_sequence::index_type::all_ones:
                 for (uint32_t i = 0; i != n; ++i) {
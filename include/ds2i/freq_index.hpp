@@ -145,6 +145,13 @@ public:
             return m_docs_enum.size();
         }
 
+        // writes all the docids of the list to out and returns their
+        // number, without moving the enumerator
+        uint32_t decode(uint32_t* out) const {
+            auto docs_enum = m_docs_enum;
+            return ds2i::decode_sequence(docs_enum, out);
+        }
+
         typename DocsSequence::enumerator const& docs_enum() const {
             return m_docs_enum;
         }
@@ -0,0 +1,134 @@
+#pragma once
+
+#include <algorithm>
+#include <cassert>
+#include <stdexcept>
+#include <vector>
+
+#include "block_codecs.hpp"
+#include "block_posting_list.hpp"
+
+namespace ds2i {
+
+// Block codec that encodes each list with whichever of BlockCodecs takes the
+// fewest bytes, so that the same collection always gives the same index.
+// The list starts with the index of its codec, which the enumerators read
+// when they are opened: from then on, the blocks are decoded through a
+// function pointer, without any other dispatch.
+//
+// The candidates are block codecs only: the Elias-Fano sequences of
+// freq_index (ef, pef) are not blocked and have their own enumerators, so
+// they cannot be opened through block_list_codec. For the dense lists where
+// PEF would win, bitmap_block and interpolative_block are the candidates.
+template <typename... BlockCodecs>
+struct hybrid_block {
+    static const uint64_t codecs = sizeof...(BlockCodecs);
+    static_assert(codecs > 0 && codecs < 256, "Invalid number of codecs");
+
+    static const uint64_t block_size = constants::block_size;
+    static const uint64_t overflow =
+        std::max<uint64_t>({BlockCodecs::overflow...});
+    static_assert(std::min<uint64_t>({BlockCodecs::block_size...}) ==
+                          block_size &&
+                      std::max<uint64_t>({BlockCodecs::block_size...}) ==
+                          block_size,
+                  "The codecs must have blocks of constants::block_size");
+
+    static void encode(uint32_t const*, uint32_t, size_t,
+                       std::vector<uint8_t>&) {
+        throw std::runtime_error(
+            "Hybrid blocks are encoded a whole list at a time");
+    }
+
+    typedef uint8_t const* (*decode_fn)(uint8_t const*, uint32_t*, uint32_t,
+                                        size_t);
+    typedef uint8_t const* (*decode_prefix_sum_fn)(uint8_t const*, uint32_t*,
+                                                   uint32_t, size_t,
+                                                   uint32_t);
+
+    static decode_fn decoder(uint8_t codec) {
+        static const decode_fn fns[] = {&BlockCodecs::decode...};
+        assert(codec < codecs);
+        return fns[codec];
+    }
+
+    static decode_prefix_sum_fn prefix_sum_decoder(uint8_t codec) {
+        static const decode_prefix_sum_fn fns[] = {
+            &ds2i::decode_prefix_sum<BlockCodecs>...};
+        assert(codec < codecs);
+        return fns[codec];
+    }
+
+    // Encodes the list with every codec and keeps the smallest one
+    template <typename DocsIterator, typename FreqsIterator>
+    static void write(std::vector<uint8_t>& out, uint32_t n,
+                      DocsIterator docs_begin, FreqsIterator freqs_begin) {
+        std::vector<std::vector<uint8_t>> lists = {
+            encode_list<BlockCodecs>(n, docs_begin, freqs_begin)...};
+
+        uint8_t best = 0;
+        for (uint8_t codec = 1; codec < codecs; ++codec) {
+            if (lists[codec].size() < lists[best].size()) best = codec;
+        }
+        out.push_back(best);
+        out.insert(out.end(), lists[best].begin(), lists[best].end());
+    }
+
+private:
+    template <typename BlockCodec, typename DocsIterator,
+              typename FreqsIterator>
+    static std::vector<uint8_t> encode_list(uint32_t n,
+                                            DocsIterator docs_begin,
+                                            FreqsIterator freqs_begin) {
+        std::vector<uint8_t> list;
+        block_posting_list<BlockCodec>::encode_blocks(list, n, docs_begin,
+                                                      freqs_begin);
+        return list;
+    }
+};
+
+template <typename... BlockCodecs>
+struct block_list_codec<hybrid_block<BlockCodecs...>> {
+    typedef hybrid_block<BlockCodecs...> codec_type;
+
+    template <typename DocsIterator, typename FreqsIterator>
+    static void write(std::vector<uint8_t>& out, uint32_t n,
+                      DocsIterator docs_begin, FreqsIterator freqs_begin) {
+        codec_type::write(out, n, docs_begin, freqs_begin);
+    }
+
+    struct decoder {
+        decoder()
+            : m_decode(nullptr)
+            , m_decode_prefix_sum(nullptr) {}
+
+        explicit decoder(uint8_t const*& list) {
+            uint8_t codec = *list++;
+            m_decode = codec_type::decoder(codec);
+            m_decode_prefix_sum = codec_type::prefix_sum_decoder(codec);
+        }
+
+        uint8_t const* decode_docs(uint8_t const* in, uint32_t* out,
+                                   uint32_t sum_of_values, size_t n) const {
+            return m_decode(in, out, sum_of_values, n);
+        }
+
+        uint8_t const* decode_docs_prefix_sum(uint8_t const* in,
+                                              uint32_t* out,
+                                              uint32_t sum_of_values,
+                                              size_t n, uint32_t base) const {
+            return m_decode_prefix_sum(in, out, sum_of_values, n, base);
+        }
+
+        uint8_t const* decode_freqs(uint8_t const* in, uint32_t* out,
+                                    size_t n) const {
+            return m_decode(in, out, uint32_t(-1), n);
+        }
+
+    private:
+        typename codec_type::decode_fn m_decode;
+        typename codec_type::decode_prefix_sum_fn m_decode_prefix_sum;
+    };
+};
+
+}  // namespace ds2i
@@ -0,0 +1,114 @@
+#pragma once
+
+#include <algorithm>
+#include <iterator>
+#include <stdexcept>
+#include <vector>
+
+#include "binary_freq_collection.hpp"
+#include "bm25.hpp"
+#include "wand_data.hpp"
+
+namespace ds2i {
+
+// Maps the score contribution of a posting (query term weight for a
+// query term frequency of 1 times document term weight) to an integer
+// impact in [1, 2^bits - 1]. The scale only depends on the number of
+// documents: the contribution of a posting is bounded by the weight of a
+// term occurring in a single document, so that indexes and queries agree
+// on it without storing it anywhere.
+template <typename Scorer = bm25>
+class impact_quantizer {
+public:
+    impact_quantizer(uint64_t num_docs, uint32_t bits)
+        : m_bits(bits) {
+        if (bits == 0 || bits > 16) {
+            throw std::invalid_argument("Impacts must have 1 to 16 bits");
+        }
+        m_max_impact = (uint32_t(1) << bits) - 1;
+        m_scale = m_max_impact / Scorer::query_term_weight(1, 1, num_docs);
+    }
+
+    uint32_t operator()(float score) const {
+        uint32_t impact = uint32_t(score * m_scale + 0.5f);
+        return std::min(std::max(impact, uint32_t(1)), m_max_impact);
+    }
+
+    float dequantize(uint64_t impact) const {
+        return impact / m_scale;
+    }
+
+    uint32_t bits() const {
+        return m_bits;
+    }
+
+private:
+    uint32_t m_bits;
+    uint32_t m_max_impact;
+    float m_scale;
+};
+
+// Iterates over the impacts of a list, computed on the fly, so that they
+// can be encoded in place of its frequencies by any index builder. The
+// document lengths are taken from the wand data, so that the impacts match
+// the bounds derived from its max term weights.
+template <typename Scorer = bm25>
+class impacts_iterator
+    : public std::iterator<std::forward_iterator_tag, uint32_t> {
+public:
+    impacts_iterator() {}
+
+    impacts_iterator(binary_collection::posting_type const* docs_it,
+                     binary_collection::posting_type const* freqs_it,
+                     float q_weight, wand_data<Scorer> const& wdata,
+                     impact_quantizer<Scorer> const& quantizer)
+        : m_docs_it(docs_it)
+        , m_freqs_it(freqs_it)
+        , m_q_weight(q_weight)
+        , m_wdata(&wdata)
+        , m_quantizer(&quantizer) {}
+
+    uint32_t operator*() const {
+        float norm_len = m_wdata->norm_len(*m_docs_it);
+        return (*m_quantizer)(m_q_weight *
+                              Scorer::doc_term_weight(*m_freqs_it, norm_len));
+    }
+
+    impacts_iterator& operator++() {
+        ++m_docs_it;
+        ++m_freqs_it;
+        return *this;
+    }
+
+    impacts_iterator operator++(int) {
+        impacts_iterator it(*this);
+        operator++();
+        return it;
+    }
+
+    bool operator==(impacts_iterator const& other) const {
+        return m_docs_it == other.m_docs_it;
+    }
+
+    bool operator!=(impacts_iterator const& other) const {
+        return !(*this == other);
+    }
+
+private:
+    binary_collection::posting_type const* m_docs_it;
+    binary_collection::posting_type const* m_freqs_it;
+    float m_q_weight;
+    wand_data<Scorer> const* m_wdata;
+    impact_quantizer<Scorer> const* m_quantizer;
+};
+
+template <typename Scorer>
+impacts_iterator<Scorer> impacts_begin(
+    binary_freq_collection::sequence const& seq, uint64_t num_docs,
+    wand_data<Scorer> const& wdata, impact_quantizer<Scorer> const& quantizer) {
+    float q_weight = Scorer::query_term_weight(1, seq.docs.size(), num_docs);
+    return impacts_iterator<Scorer>(seq.docs.begin(), seq.freqs.begin(),
+                                    q_weight, wdata, quantizer);
+}
+
+}  // namespace ds2i
@@ -154,6 +154,28 @@ struct indexed_sequence {
 #undef ENUMERATOR_METHOD
 #undef ENUMERATOR_VOID_METHOD
 
+        // writes all the values, plus base, to out and returns their number
+        uint32_t decode(uint32_t base, uint32_t* out) {
+            switch (m_type) {
+                case elias_fano:
+                    return compact_elias_fano::decode(m_ef_enumerator, base,
+                                                      out);
+                case ranked_bitvector:
+                    return compact_ranked_bitvector::decode(m_rb_enumerator,
+                                                            base, out);
+                case all_ones: {
+                    uint32_t n = m_ao_enumerator.size();
+                    for (uint32_t i = 0; i != n; ++i) {
+                        out[i] = i + base;
+                    }
+                    return n;
+                }
+                default:
+                    assert(false);
+                    __builtin_unreachable();
+            }
+        }
+
     private:
         index_type m_type;
         union {
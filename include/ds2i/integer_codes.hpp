@@ -5,7 +5,11 @@
 
 namespace ds2i {
 
-void write_unary(succinct::bit_vector_builder& bvb, uint64_t n) {
+// The write_* functions append the codes to a BitVectorBuilder, either a
+// succinct::bit_vector_builder or a bytes_bit_writer.
+
+template <typename BitVectorBuilder>
+void write_unary(BitVectorBuilder& bvb, uint64_t n) {
     uint64_t hb = uint64_t(1) << n;
     bvb.append_bits(hb, n + 1);
 }
@@ -19,7 +23,8 @@ uint64_t read_unary(bits_enumerator& it) {
 }
 
 // note: n can be 0
-void write_gamma(succinct::bit_vector_builder& bvb, uint64_t n) {
+template <typename BitVectorBuilder>
+void write_gamma(BitVectorBuilder& bvb, uint64_t n) {
     uint64_t nn = n + 1;
     uint64_t l = succinct::broadword::msb(nn);
     uint64_t hb = uint64_t(1) << l;
@@ -27,7 +32,8 @@ void write_gamma(succinct::bit_vector_builder& bvb, uint64_t n) {
     bvb.append_bits(nn ^ hb, l);
 }
 
-void write_gamma_nonzero(succinct::bit_vector_builder& bvb, uint64_t n) {
+template <typename BitVectorBuilder>
+void write_gamma_nonzero(BitVectorBuilder& bvb, uint64_t n) {
     assert(n > 0);
     write_gamma(bvb, n - 1);
 }
@@ -46,7 +52,8 @@ uint64_t read_gamma_nonzero(succinct::bit_vector::enumerator& it) {
     return read_gamma(it) + 1;
 }
 
-void write_delta(succinct::bit_vector_builder& bvb, uint64_t n) {
+template <typename BitVectorBuilder>
+void write_delta(BitVectorBuilder& bvb, uint64_t n) {
     uint64_t nn = n + 1;
     uint64_t l = succinct::broadword::msb(nn);
     uint64_t hb = uint64_t(1) << l;
@@ -54,7 +61,8 @@ void write_delta(succinct::bit_vector_builder& bvb, uint64_t n) {
     bvb.append_bits(nn ^ hb, l);
 }
 
-void write_rice(succinct::bit_vector_builder& bvb, uint64_t n, const uint64_t k,
+template <typename BitVectorBuilder>
+void write_rice(BitVectorBuilder& bvb, uint64_t n, const uint64_t k,
                 const uint64_t divisor) {
     assert(k > 0 and k < 32);
     assert(divisor == uint64_t(1) << k);
@@ -94,8 +102,10 @@ uint32_t reverse(uint32_t x, uint32_t len) {
     return r;
 }
 
-void write_zeta(succinct::bit_vector_builder& bvb, uint64_t n,
-                const uint64_t k) {
+// inline, so that the constant k of zeta_block turns the division into a
+// shift
+template <typename BitVectorBuilder>
+inline void write_zeta(BitVectorBuilder& bvb, uint64_t n, const uint64_t k) {
     assert(k > 0 and k < 32);
 
     uint64_t l = succinct::broadword::msb(++n);
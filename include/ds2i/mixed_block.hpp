@@ -1,5 +1,7 @@
 #pragma once
 
+#include <fstream>
+#include <sstream>
 #include <string>
 
 #include "block_codecs.hpp"
@@ -8,7 +10,18 @@
 namespace ds2i {
 
 struct mixed_block {
-    enum class block_type : uint8_t { pfor = 0, varint = 1, interpolative = 2 };
+    // There is no DINT type: DINT decodes with a dictionary of patterns built
+    // from the whole collection, while each mixed_block is decoded on its own
+    // and the optimizer compares the types block by block
+    enum class block_type : uint8_t {
+        pfor = 0,
+        varint = 1,
+        interpolative = 2,
+        streamvbyte = 3,
+        maskedvbyte = 4,
+        qmx = 5,
+        simple16 = 6
+    };
 
     typedef uint8_t compr_param_type;
     static compr_param_type compr_params(block_type t) {
@@ -20,9 +33,13 @@ struct mixed_block {
         }
     }
 
-    static const size_t block_types = 3;
+    static const size_t block_types = 7;
     static const uint64_t block_size = 128;
-    static const uint64_t overflow = 0;
+    // the largest of the codecs
+    static const uint64_t overflow = 512;
+    static_assert(qmx_block::block_size == block_size &&
+                      streamvbyte_block::block_size == block_size,
+                  "The codecs must have blocks of the same size");
 
     static void encode(uint32_t const*, uint32_t, size_t,
                        std::vector<uint8_t>&) {
@@ -55,6 +72,18 @@ struct mixed_block {
             case block_type::interpolative:
                 interpolative_block::encode(in, sum_of_values, n, out);
                 break;
+            case block_type::streamvbyte:
+                streamvbyte_block::encode(in, sum_of_values, n, out);
+                break;
+            case block_type::maskedvbyte:
+                maskedvbyte_block::encode(in, sum_of_values, n, out);
+                break;
+            case block_type::qmx:
+                qmx_block::encode(in, sum_of_values, n, out);
+                break;
+            case block_type::simple16:
+                simple16_block::encode(in, sum_of_values, n, out);
+                break;
             default:
                 throw std::runtime_error("Unsupported block type");
         }
@@ -92,6 +121,9 @@ struct mixed_block {
             }
             fv[feature_type::pfor_b] = b;
             fv[feature_type::pfor_exceptions] = exceptions;
+        } else if (type == block_type::simple16) {
+            if (fv[feature_type::max_b] > 28)
+                return false;  // simple16 codes at most 28 bits
         }
 
         mixed_block::encode_type(type, param, in, sum_of_values, n, buf);
@@ -202,6 +234,14 @@ struct mixed_block {
             return optpfor_block::decode(in, out, sum_of_values, n);
         } else if (type == block_type::interpolative) {
             return interpolative_block::decode(in, out, sum_of_values, n);
+        } else if (type == block_type::streamvbyte) {
+            return streamvbyte_block::decode(in, out, sum_of_values, n);
+        } else if (type == block_type::maskedvbyte) {
+            return maskedvbyte_block::decode(in, out, sum_of_values, n);
+        } else if (type == block_type::qmx) {
+            return qmx_block::decode(in, out, sum_of_values, n);
+        } else if (type == block_type::simple16) {
+            return simple16_block::decode(in, out, sum_of_values, n);
         } else {
             assert(false);
             __builtin_unreachable();
@@ -244,4 +284,25 @@ predictors_vec_type load_predictors(const char* predictors_filename) {
     return predictors;
 }
 
+// Writes the predictors in the format read by load_predictors(), one line
+// per block type with only the nonzero weights.
+void save_predictors(const char* predictors_filename,
+                     predictors_vec_type const& predictors) {
+    using namespace time_prediction;
+    std::ofstream fout(predictors_filename);
+    fout.precision(9);  // round-trips floats
+    for (size_t type = 0; type < predictors.size(); ++type) {
+        auto const& p = predictors[type];
+        fout << "type " << type << " bias " << p.bias();
+        for (size_t i = 0; i < num_features; ++i) {
+            feature_type ft = (feature_type)i;
+            if (p[ft] != 0) fout << ' ' << feature_name(ft) << ' ' << p[ft];
+        }
+        fout << '\n';
+    }
+    if (!fout) {
+        throw std::runtime_error("Error while writing predictors");
+    }
+}
+
 }  // namespace ds2i
@@ -3,6 +3,7 @@
 #include <vector>
 #include <algorithm>
 #include <iterator>
+#include <thread>
 #include "util.hpp"
 
 namespace ds2i {
@@ -30,9 +31,15 @@ struct optimal_partition {
         cost_t cost_upper_bound;  // The maximum cost for this window
 
         cost_window(ForwardIterator begin, cost_t cost_upper_bound)
+            : cost_window(begin, *begin, cost_upper_bound) {}
+
+        // base is the smallest value of the first partition, which is
+        // after the last value of the previous one
+        cost_window(ForwardIterator begin, posting_t base,
+                    cost_t cost_upper_bound)
             : start_it(begin)
             , end_it(begin)
-            , min_p(*begin)
+            , min_p(base)
             , max_p(0)
             , cost_upper_bound(cost_upper_bound) {}
 
@@ -62,6 +69,126 @@ struct optimal_partition {
     template <typename ForwardIterator, typename CostFunction>
     optimal_partition(ForwardIterator begin, uint64_t universe, uint64_t size,
                       CostFunction cost_fun, double eps1, double eps2) {
+        cost_opt = optimize(begin, *begin, universe, size, cost_fun, eps1,
+                            eps2, partition);
+    }
+
+    // Approximation for long lists: the list is cut in segments of
+    // segment_size postings, which are partitioned concurrently by up to
+    // threads threads. Then, at each cut, the last partition of a segment
+    // and the first of the next one are partitioned again together, so
+    // that the cut is not forced. As splitting a partition costs about one
+    // fix_cost, the result is at most about one fix_cost per segment worse
+    // than the one of the sequential algorithm, with the same eps1 and
+    // eps2. Lists shorter than two segments, or segment_size == 0, are
+    // partitioned sequentially.
+    template <typename ForwardIterator, typename CostFunction>
+    optimal_partition(ForwardIterator begin, uint64_t universe, uint64_t size,
+                      CostFunction cost_fun, double eps1, double eps2,
+                      uint64_t segment_size, size_t threads) {
+        if (segment_size == 0 || size < 2 * segment_size || threads < 2) {
+            cost_opt = optimize(begin, *begin, universe, size, cost_fun,
+                                eps1, eps2, partition);
+            return;
+        }
+
+        // the last segment takes the remainder
+        size_t segments = size / segment_size;
+        std::vector<ForwardIterator> starts;
+        std::vector<posting_t> bases;
+        std::vector<posting_t> ends;
+        ForwardIterator it = begin;
+        posting_t base = *begin;
+        for (size_t s = 0; s != segments; ++s) {
+            uint64_t begin_pos = s * segment_size;
+            uint64_t end_pos =
+                s + 1 == segments ? size : begin_pos + segment_size;
+            starts.push_back(it);
+            bases.push_back(base);
+            std::advance(it, end_pos - begin_pos - 1);
+            base = *it + 1;
+            ++it;
+            ends.push_back(end_pos);
+        }
+
+        // an upper bound to the values of segment s, plus 1
+        auto segment_universe = [&](size_t s) -> uint64_t {
+            return s + 1 == segments ? universe : bases[s + 1];
+        };
+
+        std::vector<std::vector<posting_t>> parts(segments);
+        auto optimize_segments = [&](size_t first) {
+            for (size_t s = first; s < segments; s += threads) {
+                uint64_t begin_pos = s ? ends[s - 1] : 0;
+                uint64_t n = ends[s] - begin_pos;
+                optimize(starts[s], bases[s], segment_universe(s) - bases[s],
+                         n, cost_fun, eps1, eps2, parts[s]);
+                for (auto& endpoint : parts[s]) {
+                    endpoint += begin_pos;
+                }
+            }
+        };
+        std::vector<std::thread> workers;
+        for (size_t t = 1; t < std::min(threads, segments); ++t) {
+            workers.emplace_back(optimize_segments, t);
+        }
+        optimize_segments(0);
+        for (auto& worker : workers) {
+            worker.join();
+        }
+
+        // repair the cuts, from the left
+        partition.swap(parts[0]);
+        std::vector<posting_t> repaired;
+        for (size_t s = 1; s != segments; ++s) {
+            partition.pop_back();  // the cut
+            posting_t l = partition.empty() ? 0 : partition.back();
+            posting_t r = parts[s].front();
+
+            // the segment that contains l
+            size_t ls = std::upper_bound(ends.begin(), ends.end(), l) -
+                        ends.begin();
+            uint64_t ls_begin = ls ? ends[ls - 1] : 0;
+            ForwardIterator l_it = starts[ls];
+            posting_t l_base = bases[ls];
+            if (l != ls_begin) {
+                std::advance(l_it, l - ls_begin - 1);
+                l_base = *l_it + 1;
+                ++l_it;
+            }
+
+            repaired.clear();
+            optimize(l_it, l_base, segment_universe(s) - l_base, r - l,
+                     cost_fun, eps1, eps2, repaired);
+            for (auto endpoint : repaired) {
+                partition.push_back(l + endpoint);
+            }
+            partition.insert(partition.end(), parts[s].begin() + 1,
+                             parts[s].end());
+        }
+
+        // the cost of the partition, as computed by the sequential algorithm
+        it = begin;
+        base = *begin;
+        posting_t pos = 0;
+        for (auto endpoint : partition) {
+            std::advance(it, endpoint - pos - 1);
+            cost_opt += cost_fun(*it - base + 1, endpoint - pos);
+            base = *it + 1;
+            ++it;
+            pos = endpoint;
+        }
+    }
+
+private:
+    // appends to partition the endpoints, relative to begin, of the
+    // partitions of the size values from begin, where base is the smallest
+    // value of the first partition; returns their cost
+    template <typename ForwardIterator, typename CostFunction>
+    static cost_t optimize(ForwardIterator begin, posting_t base,
+                           uint64_t universe, uint64_t size,
+                           CostFunction cost_fun, double eps1, double eps2,
+                           std::vector<posting_t>& partition) {
         cost_t single_block_cost = cost_fun(universe, size);
         std::vector<cost_t> min_cost(size + 1, single_block_cost);
         min_cost[0] = 0;
@@ -71,7 +198,7 @@ struct optimal_partition {
         cost_t cost_lb = cost_fun(1, 1);  // minimum cost
         cost_t cost_bound = cost_lb;
         while (eps1 == 0 || cost_bound < cost_lb / eps1) {
-            windows.emplace_back(begin, cost_bound);
+            windows.emplace_back(begin, base, cost_bound);
             if (cost_bound >= single_block_cost)
                 break;
             cost_bound = cost_bound * (1 + eps2);
@@ -105,13 +232,14 @@ struct optimal_partition {
             }
         }
 
+        size_t first = partition.size();
         posting_t curr_pos = size;
         while (curr_pos != 0) {
             partition.push_back(curr_pos);
             curr_pos = path[curr_pos];
         }
-        std::reverse(partition.begin(), partition.end());
-        cost_opt = min_cost[size];
+        std::reverse(partition.begin() + first, partition.end());
+        return min_cost[size];
     }
 };
 
@@ -0,0 +1,295 @@
+#pragma once
+
+#include <algorithm>
+#include <numeric>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include <succinct/mappable_vector.hpp>
+
+#include "queries.hpp"
+#include "util.hpp"
+
+namespace ds2i {
+
+// Materialized intersections of frequent term pairs. Each pair list is
+// stored in two indexes of the same type as the main one, with the same
+// docids and the frequencies of the first and second term respectively,
+// so that its enumerators can be mixed with those of the main index. The
+// lists are sorted by pair key, which is also their id.
+template <typename IndexType>
+class pair_index {
+public:
+    typedef typename IndexType::document_enumerator document_enumerator;
+
+    struct covered_pair {
+        uint64_t id;
+        term_id_type first;
+        term_id_type second;
+    };
+
+    static uint64_t pair_key(term_id_type first, term_id_type second) {
+        if (first > second) std::swap(first, second);
+        return (uint64_t(first) << 32) | second;
+    }
+
+    class builder {
+    public:
+        builder(uint64_t num_docs, global_parameters const& params)
+            : m_num_docs(num_docs)
+            , m_params(params) {}
+
+        void build_model(std::string const& prefix_name) {
+            m_prefix_name = prefix_name;
+        }
+
+        // the lists are kept until build(), since the index builders
+        // encode them asynchronously
+        void add_pair(term_id_type first, term_id_type second,
+                      std::vector<uint64_t> docs,
+                      std::vector<uint64_t> first_freqs,
+                      std::vector<uint64_t> second_freqs) {
+            if (docs.empty()) {
+                throw std::invalid_argument("List must be nonempty");
+            }
+            if (first > second) {
+                std::swap(first, second);
+                first_freqs.swap(second_freqs);
+            }
+            m_lists.push_back(pair_list{pair_key(first, second),
+                                        std::move(docs), std::move(first_freqs),
+                                        std::move(second_freqs)});
+        }
+
+        void build(pair_index& pairs) {
+            std::sort(m_lists.begin(), m_lists.end(),
+                      [](pair_list const& lhs, pair_list const& rhs) {
+                          return lhs.key < rhs.key;
+                      });
+
+            typename IndexType::builder first_builder(m_num_docs, m_params);
+            typename IndexType::builder second_builder(m_num_docs, m_params);
+            first_builder.build_model(m_prefix_name);
+            second_builder.build_model(m_prefix_name);
+
+            std::vector<uint64_t> keys;
+            keys.reserve(m_lists.size());
+            for (auto const& list : m_lists) {
+                if (!keys.empty() && keys.back() == list.key) {
+                    throw std::invalid_argument("Duplicate term pair");
+                }
+                keys.push_back(list.key);
+                uint64_t n = list.docs.size();
+                first_builder.add_posting_list(
+                    n, list.docs.begin(), list.first_freqs.begin(),
+                    std::accumulate(list.first_freqs.begin(),
+                                    list.first_freqs.end(), uint64_t(0)));
+                second_builder.add_posting_list(
+                    n, list.docs.begin(), list.second_freqs.begin(),
+                    std::accumulate(list.second_freqs.begin(),
+                                    list.second_freqs.end(), uint64_t(0)));
+            }
+
+            first_builder.build(pairs.m_first);
+            second_builder.build(pairs.m_second);
+            pairs.m_keys.steal(keys);
+            m_lists.clear();
+        }
+
+    private:
+        struct pair_list {
+            uint64_t key;
+            std::vector<uint64_t> docs;
+            std::vector<uint64_t> first_freqs;
+            std::vector<uint64_t> second_freqs;
+        };
+
+        uint64_t m_num_docs;
+        global_parameters m_params;
+        std::string m_prefix_name;
+        std::vector<pair_list> m_lists;
+    };
+
+    pair_index() {}
+
+    // number of pairs
+    uint64_t size() const {
+        return m_keys.size();
+    }
+
+    // id of the pair list, or size() if the pair is not stored
+    uint64_t find(term_id_type first, term_id_type second) const {
+        uint64_t key = pair_key(first, second);
+        auto it = std::lower_bound(m_keys.begin(), m_keys.end(), key);
+        if (it == m_keys.end() || *it != key) return size();
+        return uint64_t(it - m_keys.begin());
+    }
+
+    // docids with the frequencies of the lower term id of the pair
+    document_enumerator first(uint64_t id) const {
+        return m_first[id];
+    }
+
+    // docids with the frequencies of the higher term id of the pair
+    document_enumerator second(uint64_t id) const {
+        return m_second[id];
+    }
+
+    // Covers the (sorted, distinct) query terms with disjoint stored pairs,
+    // shortest lists first; the remaining terms are returned in singles.
+    void cover(term_id_vec const& terms, std::vector<covered_pair>& pairs,
+               term_id_vec& singles) const {
+        std::vector<std::pair<uint64_t, covered_pair>> candidates;
+        for (size_t i = 0; i < terms.size(); ++i) {
+            for (size_t j = i + 1; j < terms.size(); ++j) {
+                uint64_t id = find(terms[i], terms[j]);
+                if (id != size()) {
+                    candidates.emplace_back(
+                        m_first[id].size(),
+                        covered_pair{id, terms[i], terms[j]});
+                }
+            }
+        }
+        std::sort(candidates.begin(), candidates.end(),
+                  [](auto const& lhs, auto const& rhs) {
+                      return lhs.first < rhs.first;
+                  });
+
+        pairs.clear();
+        singles = terms;
+        for (auto const& c : candidates) {
+            auto first_it =
+                std::find(singles.begin(), singles.end(), c.second.first);
+            auto second_it =
+                std::find(singles.begin(), singles.end(), c.second.second);
+            if (first_it == singles.end() || second_it == singles.end()) {
+                continue;
+            }
+            pairs.push_back(c.second);
+            singles.erase(second_it);  // second_it is after first_it
+            singles.erase(first_it);
+        }
+    }
+
+    void swap(pair_index& other) {
+        m_first.swap(other.m_first);
+        m_second.swap(other.m_second);
+        m_keys.swap(other.m_keys);
+    }
+
+    template <typename Visitor>
+    void map(Visitor& visit) {
+        visit(m_first, "m_first")(m_second, "m_second")(m_keys, "m_keys");
+    }
+
+private:
+    IndexType m_first;
+    IndexType m_second;
+    succinct::mapper::mappable_vector<uint64_t> m_keys;
+};
+
+// and_query that replaces the lists of the stored pairs of query terms
+// with their precomputed intersections.
+template <typename PairIndex, bool with_freqs>
+struct pair_and_query {
+    pair_and_query(PairIndex const& pairs)
+        : m_pairs(&pairs) {}
+
+    template <typename Index>
+    uint64_t operator()(Index const& index, term_id_vec terms) const {
+        typedef typename Index::document_enumerator enum_type;
+        static_assert(std::is_same<enum_type, typename PairIndex::
+                                                  document_enumerator>::value,
+                      "Pair index must have the type of the index");
+        if (terms.empty())
+            return 0;
+        remove_duplicate_terms(terms);
+
+        std::vector<typename PairIndex::covered_pair> pairs;
+        term_id_vec singles;
+        m_pairs->cover(terms, pairs, singles);
+
+        std::vector<enum_type> enums;
+        enums.reserve(pairs.size() + singles.size());
+        for (auto const& p : pairs) {
+            enums.push_back(m_pairs->first(p.id));
+        }
+        for (auto term : singles) {
+            enums.push_back(index[term]);
+        }
+
+        return and_query<with_freqs>::intersect(enums, index.num_docs());
+    }
+
+private:
+    PairIndex const* m_pairs;
+};
+
+// ranked_and_query on the precomputed intersections: both lists of a pair
+// are intersected, one for the frequencies of each term.
+template <typename PairIndex>
+struct pair_ranked_and_query {
+    typedef bm25 scorer_type;
+
+    pair_ranked_and_query(PairIndex const& pairs,
+                          wand_data<scorer_type> const& wdata, uint64_t k)
+        : m_pairs(&pairs)
+        , m_query(wdata, k) {}
+
+    template <typename Index>
+    uint64_t operator()(Index const& index, term_id_vec terms) {
+        typedef typename Index::document_enumerator enum_type;
+        static_assert(std::is_same<enum_type, typename PairIndex::
+                                                  document_enumerator>::value,
+                      "Pair index must have the type of the index");
+        if (terms.empty())
+            return m_query(index, terms);
+
+        auto query_term_freqs = query_freqs(terms);
+        term_id_vec distinct_terms;
+        for (auto const& term : query_term_freqs) {
+            distinct_terms.push_back(term.first);
+        }
+
+        std::vector<typename PairIndex::covered_pair> pairs;
+        term_id_vec singles;
+        m_pairs->cover(distinct_terms, pairs, singles);
+
+        uint64_t num_docs = index.num_docs();
+        // weights depend on the size of the whole list of the term
+        auto q_weight = [&](term_id_type term) {
+            auto it = std::lower_bound(query_term_freqs.begin(),
+                                       query_term_freqs.end(),
+                                       term_freq_pair(term, 0));
+            return scorer_type::query_term_weight(
+                it->second, index[term].size(), num_docs);
+        };
+
+        typedef ranked_and_query::scored_enum<enum_type> scored_enum;
+        std::vector<scored_enum> enums;
+        enums.reserve(2 * pairs.size() + singles.size());
+        for (auto const& p : pairs) {
+            enums.push_back(
+                scored_enum{m_pairs->first(p.id), q_weight(p.first)});
+            enums.push_back(
+                scored_enum{m_pairs->second(p.id), q_weight(p.second)});
+        }
+        for (auto term : singles) {
+            enums.push_back(scored_enum{index[term], q_weight(term)});
+        }
+
+        return m_query.intersect(enums, num_docs);
+    }
+
+    std::vector<topk_queue::entry_type> const& topk() const {
+        return m_query.topk();
+    }
+
+private:
+    PairIndex const* m_pairs;
+    ranked_and_query m_query;
+};
+
+}  // namespace ds2i
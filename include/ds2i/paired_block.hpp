@@ -0,0 +1,37 @@
+#pragma once
+
+#include "block_posting_list.hpp"
+
+namespace ds2i {
+
+// Block codec that encodes the docid gaps with DocsCodec and the
+// frequencies with FreqsCodec: it only carries the two codecs, which
+// block_posting_list gets through block_list_codec.
+template <typename DocsCodec, typename FreqsCodec>
+struct paired_block {
+    typedef DocsCodec docs_codec;
+    typedef FreqsCodec freqs_codec;
+
+    static const uint64_t block_size = DocsCodec::block_size;
+    static const uint64_t overflow = DocsCodec::overflow > FreqsCodec::overflow
+                                         ? DocsCodec::overflow
+                                         : FreqsCodec::overflow;
+    static_assert(FreqsCodec::block_size == block_size,
+                  "The codecs must have blocks of the same size");
+};
+
+template <typename DocsCodec, typename FreqsCodec>
+struct block_list_codec<paired_block<DocsCodec, FreqsCodec>> {
+    typedef DocsCodec docs_codec;
+    typedef FreqsCodec freqs_codec;
+    typedef static_block_decoder<DocsCodec, FreqsCodec> decoder;
+
+    template <typename DocsIterator, typename FreqsIterator>
+    static void write(std::vector<uint8_t>& out, uint32_t n,
+                      DocsIterator docs_begin, FreqsIterator freqs_begin) {
+        block_posting_list<paired_block<DocsCodec, FreqsCodec>>::encode_blocks(
+            out, n, docs_begin, freqs_begin);
+    }
+};
+
+}  // namespace ds2i
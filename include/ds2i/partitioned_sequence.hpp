@@ -30,7 +30,8 @@ struct partitioned_sequence {
         };
 
         optimal_partition opt(begin, universe, n, cost_fun, conf.eps1,
-                              conf.eps2);
+                              conf.eps2, conf.partition_segment_size,
+                              conf.partition_threads);
 
         size_t partitions = opt.partition.size();
         assert(partitions > 0);
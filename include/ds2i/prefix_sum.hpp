@@ -0,0 +1,78 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace ds2i {
+
+namespace prefix_sum_detail {
+
+#if defined(__SSE2__)
+// in-register inclusive scan of 4 integers
+inline __m128i scan4(__m128i v) {
+    v = _mm_add_epi32(v, _mm_slli_si128(v, 4));
+    return _mm_add_epi32(v, _mm_slli_si128(v, 8));
+}
+#endif
+
+#if defined(__AVX2__)
+// in-register inclusive scan of 8 integers
+inline __m256i scan8(__m256i v) {
+    v = _mm256_add_epi32(v, _mm256_slli_si256(v, 4));
+    v = _mm256_add_epi32(v, _mm256_slli_si256(v, 8));
+    // add the last integer of the low half to the high half
+    __m256i low_last = _mm256_permutevar8x32_epi32(
+        v, _mm256_setr_epi32(0, 0, 0, 0, 3, 3, 3, 3));
+    return _mm256_add_epi32(
+        v, _mm256_blend_epi32(_mm256_setzero_si256(), low_last, 0xF0));
+}
+#endif
+
+}  // namespace prefix_sum_detail
+
+// Prefix sum of the d-gaps of a block of docids, which are stored minus 1:
+// out[0] += base, out[k] += out[k - 1] + 1. The sums are computed in
+// registers, 8 (AVX2) or 4 (SSE2) integers at a time, carrying the last
+// one to the next vector; the tail is summed with scalar code.
+inline void prefix_sum_d1(uint32_t* out, size_t n, uint32_t base) {
+    // the sum before the first integer, wrapping around for base = 0
+    uint32_t sum = base - 1;
+    size_t k = 0;
+#if defined(__AVX2__)
+    __m256i ones = _mm256_set1_epi32(1);
+    __m256i carry = _mm256_set1_epi32(int(sum));
+    for (; k + 8 <= n; k += 8) {
+        __m256i* p = reinterpret_cast<__m256i*>(out + k);
+        __m256i v = _mm256_add_epi32(_mm256_loadu_si256(p), ones);
+        v = _mm256_add_epi32(prefix_sum_detail::scan8(v), carry);
+        _mm256_storeu_si256(p, v);
+        carry = _mm256_permutevar8x32_epi32(v, _mm256_set1_epi32(7));
+    }
+    if (k) sum = out[k - 1];
+#elif defined(__SSE2__)
+    __m128i ones = _mm_set1_epi32(1);
+    __m128i carry = _mm_set1_epi32(int(sum));
+    for (; k + 4 <= n; k += 4) {
+        __m128i* p = reinterpret_cast<__m128i*>(out + k);
+        __m128i v = _mm_add_epi32(_mm_loadu_si128(p), ones);
+        v = _mm_add_epi32(prefix_sum_detail::scan4(v), carry);
+        _mm_storeu_si128(p, v);
+        carry = _mm_shuffle_epi32(v, 0xFF);
+    }
+    if (k) sum = out[k - 1];
+#endif
+    // the tail is counted from k, otherwise with a constant n GCC
+    // warns (-Waggressive-loop-optimizations) about an overflowing trip count
+    for (size_t tail = n - k, j = 0; j < tail; ++j) {
+        sum += out[k + j] + 1;
+        out[k + j] = sum;
+    }
+}
+
+}  // namespace ds2i
@@ -1,8 +1,18 @@
 #pragma once
 
+#include <atomic>
+#include <condition_variable>
+#include <fstream>
+#include <functional>
 #include <iostream>
+#include <limits>
+#include <mutex>
 #include <sstream>
+#include <stdexcept>
+#include <thread>
+#include <type_traits>
 
+#include "impacts.hpp"
 #include "index_types.hpp"
 #include "wand_data.hpp"
 #include "util.hpp"
@@ -26,6 +36,18 @@ bool read_query(term_id_vec& ret, std::istream& is = std::cin) {
     return true;
 }
 
+// Reads all the queries of a query log file.
+std::vector<term_id_vec> read_queries(std::string const& filename) {
+    std::ifstream is(filename);
+    if (!is) {
+        throw std::runtime_error("Cannot open query log " + filename);
+    }
+    std::vector<term_id_vec> queries;
+    term_id_vec q;
+    while (read_query(q, is)) queries.push_back(q);
+    return queries;
+}
+
 void remove_duplicate_terms(term_id_vec& terms) {
     std::sort(terms.begin(), terms.end());
     terms.erase(std::unique(terms.begin(), terms.end()), terms.end());
@@ -47,16 +69,23 @@ struct and_query {
             enums.push_back(index[term]);
         }
 
+        return intersect(enums, index.num_docs());
+    }
+
+    // Counts the documents in the intersection of the enumerators, which
+    // are not required to come from the same index.
+    template <typename Enum>
+    static uint64_t intersect(std::vector<Enum>& enums, uint64_t num_docs) {
         // sort by increasing frequency
         std::sort(enums.begin(), enums.end(),
-                  [](enum_type const& lhs, enum_type const& rhs) {
+                  [](Enum const& lhs, Enum const& rhs) {
                       return lhs.size() < rhs.size();
                   });
 
         uint64_t results = 0;
         uint64_t candidate = enums[0].docid();
         size_t i = 1;
-        while (candidate < index.num_docs()) {
+        while (candidate < num_docs) {
             for (; i < enums.size(); ++i) {
                 enums[i].next_geq(candidate);
                 if (enums[i].docid() != candidate) {
@@ -83,10 +112,67 @@ struct and_query {
     }
 };
 
+// Whether the document enumerators can write all the docids of their list
+// at once with decode(out), as those of freq_index do.
+template <typename Enum, typename = void>
+struct has_bulk_decode : std::false_type {};
+
+template <typename Enum>
+struct has_bulk_decode<Enum, decltype(void(std::declval<Enum const&>().decode(
+                                 std::declval<uint32_t*>())))>
+    : std::true_type {};
+
+// Union of lists that are decoded in bulk: each list is written to an
+// array ending with num_docs as a sentinel, and the arrays are merged. The
+// arrays are kept from one union to the next, so each thread needs its own
+// merger.
+class bulk_or_merger {
+public:
+    // Writes the docids of the union to out, unless it is null, and
+    // returns their number.
+    template <typename Enum>
+    uint64_t operator()(std::vector<Enum> const& enums, uint32_t num_docs,
+                        uint32_t* out = nullptr) {
+        if (enums.size() == 1) {
+            return out ? enums.front().decode(out) : enums.front().size();
+        }
+
+        m_lists.resize(enums.size());
+        m_cursors.resize(enums.size());
+        uint32_t cur_doc = num_docs;
+        for (size_t i = 0; i < enums.size(); ++i) {
+            m_lists[i].resize(enums[i].size() + 1);
+            uint32_t n = enums[i].decode(m_lists[i].data());
+            m_lists[i][n] = num_docs;
+            m_cursors[i] = m_lists[i].data();
+            cur_doc = std::min(cur_doc, m_lists[i].front());
+        }
+
+        uint64_t results = 0;
+        while (cur_doc < num_docs) {
+            if (out) out[results] = cur_doc;
+            results += 1;
+            uint32_t next_doc = num_docs;
+            for (auto& cursor : m_cursors) {
+                if (*cursor == cur_doc) ++cursor;
+                if (*cursor < next_doc) {
+                    next_doc = *cursor;
+                }
+            }
+            cur_doc = next_doc;
+        }
+        return results;
+    }
+
+private:
+    std::vector<std::vector<uint32_t>> m_lists;
+    std::vector<uint32_t const*> m_cursors;
+};
+
 template <bool with_freqs>
 struct or_query {
     template <typename Index>
-    uint64_t operator()(Index const& index, term_id_vec terms) const {
+    uint64_t operator()(Index const& index, term_id_vec terms) {
         if (terms.empty())
             return 0;
         remove_duplicate_terms(terms);
@@ -99,17 +185,35 @@ struct or_query {
             enums.push_back(index[term]);
         }
 
+        return merge(enums, index.num_docs(),
+                     std::integral_constant<
+                         bool, !with_freqs &&
+                                   has_bulk_decode<enum_type>::value>());
+    }
+
+private:
+    // without the frequencies, the lists that can be decoded in bulk are
+    // merged as arrays
+    template <typename Enum>
+    uint64_t merge(std::vector<Enum>& enums, uint64_t num_docs,
+                   std::true_type) {
+        return m_bulk_merger(enums, num_docs);
+    }
+
+    template <typename Enum>
+    uint64_t merge(std::vector<Enum>& enums, uint64_t num_docs,
+                   std::false_type) {
         uint64_t results = 0;
         uint64_t cur_doc =
             std::min_element(enums.begin(), enums.end(),
-                             [](enum_type const& lhs, enum_type const& rhs) {
+                             [](Enum const& lhs, Enum const& rhs) {
                                  return lhs.docid() < rhs.docid();
                              })
                 ->docid();
 
-        while (cur_doc < index.num_docs()) {
+        while (cur_doc < num_docs) {
             results += 1;
-            uint64_t next_doc = index.num_docs();
+            uint64_t next_doc = num_docs;
             for (size_t i = 0; i < enums.size(); ++i) {
                 if (enums[i].docid() == cur_doc) {
                     if (with_freqs) {
@@ -127,6 +231,8 @@ struct or_query {
 
         return results;
     }
+
+    bulk_or_merger m_bulk_merger;
 };
 
 typedef std::pair<uint64_t, uint64_t> term_freq_pair;
@@ -147,45 +253,168 @@ term_freq_vec query_freqs(term_id_vec terms) {
     return query_term_freqs;
 }
 
+// Top-k documents by decreasing score, ties broken by increasing docid.
+// Each entry is packed in a 64-bit key, ordered as the entries, with the
+// order-preserving bits of the score in the high half and the complemented
+// docid in the low half, so that comparisons are single integer compares.
+// The keys are kept in a 4-ary min-heap: it is half as deep as a binary
+// heap and the children of a node share a cache line.
 struct topk_queue {
+    typedef std::pair<float, uint64_t> entry_type;  // (score, docid)
+
     topk_queue(uint64_t k)
-        : m_k(k) {}
+        : m_k(k)
+        , m_threshold(std::numeric_limits<float>::lowest())
+        , m_shared_threshold(nullptr) {
+        m_q.reserve(k);
+    }
 
-    bool insert(float score) {
+    bool insert(float score, uint64_t docid) {
+        assert(docid <= std::numeric_limits<uint32_t>::max());
+        if (score < m_threshold) {
+            return false;
+        }
+        if (m_shared_threshold && !above_shared_threshold(score)) {
+            return false;
+        }
+        uint64_t key = make_key(score, docid);
         if (m_q.size() < m_k) {
-            m_q.push_back(score);
-            std::push_heap(m_q.begin(), m_q.end(), std::greater<float>());
-            return true;
-        } else {
-            if (score > m_q.front()) {
-                std::pop_heap(m_q.begin(), m_q.end(), std::greater<float>());
-                m_q.back() = score;
-                std::push_heap(m_q.begin(), m_q.end(), std::greater<float>());
-                return true;
+            m_q.push_back(key);
+            sift_up(m_q.size() - 1, key);
+            if (m_q.size() == m_k) {
+                update_threshold();
             }
+            return true;
         }
-        return false;
+        if (key <= m_q.front()) {
+            return false;
+        }
+        replace_top(key);
+        update_threshold();
+        return true;
     }
 
+    // documents are traversed by increasing docid, so a score equal to the
+    // threshold would lose the tie against the entry it should replace
     bool would_enter(float score) const {
-        return m_q.size() < m_k || score > m_q.front();
+        if (m_shared_threshold && !above_shared_threshold(score)) {
+            return false;
+        }
+        return score > m_threshold;
+    }
+
+    // score of the k-th entry, or the lowest float if there are fewer
+    float threshold() const {
+        return m_threshold;
+    }
+
+    // Queues filled concurrently over disjoint sets of documents can share
+    // the largest of their thresholds: a score below one of them cannot
+    // enter the merged top-k either.
+    void share_threshold(std::atomic<float>* threshold) {
+        m_shared_threshold = threshold;
     }
 
     void finalize() {
-        std::sort_heap(m_q.begin(), m_q.end(), std::greater<float>());
+        std::sort(m_q.begin(), m_q.end(), std::greater<uint64_t>());
+        m_topk.clear();
+        for (auto key : m_q) {
+            m_topk.emplace_back(key_score(key), key_docid(key));
+        }
     }
 
-    std::vector<float> const& topk() const {
-        return m_q;
+    std::vector<entry_type> const& topk() const {
+        return m_topk;
     }
 
     void clear() {
         m_q.clear();
+        m_topk.clear();
+        m_threshold = std::numeric_limits<float>::lowest();
+    }
+
+    static bool precedes(entry_type const& lhs, entry_type const& rhs) {
+        return lhs.first > rhs.first ||
+               (lhs.first == rhs.first && lhs.second < rhs.second);
     }
 
 private:
+    static uint64_t make_key(float score, uint64_t docid) {
+        uint32_t bits;
+        std::memcpy(&bits, &score, sizeof(bits));
+        bits ^= (bits >> 31) ? 0xFFFFFFFF : 0x80000000;
+        return (uint64_t(bits) << 32) | uint32_t(~docid);
+    }
+
+    static float key_score(uint64_t key) {
+        uint32_t bits = key >> 32;
+        bits ^= (bits >> 31) ? 0x80000000 : 0xFFFFFFFF;
+        float score;
+        std::memcpy(&score, &bits, sizeof(score));
+        return score;
+    }
+
+    static uint64_t key_docid(uint64_t key) {
+        return uint32_t(~key);
+    }
+
+    void sift_up(size_t i, uint64_t key) {
+        while (i > 0) {
+            size_t parent = (i - 1) / 4;
+            if (m_q[parent] <= key) break;
+            m_q[i] = m_q[parent];
+            i = parent;
+        }
+        m_q[i] = key;
+    }
+
+    // the new key is larger than the root: move the hole down to a leaf
+    // following the smallest children, without branching on the key, and
+    // then sift the key up from there
+    void replace_top(uint64_t key) {
+        uint64_t* q = m_q.data();
+        size_t size = m_q.size();
+        size_t i = 0;
+        while (4 * i + 4 < size) {
+            size_t c = 4 * i + 1;
+            size_t l = q[c] < q[c + 1] ? c : c + 1;
+            size_t r = q[c + 2] < q[c + 3] ? c + 2 : c + 3;
+            size_t min = q[l] < q[r] ? l : r;
+            q[i] = q[min];
+            i = min;
+        }
+        size_t c = 4 * i + 1;
+        if (c < size) {
+            size_t min = c;
+            for (size_t j = c + 1; j < size; ++j) {
+                min = q[j] < q[min] ? j : min;
+            }
+            q[i] = q[min];
+            i = min;
+        }
+        sift_up(i, key);
+    }
+
+    void update_threshold() {
+        m_threshold = key_score(m_q.front());
+        if (m_shared_threshold) {
+            float shared = m_shared_threshold->load(std::memory_order_relaxed);
+            while (shared < m_threshold &&
+                   !m_shared_threshold->compare_exchange_weak(
+                       shared, m_threshold, std::memory_order_relaxed)) {
+            }
+        }
+    }
+
+    bool above_shared_threshold(float score) const {
+        return score >= m_shared_threshold->load(std::memory_order_relaxed);
+    }
+
     uint64_t m_k;
-    std::vector<float> m_q;
+    float m_threshold;
+    std::vector<uint64_t> m_q;
+    std::vector<entry_type> m_topk;
+    std::atomic<float>* m_shared_threshold;
 };
 
 struct wand_query {
@@ -197,6 +426,13 @@ struct wand_query {
 
     template <typename Index>
     uint64_t operator()(Index const& index, term_id_vec const& terms) {
+        return (*this)(index, terms, 0, index.num_docs());
+    }
+
+    // process only the documents in [min_docid, max_docid)
+    template <typename Index>
+    uint64_t operator()(Index const& index, term_id_vec const& terms,
+                        uint64_t min_docid, uint64_t max_docid) {
         m_topk.clear();
         if (terms.empty())
             return 0;
@@ -216,6 +452,9 @@ struct wand_query {
 
         for (auto term : query_term_freqs) {
             auto list = index[term.first];
+            if (min_docid) {
+                list.next_geq(min_docid);
+            }
             auto q_weight = scorer_type::query_term_weight(
                 term.second, list.size(), num_docs);
             auto max_weight = q_weight * m_wdata->max_term_weight(term.first);
@@ -244,7 +483,7 @@ struct wand_query {
             size_t pivot;
             bool found_pivot = false;
             for (pivot = 0; pivot < ordered_enums.size(); ++pivot) {
-                if (ordered_enums[pivot]->docs_enum.docid() == num_docs) {
+                if (ordered_enums[pivot]->docs_enum.docid() >= max_docid) {
                     break;
                 }
                 upper_bound += ordered_enums[pivot]->max_weight;
@@ -273,7 +512,7 @@ struct wand_query {
                     en->docs_enum.next();
                 }
 
-                m_topk.insert(score);
+                m_topk.insert(score, pivot_id);
                 // resort by docid
                 sort_enums();
             } else {
@@ -299,24 +538,28 @@ struct wand_query {
         return m_topk.topk().size();
     }
 
-    std::vector<float> const& topk() const {
+    std::vector<topk_queue::entry_type> const& topk() const {
         return m_topk.topk();
     }
 
+    void share_threshold(std::atomic<float>* threshold) {
+        m_topk.share_threshold(threshold);
+    }
+
 private:
     wand_data<scorer_type> const* m_wdata;
     topk_queue m_topk;
 };
 
-struct ranked_and_query {
+struct block_max_wand_query {
     typedef bm25 scorer_type;
 
-    ranked_and_query(wand_data<scorer_type> const& wdata, uint64_t k)
+    block_max_wand_query(wand_data<scorer_type> const& wdata, uint64_t k)
         : m_wdata(&wdata)
         , m_topk(k) {}
 
     template <typename Index>
-    uint64_t operator()(Index const& index, term_id_vec terms) {
+    uint64_t operator()(Index const& index, term_id_vec const& terms) {
         m_topk.clear();
         if (terms.empty())
             return 0;
@@ -325,9 +568,12 @@ struct ranked_and_query {
 
         uint64_t num_docs = index.num_docs();
         typedef typename Index::document_enumerator enum_type;
+        typedef typename wand_data<scorer_type>::enumerator wdata_enum;
         struct scored_enum {
             enum_type docs_enum;
+            wdata_enum w;
             float q_weight;
+            float max_weight;
         };
 
         std::vector<scored_enum> enums;
@@ -335,20 +581,221 @@ struct ranked_and_query {
 
         for (auto term : query_term_freqs) {
             auto list = index[term.first];
+            auto w_enum = m_wdata->get_block_wand(term.first);
             auto q_weight = scorer_type::query_term_weight(
                 term.second, list.size(), num_docs);
-            enums.push_back(scored_enum{std::move(list), q_weight});
+            auto max_weight = q_weight * m_wdata->max_term_weight(term.first);
+            enums.push_back(scored_enum{std::move(list), w_enum, q_weight,
+                                        max_weight});
+        }
+
+        std::vector<scored_enum*> ordered_enums;
+        ordered_enums.reserve(enums.size());
+        for (auto& en : enums) {
+            ordered_enums.push_back(&en);
+        }
+
+        auto sort_enums = [&]() {
+            // sort enumerators by increasing docid
+            std::sort(ordered_enums.begin(), ordered_enums.end(),
+                      [](scored_enum* lhs, scored_enum* rhs) {
+                          return lhs->docs_enum.docid() <
+                                 rhs->docs_enum.docid();
+                      });
+        };
+
+        // bubble down the list at position i after it has been advanced
+        auto bubble_down = [&](size_t i) {
+            for (++i; i < ordered_enums.size(); ++i) {
+                if (ordered_enums[i]->docs_enum.docid() <
+                    ordered_enums[i - 1]->docs_enum.docid()) {
+                    std::swap(ordered_enums[i], ordered_enums[i - 1]);
+                } else {
+                    break;
+                }
+            }
+        };
+
+        sort_enums();
+        while (true) {
+            // find pivot
+            float upper_bound = 0;
+            size_t pivot;
+            bool found_pivot = false;
+            uint64_t pivot_id = num_docs;
+            for (pivot = 0; pivot < ordered_enums.size(); ++pivot) {
+                if (ordered_enums[pivot]->docs_enum.docid() == num_docs) {
+                    break;
+                }
+                upper_bound += ordered_enums[pivot]->max_weight;
+                if (m_topk.would_enter(upper_bound)) {
+                    found_pivot = true;
+                    pivot_id = ordered_enums[pivot]->docs_enum.docid();
+                    // include all the lists positioned on the pivot
+                    for (; pivot + 1 < ordered_enums.size() &&
+                           ordered_enums[pivot + 1]->docs_enum.docid() ==
+                               pivot_id;
+                         ++pivot)
+                        ;
+                    break;
+                }
+            }
+
+            // no pivot found, we can stop the search
+            if (!found_pivot) {
+                break;
+            }
+
+            // refine the upper bound with the block maxima of the pivot
+            float block_upper_bound = 0;
+            for (size_t i = 0; i < pivot + 1; ++i) {
+                if (ordered_enums[i]->w.docid() < pivot_id) {
+                    ordered_enums[i]->w.next_geq(pivot_id);
+                }
+                block_upper_bound +=
+                    ordered_enums[i]->w.score() * ordered_enums[i]->q_weight;
+            }
+
+            if (m_topk.would_enter(block_upper_bound)) {
+                // check if pivot is a possible match
+                if (pivot_id == ordered_enums[0]->docs_enum.docid()) {
+                    float score = 0;
+                    float norm_len = m_wdata->norm_len(pivot_id);
+                    for (scored_enum* en : ordered_enums) {
+                        if (en->docs_enum.docid() != pivot_id) {
+                            break;
+                        }
+                        float part_score =
+                            en->q_weight * scorer_type::doc_term_weight(
+                                               en->docs_enum.freq(), norm_len);
+                        score += part_score;
+                        // stop scoring as soon as the document can not make
+                        // it into the top-k
+                        block_upper_bound -=
+                            en->w.score() * en->q_weight - part_score;
+                        if (!m_topk.would_enter(block_upper_bound)) {
+                            break;
+                        }
+                    }
+                    for (scored_enum* en : ordered_enums) {
+                        if (en->docs_enum.docid() != pivot_id) {
+                            break;
+                        }
+                        en->docs_enum.next();
+                    }
+
+                    m_topk.insert(score, pivot_id);
+                    // resort by docid
+                    sort_enums();
+                } else {
+                    // no match, move farthest list up to the pivot
+                    uint64_t next_list = pivot;
+                    for (; ordered_enums[next_list]->docs_enum.docid() ==
+                           pivot_id;
+                         --next_list)
+                        ;
+                    ordered_enums[next_list]->docs_enum.next_geq(pivot_id);
+                    bubble_down(next_list);
+                }
+            } else {
+                // the blocks of the pivot can not make it into the top-k:
+                // skip past the first block boundary, moving the list with
+                // the highest max weight
+                uint64_t next_list = pivot;
+                float max_weight = ordered_enums[next_list]->max_weight;
+                for (size_t i = 0; i < pivot; ++i) {
+                    if (ordered_enums[i]->max_weight > max_weight) {
+                        next_list = i;
+                        max_weight = ordered_enums[i]->max_weight;
+                    }
+                }
+
+                uint64_t next = num_docs;
+                for (size_t i = 0; i <= pivot; ++i) {
+                    if (ordered_enums[i]->w.docid() < next) {
+                        next = ordered_enums[i]->w.docid();
+                    }
+                }
+                next += 1;
+                if (pivot + 1 < ordered_enums.size() &&
+                    ordered_enums[pivot + 1]->docs_enum.docid() < next) {
+                    next = ordered_enums[pivot + 1]->docs_enum.docid();
+                }
+                if (next <= pivot_id) {
+                    next = pivot_id + 1;
+                }
+
+                ordered_enums[next_list]->docs_enum.next_geq(next);
+                bubble_down(next_list);
+            }
+        }
+
+        m_topk.finalize();
+        return m_topk.topk().size();
+    }
+
+    std::vector<topk_queue::entry_type> const& topk() const {
+        return m_topk.topk();
+    }
+
+private:
+    wand_data<scorer_type> const* m_wdata;
+    topk_queue m_topk;
+};
+
+struct ranked_and_query {
+    typedef bm25 scorer_type;
+
+    template <typename Enum>
+    struct scored_enum {
+        Enum docs_enum;
+        float q_weight;
+    };
+
+    ranked_and_query(wand_data<scorer_type> const& wdata, uint64_t k)
+        : m_wdata(&wdata)
+        , m_topk(k) {}
+
+    template <typename Index>
+    uint64_t operator()(Index const& index, term_id_vec terms) {
+        m_topk.clear();
+        if (terms.empty())
+            return 0;
+
+        auto query_term_freqs = query_freqs(terms);
+
+        uint64_t num_docs = index.num_docs();
+        typedef typename Index::document_enumerator enum_type;
+        std::vector<scored_enum<enum_type>> enums;
+        enums.reserve(query_term_freqs.size());
+
+        for (auto term : query_term_freqs) {
+            auto list = index[term.first];
+            auto q_weight = scorer_type::query_term_weight(
+                term.second, list.size(), num_docs);
+            enums.push_back(scored_enum<enum_type>{std::move(list), q_weight});
         }
 
+        return intersect(enums, num_docs);
+    }
+
+    // Top-k of the intersection of the enumerators, which are not required
+    // to come from the same index: the weights are given by the caller.
+    template <typename Enum>
+    uint64_t intersect(std::vector<scored_enum<Enum>>& enums,
+                       uint64_t num_docs) {
+        m_topk.clear();
+
         // sort by increasing frequency
         std::sort(enums.begin(), enums.end(),
-                  [](scored_enum const& lhs, scored_enum const& rhs) {
+                  [](scored_enum<Enum> const& lhs,
+                     scored_enum<Enum> const& rhs) {
                       return lhs.docs_enum.size() < rhs.docs_enum.size();
                   });
 
         uint64_t candidate = enums[0].docs_enum.docid();
         size_t i = 1;
-        while (candidate < index.num_docs()) {
+        while (candidate < num_docs) {
             for (; i < enums.size(); ++i) {
                 enums[i].docs_enum.next_geq(candidate);
                 if (enums[i].docs_enum.docid() != candidate) {
@@ -367,7 +814,7 @@ struct ranked_and_query {
                                  enums[i].docs_enum.freq(), norm_len);
                 }
 
-                m_topk.insert(score);
+                m_topk.insert(score, candidate);
                 enums[0].docs_enum.next();
                 candidate = enums[0].docs_enum.docid();
                 i = 1;
@@ -378,7 +825,7 @@ struct ranked_and_query {
         return m_topk.topk().size();
     }
 
-    std::vector<float> const& topk() const {
+    std::vector<topk_queue::entry_type> const& topk() const {
         return m_topk.topk();
     }
 
@@ -387,10 +834,11 @@ private:
     topk_queue m_topk;
 };
 
-struct ranked_or_query {
+struct block_max_ranked_and_query {
     typedef bm25 scorer_type;
 
-    ranked_or_query(wand_data<scorer_type> const& wdata, uint64_t k)
+    block_max_ranked_and_query(wand_data<scorer_type> const& wdata,
+                               uint64_t k)
         : m_wdata(&wdata)
         , m_topk(k) {}
 
@@ -404,8 +852,10 @@ struct ranked_or_query {
 
         uint64_t num_docs = index.num_docs();
         typedef typename Index::document_enumerator enum_type;
+        typedef typename wand_data<scorer_type>::enumerator wdata_enum;
         struct scored_enum {
             enum_type docs_enum;
+            wdata_enum w;
             float q_weight;
         };
 
@@ -414,44 +864,72 @@ struct ranked_or_query {
 
         for (auto term : query_term_freqs) {
             auto list = index[term.first];
+            auto w_enum = m_wdata->get_block_wand(term.first);
             auto q_weight = scorer_type::query_term_weight(
                 term.second, list.size(), num_docs);
-            enums.push_back(scored_enum{std::move(list), q_weight});
+            enums.push_back(scored_enum{std::move(list), w_enum, q_weight});
         }
 
-        uint64_t cur_doc =
-            std::min_element(
-                enums.begin(), enums.end(),
-                [](scored_enum const& lhs, scored_enum const& rhs) {
-                    return lhs.docs_enum.docid() < rhs.docs_enum.docid();
-                })
-                ->docs_enum.docid();
+        // sort by increasing frequency
+        std::sort(enums.begin(), enums.end(),
+                  [](scored_enum const& lhs, scored_enum const& rhs) {
+                      return lhs.docs_enum.size() < rhs.docs_enum.size();
+                  });
 
-        while (cur_doc < index.num_docs()) {
-            float score = 0;
-            float norm_len = m_wdata->norm_len(cur_doc);
-            uint64_t next_doc = index.num_docs();
-            for (size_t i = 0; i < enums.size(); ++i) {
-                if (enums[i].docs_enum.docid() == cur_doc) {
+        uint64_t candidate = enums[0].docs_enum.docid();
+        size_t i = 1;
+        while (candidate < index.num_docs()) {
+            // check the block upper bound before aligning the lists
+            float block_upper_bound = 0;
+            uint64_t next_block = num_docs;
+            for (auto& en : enums) {
+                en.w.next_geq(candidate);
+                block_upper_bound += en.w.score() * en.q_weight;
+                if (en.w.docid() < next_block) {
+                    next_block = en.w.docid();
+                }
+            }
+
+            if (!m_topk.would_enter(block_upper_bound)) {
+                // no document can make it into the top-k until the end of
+                // the first block that ends
+                next_block = std::max(next_block + 1, candidate + 1);
+                enums[0].docs_enum.next_geq(next_block);
+                candidate = enums[0].docs_enum.docid();
+                i = 1;
+                continue;
+            }
+
+            for (; i < enums.size(); ++i) {
+                enums[i].docs_enum.next_geq(candidate);
+                if (enums[i].docs_enum.docid() != candidate) {
+                    candidate = enums[i].docs_enum.docid();
+                    i = 0;
+                    break;
+                }
+            }
+
+            if (i == enums.size()) {
+                float norm_len = m_wdata->norm_len(candidate);
+                float score = 0;
+                for (i = 0; i < enums.size(); ++i) {
                     score += enums[i].q_weight *
                              scorer_type::doc_term_weight(
                                  enums[i].docs_enum.freq(), norm_len);
-                    enums[i].docs_enum.next();
-                }
-                if (enums[i].docs_enum.docid() < next_doc) {
-                    next_doc = enums[i].docs_enum.docid();
                 }
-            }
 
-            m_topk.insert(score);
-            cur_doc = next_doc;
+                m_topk.insert(score, candidate);
+                enums[0].docs_enum.next();
+                candidate = enums[0].docs_enum.docid();
+                i = 1;
+            }
         }
 
         m_topk.finalize();
         return m_topk.topk().size();
     }
 
-    std::vector<float> const& topk() const {
+    std::vector<topk_queue::entry_type> const& topk() const {
         return m_topk.topk();
     }
 
@@ -460,15 +938,22 @@ private:
     topk_queue m_topk;
 };
 
-struct maxscore_query {
+struct ranked_or_query {
     typedef bm25 scorer_type;
 
-    maxscore_query(wand_data<scorer_type> const& wdata, uint64_t k)
+    ranked_or_query(wand_data<scorer_type> const& wdata, uint64_t k)
         : m_wdata(&wdata)
         , m_topk(k) {}
 
     template <typename Index>
     uint64_t operator()(Index const& index, term_id_vec const& terms) {
+        return (*this)(index, terms, 0, index.num_docs());
+    }
+
+    // process only the documents in [min_docid, max_docid)
+    template <typename Index>
+    uint64_t operator()(Index const& index, term_id_vec const& terms,
+                        uint64_t min_docid, uint64_t max_docid) {
         m_topk.clear();
         if (terms.empty())
             return 0;
@@ -480,7 +965,6 @@ struct maxscore_query {
         struct scored_enum {
             enum_type docs_enum;
             float q_weight;
-            float max_weight;
         };
 
         std::vector<scored_enum> enums;
@@ -488,13 +972,886 @@ struct maxscore_query {
 
         for (auto term : query_term_freqs) {
             auto list = index[term.first];
+            if (min_docid) {
+                list.next_geq(min_docid);
+            }
             auto q_weight = scorer_type::query_term_weight(
                 term.second, list.size(), num_docs);
-            auto max_weight = q_weight * m_wdata->max_term_weight(term.first);
-            enums.push_back(scored_enum{std::move(list), q_weight, max_weight});
+            enums.push_back(scored_enum{std::move(list), q_weight});
         }
 
-        std::vector<scored_enum*> ordered_enums;
+        uint64_t cur_doc =
+            std::min_element(
+                enums.begin(), enums.end(),
+                [](scored_enum const& lhs, scored_enum const& rhs) {
+                    return lhs.docs_enum.docid() < rhs.docs_enum.docid();
+                })
+                ->docs_enum.docid();
+
+        while (cur_doc < max_docid) {
+            float score = 0;
+            float norm_len = m_wdata->norm_len(cur_doc);
+            uint64_t next_doc = index.num_docs();
+            for (size_t i = 0; i < enums.size(); ++i) {
+                if (enums[i].docs_enum.docid() == cur_doc) {
+                    score += enums[i].q_weight *
+                             scorer_type::doc_term_weight(
+                                 enums[i].docs_enum.freq(), norm_len);
+                    enums[i].docs_enum.next();
+                }
+                if (enums[i].docs_enum.docid() < next_doc) {
+                    next_doc = enums[i].docs_enum.docid();
+                }
+            }
+
+            m_topk.insert(score, cur_doc);
+            cur_doc = next_doc;
+        }
+
+        m_topk.finalize();
+        return m_topk.topk().size();
+    }
+
+    std::vector<topk_queue::entry_type> const& topk() const {
+        return m_topk.topk();
+    }
+
+    void share_threshold(std::atomic<float>* threshold) {
+        m_topk.share_threshold(threshold);
+    }
+
+private:
+    wand_data<scorer_type> const* m_wdata;
+    topk_queue m_topk;
+};
+
+// Ranked OR over an index built with quantized impacts in place of the
+// frequencies (see impacts.hpp): the score of a document is the sum of its
+// impacts, each multiplied by the frequency of the term in the query.
+struct ranked_or_impact_query {
+    ranked_or_impact_query(uint64_t k)
+        : m_topk(k) {}
+
+    template <typename Index>
+    uint64_t operator()(Index const& index, term_id_vec const& terms) {
+        m_topk.clear();
+        if (terms.empty())
+            return 0;
+
+        auto query_term_freqs = query_freqs(terms);
+
+        uint64_t num_docs = index.num_docs();
+        typedef typename Index::document_enumerator enum_type;
+        struct scored_enum {
+            enum_type docs_enum;
+            uint64_t q_weight;
+        };
+
+        std::vector<scored_enum> enums;
+        enums.reserve(query_term_freqs.size());
+
+        for (auto term : query_term_freqs) {
+            enums.push_back(scored_enum{index[term.first], term.second});
+        }
+
+        uint64_t cur_doc =
+            std::min_element(
+                enums.begin(), enums.end(),
+                [](scored_enum const& lhs, scored_enum const& rhs) {
+                    return lhs.docs_enum.docid() < rhs.docs_enum.docid();
+                })
+                ->docs_enum.docid();
+
+        while (cur_doc < num_docs) {
+            uint64_t score = 0;
+            uint64_t next_doc = num_docs;
+            for (size_t i = 0; i < enums.size(); ++i) {
+                if (enums[i].docs_enum.docid() == cur_doc) {
+                    score += enums[i].q_weight * enums[i].docs_enum.freq();
+                    enums[i].docs_enum.next();
+                }
+                if (enums[i].docs_enum.docid() < next_doc) {
+                    next_doc = enums[i].docs_enum.docid();
+                }
+            }
+
+            m_topk.insert(score, cur_doc);
+            cur_doc = next_doc;
+        }
+
+        m_topk.finalize();
+        return m_topk.topk().size();
+    }
+
+    std::vector<topk_queue::entry_type> const& topk() const {
+        return m_topk.topk();
+    }
+
+private:
+    topk_queue m_topk;
+};
+
+// WAND over an index of quantized impacts. The max impact of a list is the
+// quantized max term weight of the wand data, which is exact as long as
+// the wand data is the one the impacts were computed with.
+struct wand_impact_query {
+    typedef bm25 scorer_type;
+
+    wand_impact_query(wand_data<scorer_type> const& wdata,
+                      impact_quantizer<scorer_type> const& quantizer,
+                      uint64_t k)
+        : m_wdata(&wdata)
+        , m_quantizer(&quantizer)
+        , m_topk(k) {}
+
+    template <typename Index>
+    uint64_t operator()(Index const& index, term_id_vec const& terms) {
+        m_topk.clear();
+        if (terms.empty())
+            return 0;
+
+        auto query_term_freqs = query_freqs(terms);
+
+        uint64_t num_docs = index.num_docs();
+        typedef typename Index::document_enumerator enum_type;
+        struct scored_enum {
+            enum_type docs_enum;
+            uint64_t q_weight;
+            uint64_t max_weight;
+        };
+
+        std::vector<scored_enum> enums;
+        enums.reserve(query_term_freqs.size());
+
+        for (auto term : query_term_freqs) {
+            auto list = index[term.first];
+            float max_score = scorer_type::query_term_weight(
+                                  1, list.size(), num_docs) *
+                              m_wdata->max_term_weight(term.first);
+            uint64_t max_weight = term.second * (*m_quantizer)(max_score);
+            enums.push_back(
+                scored_enum{std::move(list), term.second, max_weight});
+        }
+
+        std::vector<scored_enum*> ordered_enums;
+        ordered_enums.reserve(enums.size());
+        for (auto& en : enums) {
+            ordered_enums.push_back(&en);
+        }
+
+        auto sort_enums = [&]() {
+            // sort enumerators by increasing docid
+            std::sort(ordered_enums.begin(), ordered_enums.end(),
+                      [](scored_enum* lhs, scored_enum* rhs) {
+                          return lhs->docs_enum.docid() <
+                                 rhs->docs_enum.docid();
+                      });
+        };
+
+        sort_enums();
+        while (true) {
+            // find pivot
+            uint64_t upper_bound = 0;
+            size_t pivot;
+            bool found_pivot = false;
+            for (pivot = 0; pivot < ordered_enums.size(); ++pivot) {
+                if (ordered_enums[pivot]->docs_enum.docid() == num_docs) {
+                    break;
+                }
+                upper_bound += ordered_enums[pivot]->max_weight;
+                if (m_topk.would_enter(upper_bound)) {
+                    found_pivot = true;
+                    break;
+                }
+            }
+
+            // no pivot found, we can stop the search
+            if (!found_pivot) {
+                break;
+            }
+
+            // check if pivot is a possible match
+            uint64_t pivot_id = ordered_enums[pivot]->docs_enum.docid();
+            if (pivot_id == ordered_enums[0]->docs_enum.docid()) {
+                uint64_t score = 0;
+                for (scored_enum* en : ordered_enums) {
+                    if (en->docs_enum.docid() != pivot_id) {
+                        break;
+                    }
+                    score += en->q_weight * en->docs_enum.freq();
+                    en->docs_enum.next();
+                }
+
+                m_topk.insert(score, pivot_id);
+                // resort by docid
+                sort_enums();
+            } else {
+                // no match, move farthest list up to the pivot
+                uint64_t next_list = pivot;
+                for (; ordered_enums[next_list]->docs_enum.docid() == pivot_id;
+                     --next_list)
+                    ;
+                ordered_enums[next_list]->docs_enum.next_geq(pivot_id);
+                // bubble down the advanced list
+                for (size_t i = next_list + 1; i < ordered_enums.size(); ++i) {
+                    if (ordered_enums[i]->docs_enum.docid() <
+                        ordered_enums[i - 1]->docs_enum.docid()) {
+                        std::swap(ordered_enums[i], ordered_enums[i - 1]);
+                    } else {
+                        break;
+                    }
+                }
+            }
+        }
+
+        m_topk.finalize();
+        return m_topk.topk().size();
+    }
+
+    std::vector<topk_queue::entry_type> const& topk() const {
+        return m_topk.topk();
+    }
+
+private:
+    wand_data<scorer_type> const* m_wdata;
+    impact_quantizer<scorer_type> const* m_quantizer;
+    topk_queue m_topk;
+};
+
+// The block-max and maxscore operators over an index of quantized impacts,
+// as wand_impact_query: the bound of a list, or of one of its blocks, is the
+// quantized max term weight of the wand data times the frequency of the
+// term in the query. The quantizer is monotone, so these bound the impacts
+// of the postings as long as the wand data is the one the impacts were
+// computed with.
+struct maxscore_impact_query {
+    typedef bm25 scorer_type;
+
+    maxscore_impact_query(wand_data<scorer_type> const& wdata,
+                          impact_quantizer<scorer_type> const& quantizer,
+                          uint64_t k)
+        : m_wdata(&wdata)
+        , m_quantizer(&quantizer)
+        , m_topk(k) {}
+
+    template <typename Index>
+    uint64_t operator()(Index const& index, term_id_vec const& terms) {
+        m_topk.clear();
+        if (terms.empty())
+            return 0;
+
+        auto query_term_freqs = query_freqs(terms);
+
+        uint64_t num_docs = index.num_docs();
+        typedef typename Index::document_enumerator enum_type;
+        struct scored_enum {
+            enum_type docs_enum;
+            uint64_t q_weight;
+            uint64_t max_weight;
+        };
+
+        std::vector<scored_enum> enums;
+        enums.reserve(query_term_freqs.size());
+
+        for (auto term : query_term_freqs) {
+            auto list = index[term.first];
+            float max_score = scorer_type::query_term_weight(
+                                  1, list.size(), num_docs) *
+                              m_wdata->max_term_weight(term.first);
+            uint64_t max_weight = term.second * (*m_quantizer)(max_score);
+            enums.push_back(
+                scored_enum{std::move(list), term.second, max_weight});
+        }
+
+        std::vector<scored_enum*> ordered_enums;
+        ordered_enums.reserve(enums.size());
+        for (auto& en : enums) {
+            ordered_enums.push_back(&en);
+        }
+
+        // sort enumerators by increasing maxscore
+        std::sort(ordered_enums.begin(), ordered_enums.end(),
+                  [](scored_enum* lhs, scored_enum* rhs) {
+                      return lhs->max_weight < rhs->max_weight;
+                  });
+
+        std::vector<uint64_t> upper_bounds(ordered_enums.size());
+        upper_bounds[0] = ordered_enums[0]->max_weight;
+        for (size_t i = 1; i < ordered_enums.size(); ++i) {
+            upper_bounds[i] =
+                upper_bounds[i - 1] + ordered_enums[i]->max_weight;
+        }
+
+        uint64_t non_essential_lists = 0;
+        uint64_t cur_doc =
+            std::min_element(
+                enums.begin(), enums.end(),
+                [](scored_enum const& lhs, scored_enum const& rhs) {
+                    return lhs.docs_enum.docid() < rhs.docs_enum.docid();
+                })
+                ->docs_enum.docid();
+
+        while (non_essential_lists < ordered_enums.size() &&
+               cur_doc < num_docs) {
+            uint64_t score = 0;
+            uint64_t next_doc = num_docs;
+            for (size_t i = non_essential_lists; i < ordered_enums.size();
+                 ++i) {
+                if (ordered_enums[i]->docs_enum.docid() == cur_doc) {
+                    score += ordered_enums[i]->q_weight *
+                             ordered_enums[i]->docs_enum.freq();
+                    ordered_enums[i]->docs_enum.next();
+                }
+                if (ordered_enums[i]->docs_enum.docid() < next_doc) {
+                    next_doc = ordered_enums[i]->docs_enum.docid();
+                }
+            }
+
+            // try to complete evaluation with non-essential lists
+            for (size_t i = non_essential_lists - 1; i + 1 > 0; --i) {
+                if (!m_topk.would_enter(score + upper_bounds[i])) {
+                    break;
+                }
+                ordered_enums[i]->docs_enum.next_geq(cur_doc);
+                if (ordered_enums[i]->docs_enum.docid() == cur_doc) {
+                    score += ordered_enums[i]->q_weight *
+                             ordered_enums[i]->docs_enum.freq();
+                }
+            }
+
+            if (m_topk.insert(score, cur_doc)) {
+                // update non-essential lists
+                while (non_essential_lists < ordered_enums.size() &&
+                       !m_topk.would_enter(upper_bounds[non_essential_lists])) {
+                    non_essential_lists += 1;
+                }
+            }
+
+            cur_doc = next_doc;
+        }
+
+        m_topk.finalize();
+        return m_topk.topk().size();
+    }
+
+    std::vector<topk_queue::entry_type> const& topk() const {
+        return m_topk.topk();
+    }
+
+private:
+    wand_data<scorer_type> const* m_wdata;
+    impact_quantizer<scorer_type> const* m_quantizer;
+    topk_queue m_topk;
+};
+
+struct block_max_wand_impact_query {
+    typedef bm25 scorer_type;
+
+    block_max_wand_impact_query(wand_data<scorer_type> const& wdata,
+                                impact_quantizer<scorer_type> const& quantizer,
+                                uint64_t k)
+        : m_wdata(&wdata)
+        , m_quantizer(&quantizer)
+        , m_topk(k) {}
+
+    template <typename Index>
+    uint64_t operator()(Index const& index, term_id_vec const& terms) {
+        m_topk.clear();
+        if (terms.empty())
+            return 0;
+
+        auto query_term_freqs = query_freqs(terms);
+
+        uint64_t num_docs = index.num_docs();
+        typedef typename Index::document_enumerator enum_type;
+        typedef typename wand_data<scorer_type>::enumerator wdata_enum;
+        struct scored_enum {
+            enum_type docs_enum;
+            wdata_enum w;
+            float term_weight;  // for a query term frequency of 1
+            uint64_t q_weight;
+            uint64_t max_weight;
+        };
+
+        std::vector<scored_enum> enums;
+        enums.reserve(query_term_freqs.size());
+
+        for (auto term : query_term_freqs) {
+            auto list = index[term.first];
+            auto w_enum = m_wdata->get_block_wand(term.first);
+            float term_weight =
+                scorer_type::query_term_weight(1, list.size(), num_docs);
+            uint64_t max_weight =
+                term.second * (*m_quantizer)(
+                                  term_weight *
+                                  m_wdata->max_term_weight(term.first));
+            enums.push_back(scored_enum{std::move(list), w_enum, term_weight,
+                                        term.second, max_weight});
+        }
+
+        auto block_weight = [&](scored_enum const& en) {
+            return en.q_weight * (*m_quantizer)(en.term_weight * en.w.score());
+        };
+
+        std::vector<scored_enum*> ordered_enums;
+        ordered_enums.reserve(enums.size());
+        for (auto& en : enums) {
+            ordered_enums.push_back(&en);
+        }
+
+        auto sort_enums = [&]() {
+            // sort enumerators by increasing docid
+            std::sort(ordered_enums.begin(), ordered_enums.end(),
+                      [](scored_enum* lhs, scored_enum* rhs) {
+                          return lhs->docs_enum.docid() <
+                                 rhs->docs_enum.docid();
+                      });
+        };
+
+        // bubble down the list at position i after it has been advanced
+        auto bubble_down = [&](size_t i) {
+            for (++i; i < ordered_enums.size(); ++i) {
+                if (ordered_enums[i]->docs_enum.docid() <
+                    ordered_enums[i - 1]->docs_enum.docid()) {
+                    std::swap(ordered_enums[i], ordered_enums[i - 1]);
+                } else {
+                    break;
+                }
+            }
+        };
+
+        sort_enums();
+        while (true) {
+            // find pivot
+            uint64_t upper_bound = 0;
+            size_t pivot;
+            bool found_pivot = false;
+            uint64_t pivot_id = num_docs;
+            for (pivot = 0; pivot < ordered_enums.size(); ++pivot) {
+                if (ordered_enums[pivot]->docs_enum.docid() == num_docs) {
+                    break;
+                }
+                upper_bound += ordered_enums[pivot]->max_weight;
+                if (m_topk.would_enter(upper_bound)) {
+                    found_pivot = true;
+                    pivot_id = ordered_enums[pivot]->docs_enum.docid();
+                    // include all the lists positioned on the pivot
+                    for (; pivot + 1 < ordered_enums.size() &&
+                           ordered_enums[pivot + 1]->docs_enum.docid() ==
+                               pivot_id;
+                         ++pivot)
+                        ;
+                    break;
+                }
+            }
+
+            // no pivot found, we can stop the search
+            if (!found_pivot) {
+                break;
+            }
+
+            // refine the upper bound with the block maxima of the pivot
+            uint64_t block_upper_bound = 0;
+            for (size_t i = 0; i < pivot + 1; ++i) {
+                if (ordered_enums[i]->w.docid() < pivot_id) {
+                    ordered_enums[i]->w.next_geq(pivot_id);
+                }
+                block_upper_bound += block_weight(*ordered_enums[i]);
+            }
+
+            if (m_topk.would_enter(block_upper_bound)) {
+                // check if pivot is a possible match
+                if (pivot_id == ordered_enums[0]->docs_enum.docid()) {
+                    uint64_t score = 0;
+                    for (scored_enum* en : ordered_enums) {
+                        if (en->docs_enum.docid() != pivot_id) {
+                            break;
+                        }
+                        uint64_t part_score =
+                            en->q_weight * en->docs_enum.freq();
+                        score += part_score;
+                        // stop scoring as soon as the document can not make
+                        // it into the top-k
+                        block_upper_bound -= block_weight(*en) - part_score;
+                        if (!m_topk.would_enter(block_upper_bound)) {
+                            break;
+                        }
+                    }
+                    for (scored_enum* en : ordered_enums) {
+                        if (en->docs_enum.docid() != pivot_id) {
+                            break;
+                        }
+                        en->docs_enum.next();
+                    }
+
+                    m_topk.insert(score, pivot_id);
+                    // resort by docid
+                    sort_enums();
+                } else {
+                    // no match, move farthest list up to the pivot
+                    uint64_t next_list = pivot;
+                    for (; ordered_enums[next_list]->docs_enum.docid() ==
+                           pivot_id;
+                         --next_list)
+                        ;
+                    ordered_enums[next_list]->docs_enum.next_geq(pivot_id);
+                    bubble_down(next_list);
+                }
+            } else {
+                // the blocks of the pivot can not make it into the top-k:
+                // skip past the first block boundary, moving the list with
+                // the highest max weight
+                uint64_t next_list = pivot;
+                uint64_t max_weight = ordered_enums[next_list]->max_weight;
+                for (size_t i = 0; i < pivot; ++i) {
+                    if (ordered_enums[i]->max_weight > max_weight) {
+                        next_list = i;
+                        max_weight = ordered_enums[i]->max_weight;
+                    }
+                }
+
+                uint64_t next = num_docs;
+                for (size_t i = 0; i <= pivot; ++i) {
+                    if (ordered_enums[i]->w.docid() < next) {
+                        next = ordered_enums[i]->w.docid();
+                    }
+                }
+                next += 1;
+                if (pivot + 1 < ordered_enums.size() &&
+                    ordered_enums[pivot + 1]->docs_enum.docid() < next) {
+                    next = ordered_enums[pivot + 1]->docs_enum.docid();
+                }
+                if (next <= pivot_id) {
+                    next = pivot_id + 1;
+                }
+
+                ordered_enums[next_list]->docs_enum.next_geq(next);
+                bubble_down(next_list);
+            }
+        }
+
+        m_topk.finalize();
+        return m_topk.topk().size();
+    }
+
+    std::vector<topk_queue::entry_type> const& topk() const {
+        return m_topk.topk();
+    }
+
+private:
+    wand_data<scorer_type> const* m_wdata;
+    impact_quantizer<scorer_type> const* m_quantizer;
+    topk_queue m_topk;
+};
+
+struct block_max_ranked_and_impact_query {
+    typedef bm25 scorer_type;
+
+    block_max_ranked_and_impact_query(
+        wand_data<scorer_type> const& wdata,
+        impact_quantizer<scorer_type> const& quantizer, uint64_t k)
+        : m_wdata(&wdata)
+        , m_quantizer(&quantizer)
+        , m_topk(k) {}
+
+    template <typename Index>
+    uint64_t operator()(Index const& index, term_id_vec terms) {
+        m_topk.clear();
+        if (terms.empty())
+            return 0;
+
+        auto query_term_freqs = query_freqs(terms);
+
+        uint64_t num_docs = index.num_docs();
+        typedef typename Index::document_enumerator enum_type;
+        typedef typename wand_data<scorer_type>::enumerator wdata_enum;
+        struct scored_enum {
+            enum_type docs_enum;
+            wdata_enum w;
+            float term_weight;  // for a query term frequency of 1
+            uint64_t q_weight;
+        };
+
+        std::vector<scored_enum> enums;
+        enums.reserve(query_term_freqs.size());
+
+        for (auto term : query_term_freqs) {
+            auto list = index[term.first];
+            auto w_enum = m_wdata->get_block_wand(term.first);
+            float term_weight =
+                scorer_type::query_term_weight(1, list.size(), num_docs);
+            enums.push_back(scored_enum{std::move(list), w_enum, term_weight,
+                                        term.second});
+        }
+
+        // sort by increasing frequency
+        std::sort(enums.begin(), enums.end(),
+                  [](scored_enum const& lhs, scored_enum const& rhs) {
+                      return lhs.docs_enum.size() < rhs.docs_enum.size();
+                  });
+
+        uint64_t candidate = enums[0].docs_enum.docid();
+        size_t i = 1;
+        while (candidate < num_docs) {
+            // check the block upper bound before aligning the lists
+            uint64_t block_upper_bound = 0;
+            uint64_t next_block = num_docs;
+            for (auto& en : enums) {
+                en.w.next_geq(candidate);
+                block_upper_bound +=
+                    en.q_weight * (*m_quantizer)(en.term_weight * en.w.score());
+                if (en.w.docid() < next_block) {
+                    next_block = en.w.docid();
+                }
+            }
+
+            if (!m_topk.would_enter(block_upper_bound)) {
+                // no document can make it into the top-k until the end of
+                // the first block that ends
+                next_block = std::max(next_block + 1, candidate + 1);
+                enums[0].docs_enum.next_geq(next_block);
+                candidate = enums[0].docs_enum.docid();
+                i = 1;
+                continue;
+            }
+
+            for (; i < enums.size(); ++i) {
+                enums[i].docs_enum.next_geq(candidate);
+                if (enums[i].docs_enum.docid() != candidate) {
+                    candidate = enums[i].docs_enum.docid();
+                    i = 0;
+                    break;
+                }
+            }
+
+            if (i == enums.size()) {
+                uint64_t score = 0;
+                for (i = 0; i < enums.size(); ++i) {
+                    score += enums[i].q_weight * enums[i].docs_enum.freq();
+                }
+
+                m_topk.insert(score, candidate);
+                enums[0].docs_enum.next();
+                candidate = enums[0].docs_enum.docid();
+                i = 1;
+            }
+        }
+
+        m_topk.finalize();
+        return m_topk.topk().size();
+    }
+
+    std::vector<topk_queue::entry_type> const& topk() const {
+        return m_topk.topk();
+    }
+
+private:
+    wand_data<scorer_type> const* m_wdata;
+    impact_quantizer<scorer_type> const* m_quantizer;
+    topk_queue m_topk;
+};
+
+struct block_max_maxscore_impact_query {
+    typedef bm25 scorer_type;
+
+    block_max_maxscore_impact_query(
+        wand_data<scorer_type> const& wdata,
+        impact_quantizer<scorer_type> const& quantizer, uint64_t k)
+        : m_wdata(&wdata)
+        , m_quantizer(&quantizer)
+        , m_topk(k) {}
+
+    template <typename Index>
+    uint64_t operator()(Index const& index, term_id_vec const& terms) {
+        m_topk.clear();
+        if (terms.empty())
+            return 0;
+
+        auto query_term_freqs = query_freqs(terms);
+
+        uint64_t num_docs = index.num_docs();
+        typedef typename Index::document_enumerator enum_type;
+        typedef typename wand_data<scorer_type>::enumerator wdata_enum;
+        struct scored_enum {
+            enum_type docs_enum;
+            wdata_enum w;
+            float term_weight;  // for a query term frequency of 1
+            uint64_t q_weight;
+            uint64_t max_weight;
+        };
+
+        std::vector<scored_enum> enums;
+        enums.reserve(query_term_freqs.size());
+
+        for (auto term : query_term_freqs) {
+            auto list = index[term.first];
+            auto w_enum = m_wdata->get_block_wand(term.first);
+            float term_weight =
+                scorer_type::query_term_weight(1, list.size(), num_docs);
+            uint64_t max_weight =
+                term.second * (*m_quantizer)(
+                                  term_weight *
+                                  m_wdata->max_term_weight(term.first));
+            enums.push_back(scored_enum{std::move(list), w_enum, term_weight,
+                                        term.second, max_weight});
+        }
+
+        auto block_weight = [&](scored_enum const& en) {
+            return en.q_weight * (*m_quantizer)(en.term_weight * en.w.score());
+        };
+
+        std::vector<scored_enum*> ordered_enums;
+        ordered_enums.reserve(enums.size());
+        for (auto& en : enums) {
+            ordered_enums.push_back(&en);
+        }
+
+        // sort enumerators by increasing maxscore
+        std::sort(ordered_enums.begin(), ordered_enums.end(),
+                  [](scored_enum* lhs, scored_enum* rhs) {
+                      return lhs->max_weight < rhs->max_weight;
+                  });
+
+        std::vector<uint64_t> upper_bounds(ordered_enums.size());
+        upper_bounds[0] = ordered_enums[0]->max_weight;
+        for (size_t i = 1; i < ordered_enums.size(); ++i) {
+            upper_bounds[i] =
+                upper_bounds[i - 1] + ordered_enums[i]->max_weight;
+        }
+
+        uint64_t non_essential_lists = 0;
+        uint64_t cur_doc =
+            std::min_element(
+                enums.begin(), enums.end(),
+                [](scored_enum const& lhs, scored_enum const& rhs) {
+                    return lhs.docs_enum.docid() < rhs.docs_enum.docid();
+                })
+                ->docs_enum.docid();
+
+        while (non_essential_lists < ordered_enums.size() &&
+               cur_doc < num_docs) {
+            // block upper bound of the essential lists containing cur_doc
+            // and of all the non-essential lists
+            uint64_t block_upper_bound = 0;
+            for (size_t i = non_essential_lists; i < ordered_enums.size();
+                 ++i) {
+                if (ordered_enums[i]->docs_enum.docid() == cur_doc) {
+                    ordered_enums[i]->w.next_geq(cur_doc);
+                    block_upper_bound += block_weight(*ordered_enums[i]);
+                }
+            }
+            for (size_t i = 0; i < non_essential_lists; ++i) {
+                ordered_enums[i]->w.next_geq(cur_doc);
+                block_upper_bound += block_weight(*ordered_enums[i]);
+            }
+
+            // decode impacts and score only if cur_doc can make it into the
+            // top-k
+            if (m_topk.would_enter(block_upper_bound)) {
+                uint64_t score = 0;
+                for (size_t i = non_essential_lists; i < ordered_enums.size();
+                     ++i) {
+                    if (ordered_enums[i]->docs_enum.docid() == cur_doc) {
+                        uint64_t part_score =
+                            ordered_enums[i]->q_weight *
+                            ordered_enums[i]->docs_enum.freq();
+                        block_upper_bound -=
+                            block_weight(*ordered_enums[i]) - part_score;
+                        score += part_score;
+                    }
+                }
+
+                // try to complete evaluation with non-essential lists
+                for (size_t i = non_essential_lists - 1; i + 1 > 0; --i) {
+                    if (!m_topk.would_enter(block_upper_bound)) {
+                        break;
+                    }
+                    ordered_enums[i]->docs_enum.next_geq(cur_doc);
+                    uint64_t block_score = block_weight(*ordered_enums[i]);
+                    if (ordered_enums[i]->docs_enum.docid() == cur_doc) {
+                        uint64_t part_score =
+                            ordered_enums[i]->q_weight *
+                            ordered_enums[i]->docs_enum.freq();
+                        block_upper_bound -= block_score - part_score;
+                        score += part_score;
+                    } else {
+                        block_upper_bound -= block_score;
+                    }
+                }
+
+                if (m_topk.insert(score, cur_doc)) {
+                    // update non-essential lists
+                    while (non_essential_lists < ordered_enums.size() &&
+                           !m_topk.would_enter(
+                               upper_bounds[non_essential_lists])) {
+                        non_essential_lists += 1;
+                    }
+                }
+            }
+
+            uint64_t next_doc = num_docs;
+            for (size_t i = non_essential_lists; i < ordered_enums.size();
+                 ++i) {
+                if (ordered_enums[i]->docs_enum.docid() == cur_doc) {
+                    ordered_enums[i]->docs_enum.next();
+                }
+                if (ordered_enums[i]->docs_enum.docid() < next_doc) {
+                    next_doc = ordered_enums[i]->docs_enum.docid();
+                }
+            }
+
+            cur_doc = next_doc;
+        }
+
+        m_topk.finalize();
+        return m_topk.topk().size();
+    }
+
+    std::vector<topk_queue::entry_type> const& topk() const {
+        return m_topk.topk();
+    }
+
+private:
+    wand_data<scorer_type> const* m_wdata;
+    impact_quantizer<scorer_type> const* m_quantizer;
+    topk_queue m_topk;
+};
+
+struct maxscore_query {
+    typedef bm25 scorer_type;
+
+    maxscore_query(wand_data<scorer_type> const& wdata, uint64_t k)
+        : m_wdata(&wdata)
+        , m_topk(k) {}
+
+    template <typename Index>
+    uint64_t operator()(Index const& index, term_id_vec const& terms) {
+        m_topk.clear();
+        if (terms.empty())
+            return 0;
+
+        auto query_term_freqs = query_freqs(terms);
+
+        uint64_t num_docs = index.num_docs();
+        typedef typename Index::document_enumerator enum_type;
+        struct scored_enum {
+            enum_type docs_enum;
+            float q_weight;
+            float max_weight;
+        };
+
+        std::vector<scored_enum> enums;
+        enums.reserve(query_term_freqs.size());
+
+        for (auto term : query_term_freqs) {
+            auto list = index[term.first];
+            auto q_weight = scorer_type::query_term_weight(
+                term.second, list.size(), num_docs);
+            auto max_weight = q_weight * m_wdata->max_term_weight(term.first);
+            enums.push_back(scored_enum{std::move(list), q_weight, max_weight});
+        }
+
+        std::vector<scored_enum*> ordered_enums;
         ordered_enums.reserve(enums.size());
         for (auto& en : enums) {
             ordered_enums.push_back(&en);
@@ -553,7 +1910,7 @@ struct maxscore_query {
                 }
             }
 
-            if (m_topk.insert(score)) {
+            if (m_topk.insert(score, cur_doc)) {
                 // update non-essential lists
                 while (non_essential_lists < ordered_enums.size() &&
                        !m_topk.would_enter(upper_bounds[non_essential_lists])) {
@@ -568,7 +1925,168 @@ struct maxscore_query {
         return m_topk.topk().size();
     }
 
-    std::vector<float> const& topk() const {
+    std::vector<topk_queue::entry_type> const& topk() const {
+        return m_topk.topk();
+    }
+
+private:
+    wand_data<scorer_type> const* m_wdata;
+    topk_queue m_topk;
+};
+
+struct block_max_maxscore_query {
+    typedef bm25 scorer_type;
+
+    block_max_maxscore_query(wand_data<scorer_type> const& wdata, uint64_t k)
+        : m_wdata(&wdata)
+        , m_topk(k) {}
+
+    template <typename Index>
+    uint64_t operator()(Index const& index, term_id_vec const& terms) {
+        m_topk.clear();
+        if (terms.empty())
+            return 0;
+
+        auto query_term_freqs = query_freqs(terms);
+
+        uint64_t num_docs = index.num_docs();
+        typedef typename Index::document_enumerator enum_type;
+        typedef typename wand_data<scorer_type>::enumerator wdata_enum;
+        struct scored_enum {
+            enum_type docs_enum;
+            wdata_enum w;
+            float q_weight;
+            float max_weight;
+        };
+
+        std::vector<scored_enum> enums;
+        enums.reserve(query_term_freqs.size());
+
+        for (auto term : query_term_freqs) {
+            auto list = index[term.first];
+            auto w_enum = m_wdata->get_block_wand(term.first);
+            auto q_weight = scorer_type::query_term_weight(
+                term.second, list.size(), num_docs);
+            auto max_weight = q_weight * m_wdata->max_term_weight(term.first);
+            enums.push_back(scored_enum{std::move(list), w_enum, q_weight,
+                                        max_weight});
+        }
+
+        std::vector<scored_enum*> ordered_enums;
+        ordered_enums.reserve(enums.size());
+        for (auto& en : enums) {
+            ordered_enums.push_back(&en);
+        }
+
+        // sort enumerators by increasing maxscore
+        std::sort(ordered_enums.begin(), ordered_enums.end(),
+                  [](scored_enum* lhs, scored_enum* rhs) {
+                      return lhs->max_weight < rhs->max_weight;
+                  });
+
+        std::vector<float> upper_bounds(ordered_enums.size());
+        upper_bounds[0] = ordered_enums[0]->max_weight;
+        for (size_t i = 1; i < ordered_enums.size(); ++i) {
+            upper_bounds[i] =
+                upper_bounds[i - 1] + ordered_enums[i]->max_weight;
+        }
+
+        uint64_t non_essential_lists = 0;
+        uint64_t cur_doc =
+            std::min_element(
+                enums.begin(), enums.end(),
+                [](scored_enum const& lhs, scored_enum const& rhs) {
+                    return lhs.docs_enum.docid() < rhs.docs_enum.docid();
+                })
+                ->docs_enum.docid();
+
+        while (non_essential_lists < ordered_enums.size() &&
+               cur_doc < index.num_docs()) {
+            // block upper bound of the essential lists containing cur_doc
+            // and of all the non-essential lists
+            float block_upper_bound = 0;
+            for (size_t i = non_essential_lists; i < ordered_enums.size();
+                 ++i) {
+                if (ordered_enums[i]->docs_enum.docid() == cur_doc) {
+                    ordered_enums[i]->w.next_geq(cur_doc);
+                    block_upper_bound += ordered_enums[i]->w.score() *
+                                         ordered_enums[i]->q_weight;
+                }
+            }
+            for (size_t i = 0; i < non_essential_lists; ++i) {
+                ordered_enums[i]->w.next_geq(cur_doc);
+                block_upper_bound +=
+                    ordered_enums[i]->w.score() * ordered_enums[i]->q_weight;
+            }
+
+            // decode freqs and score only if cur_doc can make it into the
+            // top-k
+            if (m_topk.would_enter(block_upper_bound)) {
+                float score = 0;
+                float norm_len = m_wdata->norm_len(cur_doc);
+                for (size_t i = non_essential_lists; i < ordered_enums.size();
+                     ++i) {
+                    if (ordered_enums[i]->docs_enum.docid() == cur_doc) {
+                        float part_score =
+                            ordered_enums[i]->q_weight *
+                            scorer_type::doc_term_weight(
+                                ordered_enums[i]->docs_enum.freq(), norm_len);
+                        block_upper_bound -= ordered_enums[i]->w.score() *
+                                                 ordered_enums[i]->q_weight -
+                                             part_score;
+                        score += part_score;
+                    }
+                }
+
+                // try to complete evaluation with non-essential lists
+                for (size_t i = non_essential_lists - 1; i + 1 > 0; --i) {
+                    if (!m_topk.would_enter(block_upper_bound)) {
+                        break;
+                    }
+                    ordered_enums[i]->docs_enum.next_geq(cur_doc);
+                    float block_score = ordered_enums[i]->w.score() *
+                                        ordered_enums[i]->q_weight;
+                    if (ordered_enums[i]->docs_enum.docid() == cur_doc) {
+                        float part_score =
+                            ordered_enums[i]->q_weight *
+                            scorer_type::doc_term_weight(
+                                ordered_enums[i]->docs_enum.freq(), norm_len);
+                        block_upper_bound -= block_score - part_score;
+                        score += part_score;
+                    } else {
+                        block_upper_bound -= block_score;
+                    }
+                }
+
+                if (m_topk.insert(score, cur_doc)) {
+                    // update non-essential lists
+                    while (non_essential_lists < ordered_enums.size() &&
+                           !m_topk.would_enter(
+                               upper_bounds[non_essential_lists])) {
+                        non_essential_lists += 1;
+                    }
+                }
+            }
+
+            uint64_t next_doc = index.num_docs();
+            for (size_t i = non_essential_lists; i < ordered_enums.size();
+                 ++i) {
+                if (ordered_enums[i]->docs_enum.docid() == cur_doc) {
+                    ordered_enums[i]->docs_enum.next();
+                }
+                if (ordered_enums[i]->docs_enum.docid() < next_doc) {
+                    next_doc = ordered_enums[i]->docs_enum.docid();
+                }
+            }
+
+            cur_doc = next_doc;
+        }
+
+        m_topk.finalize();
+        return m_topk.topk().size();
+    }
+
+    std::vector<topk_queue::entry_type> const& topk() const {
         return m_topk.topk();
     }
 
@@ -577,4 +2095,126 @@ private:
     topk_queue m_topk;
 };
 
+// Intra-query parallelism: the docid space is split into as many ranges as
+// workers, each range is processed by its own copy of QueryOperator (which
+// must support ranged evaluation, like wand_query and ranked_or_query), and
+// the local top-k lists are merged. The workers share their top-k threshold
+// so that pruning is as effective as in a sequential traversal. The threads
+// are started once, with the object, and are woken up for each query, as
+// creating them would cost more than a short query.
+template <typename QueryOperator>
+struct parallel_ranked_query {
+    parallel_ranked_query(QueryOperator const& query_op, uint64_t k,
+                          size_t num_threads)
+        : m_k(k)
+        , m_workers(std::max(num_threads, size_t(1)), query_op) {
+        start_threads();
+    }
+
+    // each copy has its own threads
+    parallel_ranked_query(parallel_ranked_query const& other)
+        : m_k(other.m_k)
+        , m_workers(other.m_workers) {
+        start_threads();
+    }
+
+    parallel_ranked_query& operator=(parallel_ranked_query const&) = delete;
+
+    ~parallel_ranked_query() {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_stop = true;
+        }
+        m_start.notify_all();
+        for (auto& t : m_threads) t.join();
+    }
+
+    template <typename Index>
+    uint64_t operator()(Index const& index, term_id_vec const& terms) {
+        m_topk.clear();
+        if (terms.empty())
+            return 0;
+
+        std::atomic<float> threshold(std::numeric_limits<float>::lowest());
+        size_t num_workers = m_workers.size();
+        uint64_t num_docs = index.num_docs();
+        std::function<void(size_t)> run = [&](size_t i) {
+            m_workers[i].share_threshold(&threshold);
+            m_workers[i](index, terms, num_docs * i / num_workers,
+                         num_docs * (i + 1) / num_workers);
+            m_workers[i].share_threshold(nullptr);
+        };
+        run_all(run);
+
+        for (auto const& w : m_workers) {
+            m_topk.insert(m_topk.end(), w.topk().begin(), w.topk().end());
+        }
+        std::sort(m_topk.begin(), m_topk.end(), topk_queue::precedes);
+        if (m_topk.size() > m_k) {
+            m_topk.resize(m_k);
+        }
+        return m_topk.size();
+    }
+
+    std::vector<topk_queue::entry_type> const& topk() const {
+        return m_topk;
+    }
+
+private:
+    // workers 1, 2, ... run in m_threads[0, 1, ...], worker 0 in the caller
+    void start_threads() {
+        for (size_t i = 1; i < m_workers.size(); ++i) {
+            m_threads.emplace_back([this, i]() { thread_loop(i); });
+        }
+    }
+
+    void run_all(std::function<void(size_t)> const& job) {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_job = &job;
+            m_pending = m_threads.size();
+            ++m_generation;
+        }
+        m_start.notify_all();
+        job(0);
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_done.wait(lock, [&]() { return m_pending == 0; });
+    }
+
+    void thread_loop(size_t i) {
+        uint64_t generation = 0;
+        while (true) {
+            std::function<void(size_t)> const* job;
+            {
+                std::unique_lock<std::mutex> lock(m_mutex);
+                m_start.wait(lock, [&]() {
+                    return m_stop || m_generation != generation;
+                });
+                if (m_stop)
+                    return;
+                generation = m_generation;
+                job = m_job;
+            }
+            (*job)(i);
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (--m_pending == 0) {
+                m_done.notify_one();
+            }
+        }
+    }
+
+    uint64_t m_k;
+    std::vector<QueryOperator> m_workers;
+    std::vector<topk_queue::entry_type> m_topk;
+
+    std::vector<std::thread> m_threads;
+    std::mutex m_mutex;
+    std::condition_variable m_start;
+    std::condition_variable m_done;
+    std::function<void(size_t)> const* m_job = nullptr;
+    size_t m_pending = 0;
+    uint64_t m_generation = 0;
+    bool m_stop = false;
+};
+
 }  // namespace ds2i
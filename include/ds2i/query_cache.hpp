@@ -0,0 +1,377 @@
+#pragma once
+
+#include <algorithm>
+#include <list>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include <boost/functional/hash.hpp>
+
+#include "queries.hpp"
+#include "util.hpp"
+
+namespace ds2i {
+
+// Queries are cached by their sorted terms: duplicates are kept, since
+// they change the scores of the ranked operators, unless the operator
+// ignores them (and_query, or_query remove them anyway).
+inline term_id_vec cache_key(term_id_vec terms, bool keep_duplicates = true) {
+    if (keep_duplicates) {
+        std::sort(terms.begin(), terms.end());
+    } else {
+        remove_duplicate_terms(terms);
+    }
+    return terms;
+}
+
+// the boolean operators remove duplicate terms themselves
+template <typename QueryOperator>
+struct ignores_duplicate_terms : std::false_type {};
+
+template <bool with_freqs>
+struct ignores_duplicate_terms<and_query<with_freqs>> : std::true_type {};
+
+template <bool with_freqs>
+struct ignores_duplicate_terms<or_query<with_freqs>> : std::true_type {};
+
+struct cached_result {
+    uint64_t results;
+    std::vector<topk_queue::entry_type> topk;
+};
+
+// A memory-bounded cache of query results, safe to share across threads.
+// Eviction policies:
+//  - lru: a single LRU list;
+//  - slru: segmented LRU, new entries go to a probationary segment and are
+//    promoted to a protected one (protected_fraction of the capacity) when
+//    hit again;
+//  - static_dynamic: a static part (static_fraction of the capacity) that
+//    keeps the results of the most frequent queries of a training log and
+//    is never evicted, plus a dynamic LRU part for the others.
+class query_cache {
+public:
+    enum class policy_type { lru, slru, static_dynamic };
+
+    static policy_type parse_policy(std::string const& name) {
+        if (name == "lru") return policy_type::lru;
+        if (name == "slru") return policy_type::slru;
+        if (name == "static_dynamic") return policy_type::static_dynamic;
+        throw std::invalid_argument("Unknown cache policy " + name);
+    }
+
+    static constexpr double protected_fraction = 0.8;
+
+    query_cache(policy_type policy, uint64_t capacity_bytes,
+                double static_fraction = 0.5)
+        : m_policy(policy)
+        , m_capacity(capacity_bytes)
+        , m_static_capacity(0)
+        , m_static_bytes(0)
+        , m_dynamic(capacity_bytes)
+        , m_probation(capacity_bytes)
+        , m_lookups(0)
+        , m_hits(0)
+        , m_evictions(0) {
+        if (policy == policy_type::slru) {
+            uint64_t protected_capacity = capacity_bytes * protected_fraction;
+            m_dynamic.set_capacity(protected_capacity);
+            m_probation.set_capacity(capacity_bytes - protected_capacity);
+        } else if (policy == policy_type::static_dynamic) {
+            m_static_capacity = capacity_bytes * static_fraction;
+            m_dynamic.set_capacity(capacity_bytes - m_static_capacity);
+        }
+    }
+
+    // Queries admitted to the static part, most frequent first, until it
+    // is full. Only used by the static_dynamic policy.
+    void set_static_queries(std::vector<term_id_vec> const& training_log,
+                            bool keep_duplicates = true) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        std::unordered_map<term_id_vec, uint64_t, key_hash> freqs;
+        for (auto const& q : training_log) {
+            freqs[cache_key(q, keep_duplicates)] += 1;
+        }
+        std::vector<std::pair<term_id_vec, uint64_t>> sorted(freqs.begin(),
+                                                             freqs.end());
+        std::sort(sorted.begin(), sorted.end(),
+                  [](auto const& lhs, auto const& rhs) {
+                      return lhs.second > rhs.second;
+                  });
+        // results are not known yet: reserve room for the keys at least
+        m_static_keys.clear();
+        uint64_t bytes = 0;
+        for (auto const& p : sorted) {
+            bytes += entry_bytes(p.first, cached_result());
+            if (bytes > m_static_capacity) break;
+            m_static_keys.insert(p.first);
+        }
+    }
+
+    bool lookup(term_id_vec const& key, cached_result& result) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        ++m_lookups;
+        auto static_it = m_static.find(key);
+        if (static_it != m_static.end()) {
+            result = static_it->second;
+            ++m_hits;
+            return true;
+        }
+
+        auto it = m_dynamic.find(key);
+        if (it != m_dynamic.end()) {
+            m_dynamic.touch(it);
+            result = it->second;
+            ++m_hits;
+            return true;
+        }
+
+        if (m_policy == policy_type::slru) {
+            auto probation_it = m_probation.find(key);
+            if (probation_it != m_probation.end()) {
+                result = probation_it->second;
+                ++m_hits;
+                // promote, demoting the LRU protected entries if needed
+                m_dynamic.push(m_probation.take(probation_it));
+                while (m_dynamic.over_capacity()) {
+                    m_probation.push(m_dynamic.pop());
+                }
+                evict(m_probation);
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void insert(term_id_vec const& key, cached_result const& result) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_static.count(key) || m_dynamic.find(key) != m_dynamic.end() ||
+            m_probation.find(key) != m_probation.end()) {
+            return;  // inserted concurrently by another thread
+        }
+
+        uint64_t bytes = entry_bytes(key, result);
+        if (m_static_keys.count(key) &&
+            m_static_bytes + bytes <= m_static_capacity) {
+            m_static.emplace(key, result);
+            m_static_bytes += bytes;
+            return;
+        }
+
+        if (m_policy == policy_type::slru) {
+            m_probation.push(std::make_pair(key, result));
+            evict(m_probation);
+        } else {
+            m_dynamic.push(std::make_pair(key, result));
+            evict(m_dynamic);
+        }
+    }
+
+    void clear() {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_static.clear();
+        m_static_bytes = 0;
+        m_dynamic.clear();
+        m_probation.clear();
+        m_lookups = m_hits = m_evictions = 0;
+    }
+
+    uint64_t lookups() const {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_lookups;
+    }
+
+    uint64_t hits() const {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_hits;
+    }
+
+    double hit_rate() const {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_lookups ? double(m_hits) / m_lookups : 0;
+    }
+
+    template <typename StatsLine>
+    StatsLine& dump(StatsLine& sl) const {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return sl("cache_policy", policy_name())(
+            "cache_capacity_bytes", m_capacity)("cache_lookups", m_lookups)(
+            "cache_hits", m_hits)(
+            "cache_hit_rate", m_lookups ? double(m_hits) / m_lookups : 0)(
+            "cache_evictions", m_evictions)(
+            "cache_entries",
+            m_static.size() + m_dynamic.size() + m_probation.size())(
+            "cache_bytes",
+            m_static_bytes + m_dynamic.bytes() + m_probation.bytes());
+    }
+
+    policy_type policy() const {
+        return m_policy;
+    }
+
+    std::string policy_name() const {
+        switch (m_policy) {
+            case policy_type::lru:
+                return "lru";
+            case policy_type::slru:
+                return "slru";
+            default:
+                return "static_dynamic";
+        }
+    }
+
+private:
+    struct key_hash {
+        size_t operator()(term_id_vec const& key) const {
+            return boost::hash_range(key.begin(), key.end());
+        }
+    };
+
+    typedef std::pair<term_id_vec, cached_result> entry_type;
+
+    static uint64_t entry_bytes(term_id_vec const& key,
+                                cached_result const& result) {
+        // rough estimate of the list node and hash table overhead
+        static const uint64_t overhead = 96;
+        return overhead + key.size() * sizeof(term_id_type) +
+               result.topk.size() * sizeof(topk_queue::entry_type);
+    }
+
+    // entries by recency of use, most recent first
+    class lru_segment {
+    public:
+        typedef std::list<entry_type>::iterator iterator;
+
+        lru_segment(uint64_t capacity)
+            : m_capacity(capacity)
+            , m_bytes(0) {}
+
+        void set_capacity(uint64_t capacity) {
+            m_capacity = capacity;
+        }
+
+        iterator find(term_id_vec const& key) {
+            auto it = m_map.find(key);
+            return it == m_map.end() ? m_list.end() : it->second;
+        }
+
+        iterator end() {
+            return m_list.end();
+        }
+
+        void touch(iterator it) {
+            m_list.splice(m_list.begin(), m_list, it);
+        }
+
+        void push(entry_type entry) {
+            m_bytes += entry_bytes(entry.first, entry.second);
+            m_list.push_front(std::move(entry));
+            m_map.emplace(m_list.front().first, m_list.begin());
+        }
+
+        entry_type take(iterator it) {
+            m_bytes -= entry_bytes(it->first, it->second);
+            m_map.erase(it->first);
+            entry_type entry = std::move(*it);
+            m_list.erase(it);
+            return entry;
+        }
+
+        entry_type pop() {
+            assert(!m_list.empty());
+            return take(std::prev(m_list.end()));
+        }
+
+        bool over_capacity() const {
+            return m_bytes > m_capacity && !m_list.empty();
+        }
+
+        size_t size() const {
+            return m_list.size();
+        }
+
+        uint64_t bytes() const {
+            return m_bytes;
+        }
+
+        void clear() {
+            m_list.clear();
+            m_map.clear();
+            m_bytes = 0;
+        }
+
+    private:
+        uint64_t m_capacity;
+        uint64_t m_bytes;
+        std::list<entry_type> m_list;
+        std::unordered_map<term_id_vec, iterator, key_hash> m_map;
+    };
+
+    void evict(lru_segment& segment) {
+        while (segment.over_capacity()) {
+            segment.pop();
+            ++m_evictions;
+        }
+    }
+
+    policy_type m_policy;
+    uint64_t m_capacity;
+    uint64_t m_static_capacity;
+    uint64_t m_static_bytes;
+    std::unordered_set<term_id_vec, key_hash> m_static_keys;
+    std::unordered_map<term_id_vec, cached_result, key_hash> m_static;
+    lru_segment m_dynamic;    // protected segment for slru
+    lru_segment m_probation;  // only used by slru
+    uint64_t m_lookups;
+    uint64_t m_hits;
+    uint64_t m_evictions;
+    mutable std::mutex m_mutex;
+};
+
+// Wraps a query operator so that its results are looked up in (and stored
+// into) a shared cache. Copies share the cache, so each thread can own one.
+template <typename QueryOperator>
+struct cached_query {
+    cached_query(QueryOperator const& query_op, query_cache& cache)
+        : m_query_op(query_op)
+        , m_cache(&cache) {}
+
+    template <typename Index>
+    uint64_t operator()(Index const& index, term_id_vec const& terms) {
+        auto key = cache_key(
+            terms, !ignores_duplicate_terms<QueryOperator>::value);
+        if (m_cache->lookup(key, m_result)) {
+            return m_result.results;
+        }
+        m_result.results = m_query_op(index, terms);
+        copy_topk(m_query_op, 0);
+        m_cache->insert(key, m_result);
+        return m_result.results;
+    }
+
+    std::vector<topk_queue::entry_type> const& topk() const {
+        return m_result.topk;
+    }
+
+private:
+    // only the ranked operators have a top-k
+    template <typename Op>
+    auto copy_topk(Op const& op, int) -> decltype(op.topk(), void()) {
+        m_result.topk = op.topk();
+    }
+
+    template <typename Op>
+    void copy_topk(Op const&, long) {
+        m_result.topk.clear();
+    }
+
+    QueryOperator m_query_op;
+    query_cache* m_cache;
+    cached_result m_result;
+};
+
+}  // namespace ds2i
@@ -0,0 +1,454 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+#include <vector>
+
+#include <roaring/roaring.h>
+
+#include <succinct/bit_vector.hpp>
+#include <succinct/mappable_vector.hpp>
+#include "succinct/util.hpp"
+#include "compact_elias_fano.hpp"
+#include "global_parameters.hpp"
+#include "util.hpp"
+
+namespace ds2i {
+
+// Index that stores the docids of each list as a roaring bitmap, in the
+// frozen format of CRoaring so that it is used in place, and the
+// frequencies in blocks of FreqsCodec. A list is laid out as
+//
+//   n | containers | bitmap bytes | first position of each container |
+//   endpoints of the frequency blocks | padding | bitmap | frequency blocks
+//
+// with the bitmap at a 32-byte boundary, as CRoaring requires; the lists
+// are padded to 32 bytes for the same reason.
+template <typename FreqsCodec>
+class roaring_freq_index {
+public:
+    static const uint64_t alignment = 32;
+    static const uint64_t header_size = 3 * sizeof(uint32_t);
+
+    roaring_freq_index()
+        : m_size(0) {}
+
+    roaring_freq_index(roaring_freq_index const&) = delete;
+    roaring_freq_index& operator=(roaring_freq_index const&) = delete;
+
+    ~roaring_freq_index() {
+        reset_bitmaps(0);
+    }
+
+    class builder {
+    public:
+        builder(uint64_t num_docs, global_parameters const& params)
+            : m_params(params) {
+            m_num_docs = num_docs;
+            m_endpoints.push_back(0);
+        }
+
+        template <typename DocsIterator, typename FreqsIterator>
+        void add_posting_list(uint64_t n, DocsIterator docs_begin,
+                              FreqsIterator freqs_begin,
+                              uint64_t /* occurrences */) {
+            if (!n) throw std::invalid_argument("List must be nonempty");
+            write(m_lists, n, docs_begin, freqs_begin);
+            m_lists.resize(aligned(m_lists.size()));
+            m_endpoints.push_back(m_lists.size());
+        }
+
+        void build_model(std::string const&) {}
+
+        void build(roaring_freq_index& sq) {
+            sq.m_params = m_params;
+            sq.m_size = m_endpoints.size() - 1;
+            sq.m_num_docs = m_num_docs;
+            sq.m_lists.steal(m_lists);
+
+            succinct::bit_vector_builder bvb;
+            compact_elias_fano::write(bvb, m_endpoints.begin(),
+                                      sq.m_lists.size(), sq.m_size,
+                                      m_params);
+            succinct::bit_vector(&bvb).swap(sq.m_endpoints);
+            sq.reset_bitmaps(sq.m_size);
+        }
+
+    private:
+        template <typename DocsIterator, typename FreqsIterator>
+        static void write(std::vector<uint8_t>& out, uint32_t n,
+                          DocsIterator docs_begin, FreqsIterator freqs_begin) {
+            static const uint64_t block_size = FreqsCodec::block_size;
+            std::vector<uint32_t> docs(n);
+            std::vector<uint32_t> container_bases;
+            DocsIterator docs_it(docs_begin);
+            for (uint32_t i = 0; i < n; ++i) {
+                docs[i] = *docs_it++;
+                if (!i || docs[i] >> 16 != docs[i - 1] >> 16) {
+                    container_bases.push_back(i);
+                }
+            }
+
+            roaring_bitmap_t* bitmap = roaring_bitmap_of_ptr(n, docs.data());
+            roaring_bitmap_run_optimize(bitmap);
+            uint32_t bitmap_bytes = roaring_bitmap_frozen_size_in_bytes(bitmap);
+            uint32_t containers = container_bases.size();
+            uint64_t blocks = succinct::util::ceil_div(n, block_size);
+
+            size_t begin = out.size();
+            size_t begin_endpoints = begin + header_size + 4 * containers;
+            size_t begin_bitmap =
+                begin + aligned(begin_endpoints + 4 * (blocks - 1) - begin);
+            size_t begin_blocks = begin_bitmap + bitmap_bytes;
+            out.resize(begin_blocks);
+            uint32_t* header = (uint32_t*)&out[begin];
+            header[0] = n;
+            header[1] = containers;
+            header[2] = bitmap_bytes;
+            std::copy(container_bases.begin(), container_bases.end(),
+                      header + 3);
+            roaring_bitmap_frozen_serialize(bitmap,
+                                            (char*)&out[begin_bitmap]);
+            roaring_bitmap_free(bitmap);
+
+            uint32_t freqs_buf[block_size];
+            FreqsIterator freqs_it(freqs_begin);
+            for (size_t b = 0; b < blocks; ++b) {
+                uint32_t cur_block_size =
+                    ((b + 1) * block_size <= n) ? block_size : (n % block_size);
+                for (size_t i = 0; i < cur_block_size; ++i) {
+                    freqs_buf[i] = *freqs_it++ - 1;
+                }
+                FreqsCodec::encode(freqs_buf, uint32_t(-1), cur_block_size,
+                                   out);
+                if (b != blocks - 1) {
+                    *((uint32_t*)&out[begin_endpoints + 4 * b]) =
+                        out.size() - begin_blocks;
+                }
+            }
+        }
+
+        global_parameters m_params;
+        size_t m_num_docs;
+        std::vector<uint64_t> m_endpoints;
+        std::vector<uint8_t> m_lists;
+    };
+
+    class document_enumerator {
+    public:
+        document_enumerator(roaring_bitmap_t const* bitmap,
+                            uint8_t const* list, uint64_t universe)
+            : m_bitmap(bitmap)
+            , m_n(((uint32_t const*)list)[0])
+            , m_container_bases(list + header_size)
+            , m_freqs_endpoints(m_container_bases +
+                                4 * ((uint32_t const*)list)[1])
+            , m_freqs_data(list +
+                           aligned(m_freqs_endpoints - list +
+                                   4 * (num_freqs_blocks() - 1)) +
+                           ((uint32_t const*)list)[2])
+            , m_universe(universe)
+            , m_cur_freqs_block(uint32_t(-1)) {
+            m_freqs_buf.resize(FreqsCodec::block_size + FreqsCodec::overflow);
+            reset();
+        }
+
+        void reset() {
+            roaring_init_iterator(m_bitmap, &m_it);
+            m_position = 0;
+            update_docid();
+        }
+
+        void DS2I_ALWAYSINLINE next() {
+            if (m_position != npos) ++m_position;
+            roaring_advance_uint32_iterator(&m_it);
+            update_docid();
+        }
+
+        // skips the containers of the bitmap with a binary search on their
+        // keys, then searches the lower bound in its container
+        void DS2I_ALWAYSINLINE next_geq(uint64_t lower_bound) {
+            if (lower_bound <= m_cur_docid) return;
+            if (lower_bound >= m_universe) {
+                move(size());
+                return;
+            }
+            roaring_move_uint32_iterator_equalorlarger(&m_it, lower_bound);
+            m_position = npos;
+            update_docid();
+        }
+
+        void move(uint64_t pos) {
+            uint32_t value;
+            if (pos >= size() or
+                !roaring_bitmap_select(m_bitmap, pos, &value)) {
+                m_it.has_value = false;
+                m_position = size();
+                update_docid();
+                return;
+            }
+            roaring_move_uint32_iterator_equalorlarger(&m_it, value);
+            m_position = pos;
+            update_docid();
+        }
+
+        uint64_t docid() const {
+            return m_cur_docid;
+        }
+
+        uint64_t DS2I_ALWAYSINLINE freq() {
+            uint64_t pos = position();
+            uint32_t block = pos / FreqsCodec::block_size;
+            if (DS2I_UNLIKELY(block != m_cur_freqs_block)) {
+                decode_freqs_block(block);
+            }
+            return m_freqs_buf[pos % FreqsCodec::block_size] + 1;
+        }
+
+        // computed lazily after next_geq, from the first position of the
+        // current container and the rank of the docid in it
+        uint64_t position() const {
+            if (m_position == npos) {
+                if (!m_it.has_value) {
+                    m_position = size();
+                } else {
+                    uint32_t container_begin = m_cur_docid & ~uint32_t(0xFFFF);
+                    m_position =
+                        ((uint32_t const*)
+                             m_container_bases)[m_it.container_index] +
+                        roaring_bitmap_range_cardinality(
+                            m_bitmap, container_begin, m_cur_docid + 1) -
+                        1;
+                }
+            }
+            return m_position;
+        }
+
+        uint64_t size() const {
+            return m_n;
+        }
+
+        roaring_bitmap_t const* bitmap() const {
+            return m_bitmap;
+        }
+
+    private:
+        static const uint64_t npos = uint64_t(-1);
+
+        uint64_t num_freqs_blocks() const {
+            return succinct::util::ceil_div(m_n, FreqsCodec::block_size);
+        }
+
+        void update_docid() {
+            m_cur_docid = m_it.has_value ? m_it.current_value : m_universe;
+        }
+
+        void DS2I_NOINLINE decode_freqs_block(uint32_t block) {
+            static const uint64_t block_size = FreqsCodec::block_size;
+            uint32_t endpoint =
+                block ? ((uint32_t const*)m_freqs_endpoints)[block - 1] : 0;
+            uint32_t cur_block_size = ((block + 1) * block_size <= size())
+                                          ? block_size
+                                          : (size() % block_size);
+            FreqsCodec::decode(m_freqs_data + endpoint, m_freqs_buf.data(),
+                               uint32_t(-1), cur_block_size);
+            m_cur_freqs_block = block;
+        }
+
+        roaring_bitmap_t const* m_bitmap;
+        uint32_t m_n;
+        uint8_t const* m_container_bases;
+        uint8_t const* m_freqs_endpoints;
+        uint8_t const* m_freqs_data;
+        uint64_t m_universe;
+
+        roaring_uint32_iterator_t m_it;
+        uint64_t m_cur_docid;
+        mutable uint64_t m_position;
+
+        uint32_t m_cur_freqs_block;
+        std::vector<uint32_t> m_freqs_buf;
+    };
+
+    size_t size() const {
+        return m_size;
+    }
+
+    uint64_t num_docs() const {
+        return m_num_docs;
+    }
+
+    document_enumerator operator[](size_t i) const {
+        assert(i < size());
+        uint8_t const* list = m_lists.data() + endpoint(i);
+        return document_enumerator(bitmap(i, list), list, num_docs());
+    }
+
+    uint32_t decode(size_t i, uint32_t* out) const {
+        assert(i < size());
+        uint8_t const* list = m_lists.data() + endpoint(i);
+        roaring_bitmap_to_uint32_array(bitmap(i, list), out);
+        return ((uint32_t const*)list)[0];
+    }
+
+    void warmup(size_t i) const {
+        assert(i < size());
+        auto begin = endpoint(i);
+        auto end = m_lists.size();
+        if (i + 1 != size()) {
+            end = endpoint(i + 1);
+        }
+
+        volatile uint32_t tmp;
+        for (size_t i = begin; i != end; ++i) {
+            tmp = m_lists[i];
+        }
+        (void)tmp;
+        bitmap(i, m_lists.data() + begin);
+    }
+
+    void swap(roaring_freq_index& other) {
+        std::swap(m_params, other.m_params);
+        std::swap(m_size, other.m_size);
+        std::swap(m_num_docs, other.m_num_docs);
+        m_endpoints.swap(other.m_endpoints);
+        m_lists.swap(other.m_lists);
+        m_bitmaps.swap(other.m_bitmaps);
+    }
+
+    template <typename Visitor>
+    void map(Visitor& visit) {
+        visit(m_params, "m_params")(m_size, "m_size")(m_num_docs, "m_num_docs")(
+            m_endpoints, "m_endpoints")(m_lists, "m_lists");
+        if (m_bitmaps.size() != m_size) {  // the index has just been mapped
+            reset_bitmaps(m_size);
+        }
+    }
+
+private:
+    static uint64_t aligned(uint64_t offset) {
+        return succinct::util::ceil_div(offset, alignment) * alignment;
+    }
+
+    // The bitmap of a list, opened as a frozen view the first time it is
+    // needed; the list is copied to aligned memory if the lists are not
+    // 32-byte aligned, as when they are mapped from a file.
+    class frozen_bitmap {
+    public:
+        explicit frozen_bitmap(uint8_t const* list)
+            : m_copy(nullptr) {
+            uint32_t const* header = (uint32_t const*)list;
+            uint32_t n = header[0];
+            uint32_t containers = header[1];
+            uint32_t bytes = header[2];
+            uint64_t blocks =
+                succinct::util::ceil_div(n, FreqsCodec::block_size);
+            char const* data =
+                (char const*)list +
+                aligned(header_size + 4 * containers + 4 * (blocks - 1));
+            if (uintptr_t(data) % alignment) {
+                m_copy = (char*)aligned_alloc(alignment, aligned(bytes));
+                std::memcpy(m_copy, data, bytes);
+                data = m_copy;
+            }
+            m_bitmap = roaring_bitmap_frozen_view(data, bytes);
+            if (!m_bitmap) {
+                std::free(m_copy);
+                throw std::runtime_error("Invalid roaring bitmap");
+            }
+        }
+
+        frozen_bitmap(frozen_bitmap const&) = delete;
+        frozen_bitmap& operator=(frozen_bitmap const&) = delete;
+
+        ~frozen_bitmap() {
+            roaring_bitmap_free(m_bitmap);
+            std::free(m_copy);
+        }
+
+        roaring_bitmap_t const* get() const {
+            return m_bitmap;
+        }
+
+    private:
+        roaring_bitmap_t const* m_bitmap;
+        char* m_copy;
+    };
+
+    uint64_t endpoint(size_t i) const {
+        compact_elias_fano::enumerator endpoints(m_endpoints, 0, m_lists.size(),
+                                                 m_size, m_params);
+        return endpoints.move(i).second;
+    }
+
+    roaring_bitmap_t const* bitmap(size_t i, uint8_t const* list) const {
+        frozen_bitmap* view = m_bitmaps[i].load(std::memory_order_acquire);
+        if (DS2I_UNLIKELY(!view)) {
+            std::unique_ptr<frozen_bitmap> opened(new frozen_bitmap(list));
+            // another thread may have opened it meanwhile
+            if (m_bitmaps[i].compare_exchange_strong(view, opened.get())) {
+                view = opened.release();
+            }
+        }
+        return view->get();
+    }
+
+    void reset_bitmaps(size_t size) {
+        for (auto& view : m_bitmaps) {
+            delete view.load();
+        }
+        std::vector<std::atomic<frozen_bitmap*>>(size).swap(m_bitmaps);
+    }
+
+    global_parameters m_params;
+    size_t m_size;
+    size_t m_num_docs;
+    succinct::bit_vector m_endpoints;
+    succinct::mapper::mappable_vector<uint8_t> m_lists;
+    mutable std::vector<std::atomic<frozen_bitmap*>> m_bitmaps;
+};
+
+// Docids in all the lists of enums, intersected container by container by
+// CRoaring, starting from the shortest lists; returns their number.
+template <typename Enumerator>
+uint64_t roaring_intersection(std::vector<Enumerator>& enums, uint32_t* out) {
+    std::sort(enums.begin(), enums.end(),
+              [](auto const& l, auto const& r) { return l.size() < r.size(); });
+    if (enums.size() == 1) {
+        roaring_bitmap_to_uint32_array(enums[0].bitmap(), out);
+        return enums[0].size();
+    }
+    roaring_bitmap_t* result =
+        roaring_bitmap_and(enums[0].bitmap(), enums[1].bitmap());
+    for (size_t i = 2; i < enums.size() and !roaring_bitmap_is_empty(result);
+         ++i) {
+        roaring_bitmap_and_inplace(result, enums[i].bitmap());
+    }
+    uint64_t size = roaring_bitmap_get_cardinality(result);
+    roaring_bitmap_to_uint32_array(result, out);
+    roaring_bitmap_free(result);
+    return size;
+}
+
+// Docids in any of the lists of enums, merged container by container by
+// CRoaring; returns their number.
+template <typename Enumerator>
+uint64_t roaring_union(std::vector<Enumerator> const& enums, uint32_t* out) {
+    std::vector<roaring_bitmap_t const*> bitmaps;
+    bitmaps.reserve(enums.size());
+    for (auto const& e : enums) {
+        bitmaps.push_back(e.bitmap());
+    }
+    roaring_bitmap_t* result =
+        roaring_bitmap_or_many(bitmaps.size(), bitmaps.data());
+    uint64_t size = roaring_bitmap_get_cardinality(result);
+    roaring_bitmap_to_uint32_array(result, out);
+    roaring_bitmap_free(result);
+    return size;
+}
+
+}  // namespace ds2i
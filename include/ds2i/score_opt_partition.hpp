@@ -0,0 +1,136 @@
+#pragma once
+
+#include <vector>
+#include <deque>
+#include <algorithm>
+#include <stdexcept>
+#include "util.hpp"
+
+namespace ds2i {
+
+// Variable-sized block-max partition of a list of scores. The cost of a
+// block is a fixed cost, accounting for the space of its entry in the
+// block-max directory, plus the sum of the differences between the block
+// max and the scores it covers, i.e., how loose its upper bound is.
+// As in optimal_partition, the shortest path is approximated by using
+// only windows whose costs grow as powers of (1 + eps2).
+struct score_opt_partition {
+    std::vector<uint32_t> partition;  // end positions of the blocks
+    double cost_opt = 0;
+
+    struct score_window {
+        // a window represents the cost of the interval [start, end)
+
+        std::vector<float> const* scores;
+        uint32_t start = 0;
+        uint32_t end = 0;  // end-th position is not in the current window
+        double sum = 0;
+        // positions of the window in order of decreasing score
+        std::deque<uint32_t> max_queue;
+
+        double cost_upper_bound;  // the maximum cost for this window
+
+        score_window(std::vector<float> const& scores, double cost_upper_bound)
+            : scores(&scores)
+            , cost_upper_bound(cost_upper_bound) {}
+
+        uint64_t size() const {
+            return end - start;
+        }
+
+        float max() const {
+            assert(!max_queue.empty());
+            return (*scores)[max_queue.front()];
+        }
+
+        double cost(double fixed_cost) const {
+            return fixed_cost + size() * double(max()) - sum;
+        }
+
+        void advance_start() {
+            sum -= (*scores)[start];
+            if (max_queue.front() == start) {
+                max_queue.pop_front();
+            }
+            ++start;
+        }
+
+        void advance_end() {
+            float score = (*scores)[end];
+            sum += score;
+            while (!max_queue.empty() && (*scores)[max_queue.back()] <= score) {
+                max_queue.pop_back();
+            }
+            max_queue.push_back(end);
+            ++end;
+        }
+    };
+
+    score_opt_partition() {}
+
+    score_opt_partition(std::vector<float> const& scores, double fixed_cost,
+                        double eps1, double eps2) {
+        if (fixed_cost <= 0) {
+            throw std::invalid_argument("Block fixed cost must be positive");
+        }
+
+        uint32_t size = scores.size();
+        assert(size > 0);
+        float max_score = *std::max_element(scores.begin(), scores.end());
+        double scores_sum = 0;
+        for (auto s : scores) scores_sum += s;
+        double single_block_cost =
+            fixed_cost + size * double(max_score) - scores_sum;
+        std::vector<double> min_cost(size + 1, single_block_cost);
+        min_cost[0] = 0;
+
+        // create the required window: one for each power of (1 + eps2)
+        std::vector<score_window> windows;
+        double cost_lb = fixed_cost;  // minimum cost
+        double cost_bound = cost_lb;
+        while (eps1 == 0 || cost_bound < cost_lb / eps1) {
+            windows.emplace_back(scores, cost_bound);
+            if (cost_bound >= single_block_cost)
+                break;
+            cost_bound = cost_bound * (1 + eps2);
+        }
+
+        std::vector<uint32_t> path(size + 1, 0);
+        for (uint32_t i = 0; i < size; i++) {
+            size_t last_end = i + 1;
+            for (auto& window : windows) {
+                assert(window.start == i);
+                while (window.end < last_end) {
+                    window.advance_end();
+                }
+
+                double window_cost;
+                while (true) {
+                    window_cost = window.cost(fixed_cost);
+                    if (min_cost[i] + window_cost < min_cost[window.end]) {
+                        min_cost[window.end] = min_cost[i] + window_cost;
+                        path[window.end] = i;
+                    }
+                    last_end = window.end;
+                    if (window.end == size)
+                        break;
+                    if (window_cost >= window.cost_upper_bound)
+                        break;
+                    window.advance_end();
+                }
+
+                window.advance_start();
+            }
+        }
+
+        uint32_t curr_pos = size;
+        while (curr_pos != 0) {
+            partition.push_back(curr_pos);
+            curr_pos = path[curr_pos];
+        }
+        std::reverse(partition.begin(), partition.end());
+        cost_opt = min_cost[size];
+    }
+};
+
+}  // namespace ds2i
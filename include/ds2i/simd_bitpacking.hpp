@@ -0,0 +1,283 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <cstdint>
+#include <cstring>
+#include <utility>
+
+#include "prefix_sum.hpp"
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE4_1__)
+#include <smmintrin.h>
+#endif
+
+namespace ds2i {
+
+// Vertical bit packing of blocks of 128 integers (SIMD-BP128 layout): the
+// integers are spread over 4 lanes of 32-bit words, integer i going to lane
+// i % 4, so that a 128-bit word holds the next integer of 4 consecutive
+// ones. A block packed with b bits per integer takes exactly 16 * b bytes.
+//
+// Unpacking uses AVX2 when available, decoding the integers i and i + 64
+// of a block with a single 256-bit shift, and SSE4 otherwise; the choice
+// is made at compile time and all kernels read the same layout, which is
+// also the one written by the (scalar) packer.
+//
+// unpack_prefix_sum() fuses unpacking with prefix_sum_d1(): with SSE4 the
+// lanes hold 4 consecutive integers, so each vector is summed in registers
+// right after being unpacked, before being stored.
+struct simd_bitpacking {
+    static const uint32_t block_size = 128;
+    static const uint32_t lanes = 4;
+    static const uint32_t lane_size = block_size / lanes;
+
+    static uint32_t packed_words(uint32_t b) {
+        return lanes * b;
+    }
+
+    static void pack(uint32_t const* in, uint32_t b, uint32_t* out) {
+        assert(b <= 32);
+        std::fill(out, out + packed_words(b), 0);
+        if (b == 0) return;
+        uint32_t mask = b == 32 ? uint32_t(-1) : (uint32_t(1) << b) - 1;
+        for (uint32_t p = 0; p < lane_size; ++p) {
+            uint32_t bit = p * b;
+            uint32_t word = bit / 32;
+            uint32_t shift = bit % 32;
+            for (uint32_t j = 0; j < lanes; ++j) {
+                uint32_t v = in[lanes * p + j] & mask;
+                out[lanes * word + j] |= v << shift;
+                if (shift + b > 32) {
+                    out[lanes * (word + 1) + j] |= v >> (32 - shift);
+                }
+            }
+        }
+    }
+
+    static void unpack(uint32_t const* in, uint32_t b, uint32_t* out) {
+        assert(b <= 32);
+        unpackers()[b](in, out);
+    }
+
+    // unpack() followed by prefix_sum_d1(out, block_size, base)
+    static void unpack_prefix_sum(uint32_t const* in, uint32_t b, uint32_t* out,
+                                  uint32_t base) {
+        assert(b <= 32);
+#if defined(__SSE4_1__)
+        prefix_sum_unpackers()[b](in, out, base);
+#else
+        unpack(in, b, out);
+        prefix_sum_d1(out, block_size, base);
+#endif
+    }
+
+private:
+    typedef void (*unpacker)(uint32_t const*, uint32_t*);
+
+    template <uint32_t... B>
+    static std::array<unpacker, sizeof...(B)> make_unpackers(
+        std::integer_sequence<uint32_t, B...>) {
+        return {{&unpack_block<B>...}};
+    }
+
+    static std::array<unpacker, 33> const& unpackers() {
+        static const std::array<unpacker, 33> table =
+            make_unpackers(std::make_integer_sequence<uint32_t, 33>());
+        return table;
+    }
+
+    template <uint32_t b>
+    static void unpack_block(uint32_t const* in, uint32_t* out) {
+        unpack_lanes<b>(in, out,
+                        std::make_integer_sequence<uint32_t, unpack_steps>());
+    }
+
+    // position in the lane of the P-th integer of each lane
+    template <uint32_t b, uint32_t P>
+    struct position {
+        static const uint32_t word = (P * b) / 32;
+        static const uint32_t shift = (P * b) % 32;
+        static const bool spans = shift + b > 32;
+    };
+
+#if defined(__SSE4_1__)
+    typedef void (*prefix_sum_unpacker)(uint32_t const*, uint32_t*, uint32_t);
+
+    template <uint32_t... B>
+    static std::array<prefix_sum_unpacker, sizeof...(B)>
+    make_prefix_sum_unpackers(std::integer_sequence<uint32_t, B...>) {
+        return {{&unpack_prefix_sum_block<B>...}};
+    }
+
+    static std::array<prefix_sum_unpacker, 33> const& prefix_sum_unpackers() {
+        static const std::array<prefix_sum_unpacker, 33> table =
+            make_prefix_sum_unpackers(
+                std::make_integer_sequence<uint32_t, 33>());
+        return table;
+    }
+
+    // the P-th integer of each lane, not masked
+    template <uint32_t b, uint32_t P>
+    static __m128i lane_values(__m128i const* pin) {
+        typedef position<b, P> pos;
+        __m128i v = _mm_srli_epi32(_mm_loadu_si128(pin + pos::word),
+                                   int(pos::shift));
+        if (pos::spans) {
+            v = _mm_or_si128(
+                v, _mm_slli_epi32(_mm_loadu_si128(pin + pos::word + 1),
+                                  int(32 - pos::shift)));
+        }
+        return v;
+    }
+
+    template <uint32_t b>
+    static void unpack_prefix_sum_block(uint32_t const* in, uint32_t* out,
+                                        uint32_t base) {
+        unpack_prefix_sum_lanes<b>(
+            in, out, base, std::make_integer_sequence<uint32_t, lane_size>());
+    }
+
+    template <uint32_t b, uint32_t... P>
+    static void unpack_prefix_sum_lanes(uint32_t const* in, uint32_t* out,
+                                        uint32_t base,
+                                        std::integer_sequence<uint32_t, P...>) {
+        if (b == 0 || b == 32) {
+            unpack_trivial<b>(in, out);
+            prefix_sum_d1(out, block_size, base);
+            return;
+        }
+        __m128i const* pin = reinterpret_cast<__m128i const*>(in);
+        __m128i* pout = reinterpret_cast<__m128i*>(out);
+        __m128i mask = _mm_set1_epi32(int((uint64_t(1) << b) - 1));
+        __m128i carry = _mm_set1_epi32(int(base - 1));
+        // braced initializers are evaluated in order
+        int unused[] = {unpack_prefix_sum_one<b, P>(pin, pout, mask, carry)...};
+        (void)unused;
+    }
+
+    template <uint32_t b, uint32_t P>
+    static int unpack_prefix_sum_one(__m128i const* pin, __m128i* pout,
+                                     __m128i mask, __m128i& carry) {
+        __m128i v = _mm_and_si128(lane_values<b, P>(pin), mask);
+        v = _mm_add_epi32(v, _mm_set1_epi32(1));
+        v = _mm_add_epi32(prefix_sum_detail::scan4(v), carry);
+        _mm_storeu_si128(pout + P, v);
+        carry = _mm_shuffle_epi32(v, 0xFF);
+        return 0;
+    }
+#endif
+
+#if defined(__AVX2__)
+    // the first half of the positions, each paired with one of the second
+    static const uint32_t unpack_steps = lane_size / 2;
+
+    template <uint32_t b, uint32_t... P>
+    static void unpack_lanes(uint32_t const* in, uint32_t* out,
+                             std::integer_sequence<uint32_t, P...>) {
+        if (b == 0 || b == 32) {
+            unpack_trivial<b>(in, out);
+            return;
+        }
+        __m128i const* pin = reinterpret_cast<__m128i const*>(in);
+        __m128i* pout = reinterpret_cast<__m128i*>(out);
+        __m256i mask = _mm256_set1_epi32(int((uint64_t(1) << b) - 1));
+        int unused[] = {unpack_pair<b, P>(pin, pout, mask)...};
+        (void)unused;
+    }
+
+    template <uint32_t b, uint32_t P>
+    static int unpack_pair(__m128i const* pin, __m128i* pout, __m256i mask) {
+        typedef position<b, P> lo;
+        typedef position<b, P + lane_size / 2> hi;
+        __m256i words = _mm256_inserti128_si256(
+            _mm256_castsi128_si256(_mm_loadu_si128(pin + lo::word)),
+            _mm_loadu_si128(pin + hi::word), 1);
+        __m256i v = _mm256_srlv_epi32(
+            words, _mm256_setr_epi32(lo::shift, lo::shift, lo::shift,
+                                     lo::shift, hi::shift, hi::shift,
+                                     hi::shift, hi::shift));
+        if (lo::spans || hi::spans) {
+            // a shift by 32 clears the half that does not span two words
+            const uint32_t lo_word = lo::spans ? lo::word + 1 : lo::word;
+            const uint32_t hi_word = hi::spans ? hi::word + 1 : hi::word;
+            const int lo_shift = lo::spans ? 32 - lo::shift : 32;
+            const int hi_shift = hi::spans ? 32 - hi::shift : 32;
+            __m256i next = _mm256_inserti128_si256(
+                _mm256_castsi128_si256(_mm_loadu_si128(pin + lo_word)),
+                _mm_loadu_si128(pin + hi_word), 1);
+            v = _mm256_or_si256(
+                v, _mm256_sllv_epi32(
+                       next, _mm256_setr_epi32(lo_shift, lo_shift, lo_shift,
+                                               lo_shift, hi_shift, hi_shift,
+                                               hi_shift, hi_shift)));
+        }
+        v = _mm256_and_si256(v, mask);
+        _mm_storeu_si128(pout + P, _mm256_castsi256_si128(v));
+        _mm_storeu_si128(pout + P + lane_size / 2,
+                         _mm256_extracti128_si256(v, 1));
+        return 0;
+    }
+#elif defined(__SSE4_1__)
+    static const uint32_t unpack_steps = lane_size;
+
+    template <uint32_t b, uint32_t... P>
+    static void unpack_lanes(uint32_t const* in, uint32_t* out,
+                             std::integer_sequence<uint32_t, P...>) {
+        if (b == 0 || b == 32) {
+            unpack_trivial<b>(in, out);
+            return;
+        }
+        __m128i const* pin = reinterpret_cast<__m128i const*>(in);
+        __m128i* pout = reinterpret_cast<__m128i*>(out);
+        __m128i mask = _mm_set1_epi32(int((uint64_t(1) << b) - 1));
+        int unused[] = {unpack_one<b, P>(pin, pout, mask)...};
+        (void)unused;
+    }
+
+    template <uint32_t b, uint32_t P>
+    static int unpack_one(__m128i const* pin, __m128i* pout, __m128i mask) {
+        _mm_storeu_si128(pout + P,
+                         _mm_and_si128(lane_values<b, P>(pin), mask));
+        return 0;
+    }
+#else
+    static const uint32_t unpack_steps = 1;
+
+    template <uint32_t b, uint32_t... P>
+    static void unpack_lanes(uint32_t const* in, uint32_t* out,
+                             std::integer_sequence<uint32_t, P...>) {
+        if (b == 0 || b == 32) {
+            unpack_trivial<b>(in, out);
+            return;
+        }
+        uint32_t mask = uint32_t((uint64_t(1) << b) - 1);
+        for (uint32_t p = 0; p < lane_size; ++p) {
+            uint32_t bit = p * b;
+            uint32_t word = bit / 32;
+            uint32_t shift = bit % 32;
+            for (uint32_t j = 0; j < lanes; ++j) {
+                uint64_t v = in[lanes * word + j] >> shift;
+                if (shift + b > 32) {
+                    v |= uint64_t(in[lanes * (word + 1) + j]) << (32 - shift);
+                }
+                out[lanes * p + j] = uint32_t(v) & mask;
+            }
+        }
+    }
+#endif
+
+    template <uint32_t b>
+    static void unpack_trivial(uint32_t const* in, uint32_t* out) {
+        if (b == 0) {
+            std::fill(out, out + block_size, 0);
+        } else {
+            std::memcpy(out, in, block_size * sizeof(uint32_t));
+        }
+    }
+};
+
+}  // namespace ds2i
@@ -0,0 +1,192 @@
+#pragma once
+
+#include <cassert>
+#include <cstdint>
+#include <cstring>
+
+#include "succinct/broadword.hpp"
+#include "bits_enumerator.hpp"
+#include "util.hpp"
+
+namespace ds2i {
+
+// Reader of the bit streams written by succinct::bit_vector_builder (least
+// significant bit first). The bits are kept in a 64-bit buffer that is
+// refilled without branches by an unaligned load at the first byte not
+// yet buffered, so that after refill() at least 56 bits are available.
+// Like bits_enumerator, it reads past the end of the stream (here up to
+// 15 bytes).
+class buffered_bit_reader {
+public:
+    buffered_bit_reader(uint8_t const* data)
+        : m_begin(data)
+        , m_ptr(data)
+        , m_buf(0)
+        , m_avail(0) {}
+
+    void DS2I_ALWAYSINLINE refill() {
+        uint64_t word;
+        std::memcpy(&word, m_ptr, sizeof(word));
+        m_buf |= word << m_avail;
+        m_ptr += (63 - m_avail) >> 3;
+        m_avail |= 56;
+    }
+
+    // the next l < 64 bits, which must be available
+    uint64_t DS2I_ALWAYSINLINE peek(uint64_t l) const {
+        return m_buf & ((uint64_t(1) << l) - 1);
+    }
+
+    void DS2I_ALWAYSINLINE consume(uint64_t l) {
+        assert(l <= m_avail);
+        m_buf >>= l;
+        m_avail -= l;
+    }
+
+    uint64_t DS2I_ALWAYSINLINE take(uint64_t l) {
+        uint64_t val = peek(l);
+        consume(l);
+        return val;
+    }
+
+    // unary code, which must be among the available bits
+    uint64_t DS2I_ALWAYSINLINE unary() {
+        assert(m_buf);
+        uint64_t zeros = succinct::broadword::lsb(m_buf);
+        consume(zeros + 1);
+        return zeros;
+    }
+
+    uint64_t available() const {
+        return m_avail;
+    }
+
+    uint64_t position() const {
+        return 8 * uint64_t(m_ptr - m_begin) - m_avail;
+    }
+
+private:
+    uint8_t const* m_begin;
+    uint8_t const* m_ptr;
+    uint64_t m_buf;
+    uint64_t m_avail;
+};
+
+// Decoders of single integers of at most 32 bits, in the format of
+// integer_codes.hpp. No code part is longer than 33 bits, so the buffer is
+// refilled before a part only when less than that is left.
+inline uint64_t read_gamma(buffered_bit_reader& r) {
+    r.refill();
+    uint64_t l = r.unary();
+    if (DS2I_UNLIKELY(r.available() < l)) r.refill();
+    return (r.take(l) | (uint64_t(1) << l)) - 1;
+}
+
+inline uint64_t read_rice(buffered_bit_reader& r, const uint64_t k) {
+    uint64_t q = read_gamma(r);
+    if (DS2I_UNLIKELY(r.available() < k)) r.refill();
+    return r.take(k) + (q << k);
+}
+
+inline uint64_t reverse_bits(uint64_t x, uint64_t len) {
+    if (!len) return 0;
+    x = ((x >> 1) & 0x5555555555555555ULL) | ((x & 0x5555555555555555ULL) << 1);
+    x = ((x >> 2) & 0x3333333333333333ULL) | ((x & 0x3333333333333333ULL) << 2);
+    x = ((x >> 4) & 0x0F0F0F0F0F0F0F0FULL) | ((x & 0x0F0F0F0F0F0F0F0FULL) << 4);
+    return __builtin_bswap64(x) >> (64 - len);
+}
+
+inline uint64_t read_zeta(buffered_bit_reader& r, const uint64_t k) {
+    r.refill();
+    uint64_t h = r.unary();
+    uint64_t left = uint64_t(1) << (h * k);
+    uint64_t len = h * k + k - 1;
+    if (DS2I_UNLIKELY(r.available() < len + 1)) r.refill();
+    uint64_t shrunk = reverse_bits(r.take(len), len);
+    if (shrunk < left) {
+        return shrunk + left - 1;
+    }
+    return (shrunk << 1) + r.take(1) - 1;
+}
+
+// Lookup table that decodes, from the next lookup_bits bits of a stream,
+// all the codes that end within them (up to max_symbols), so that runs of
+// small integers are decoded several at a time. The entries are built by
+// decoding every bit pattern with the reference decoder; codes longer
+// than lookup_bits bits leave the entry empty.
+struct multi_symbol_table {
+    static const uint64_t lookup_bits = 11;
+    static const uint64_t max_symbols = 6;
+
+    struct entry {
+        uint8_t count;
+        uint8_t bits;
+        uint8_t values[max_symbols];
+    };
+
+    // read(bits_enumerator&) decodes one integer
+    template <typename Read>
+    multi_symbol_table(Read read) {
+        for (uint64_t pattern = 0; pattern != table_size; ++pattern) {
+            // pad with ones, so that unary codes past the pattern end
+            uint64_t words[2] = {pattern | (uint64_t(-1) << lookup_bits),
+                                 uint64_t(-1)};
+            bits_enumerator it(words);
+            entry& e = m_entries[pattern];
+            e.count = 0;
+            e.bits = 0;
+            while (e.count != max_symbols) {
+                uint64_t value = read(it);
+                if (it.position() > lookup_bits || value > 255) break;
+                e.values[e.count++] = uint8_t(value);
+                e.bits = uint8_t(it.position());
+            }
+            for (uint64_t i = e.count; i != max_symbols; ++i) {
+                e.values[i] = 0;
+            }
+        }
+    }
+
+    entry const& operator[](uint64_t pattern) const {
+        return m_entries[pattern];
+    }
+
+private:
+    static const uint64_t table_size = uint64_t(1) << lookup_bits;
+    entry m_entries[table_size];
+};
+
+// Decodes n integers through the table, falling back to
+// read(buffered_bit_reader&) for the codes that do not fit it and for the
+// last few integers. After a miss the next max_symbols integers are all
+// read one at a time, since long codes come in runs and alternating
+// between the two paths costs more in mispredicted branches than the
+// table saves.
+template <typename Read>
+inline void decode_multi_symbol(buffered_bit_reader& r,
+                                multi_symbol_table const& table,
+                                uint32_t* out, size_t n, Read read) {
+    static const uint64_t max_symbols = multi_symbol_table::max_symbols;
+    size_t i = 0;
+    while (i + max_symbols <= n) {
+        r.refill();
+        auto const& e = table[r.peek(multi_symbol_table::lookup_bits)];
+        if (DS2I_LIKELY(e.count)) {
+            // the values past count are overwritten by the next ones
+            for (uint64_t j = 0; j != max_symbols; ++j) {
+                out[i + j] = e.values[j];
+            }
+            i += e.count;
+            r.consume(e.bits);
+        } else {
+            for (uint64_t j = 0; j != max_symbols; ++j) {
+                out[i++] = uint32_t(read(r));
+            }
+        }
+    }
+    for (; i != n; ++i) {
+        out[i] = uint32_t(read(r));
+    }
+}
+
+}  // namespace ds2i
@@ -0,0 +1,199 @@
+#pragma once
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+#include "succinct/broadword.hpp"
+
+namespace ds2i {
+
+// Alphabet of the integers coded with tANS: the values below literals are
+// symbols of their own, the larger ones are grouped by bit length (symbol
+// 11 + l for l bits) and followed by the l - 1 bits below the leading one.
+struct tans_alphabet {
+    static const uint64_t literals = 16;
+    static const uint64_t size = 44;
+
+    static uint64_t symbol(uint32_t value) {
+        if (value < literals) return value;
+        return succinct::broadword::msb(value) + 12;
+    }
+
+    static uint32_t base(uint64_t symbol) {
+        return symbol < literals ? uint32_t(symbol)
+                                 : uint32_t(1) << (symbol - 12);
+    }
+
+    static uint64_t extra_bits(uint64_t symbol) {
+        return symbol < literals ? 0 : symbol - 12;
+    }
+};
+
+// Table-based asymmetric numeral system for a distribution over
+// tans_alphabet, given as frequencies that sum to the number of states.
+// The symbols are spread over the states as in FSE; decoding the symbol of
+// a state reads the bits that bring the next state back in [0, states),
+// while the encoder, which goes backwards, writes them.
+class tans_model {
+public:
+    static const uint64_t log_states = 10;
+    static const uint64_t states = uint64_t(1) << log_states;
+
+    struct decoder_entry {
+        uint32_t base;       // tans_alphabet::base() of the symbol
+        uint16_t next;       // the next state, before adding the bits read
+        uint8_t bits;        // number of bits read for the next state
+        uint8_t extra_bits;  // tans_alphabet::extra_bits() of the symbol
+    };
+
+    tans_model(uint16_t const* frequencies)
+        : m_decoder(states)
+        , m_encoder(states) {
+        uint64_t cumulative = 0;
+        for (uint64_t s = 0; s != tans_alphabet::size; ++s) {
+            assert(frequencies[s] > 0);
+            m_frequencies[s] = frequencies[s];
+            m_cumulative[s] = uint16_t(cumulative);
+            m_cost[s] = float(log_states - std::log2(double(frequencies[s])));
+            cumulative += frequencies[s];
+        }
+        assert(cumulative == states);
+
+        std::vector<uint8_t> symbols(states);
+        uint64_t step = (states >> 1) + (states >> 3) + 3;
+        uint64_t pos = 0;
+        for (uint64_t s = 0; s != tans_alphabet::size; ++s) {
+            for (uint64_t i = 0; i != m_frequencies[s]; ++i) {
+                symbols[pos] = uint8_t(s);
+                pos = (pos + step) & (states - 1);
+            }
+        }
+        assert(pos == 0);
+
+        uint64_t next[tans_alphabet::size];
+        std::copy(m_frequencies, m_frequencies + tans_alphabet::size, next);
+        for (uint64_t state = 0; state != states; ++state) {
+            uint64_t s = symbols[state];
+            uint64_t x = next[s]++;
+            uint64_t bits = log_states - succinct::broadword::msb(x);
+            decoder_entry& e = m_decoder[state];
+            e.base = tans_alphabet::base(s);
+            e.next = uint16_t((x << bits) - states);
+            e.bits = uint8_t(bits);
+            e.extra_bits = uint8_t(tans_alphabet::extra_bits(s));
+            m_encoder[m_cumulative[s] + x - m_frequencies[s]] =
+                uint16_t(state);
+        }
+    }
+
+    decoder_entry const& operator[](uint64_t state) const {
+        return m_decoder[state];
+    }
+
+    // Encodes symbol s from state: the low bits of state must be written
+    // before the new state is returned
+    uint64_t encode(uint64_t state, uint64_t s, uint64_t& bits) const {
+        uint64_t f = m_frequencies[s];
+        uint64_t x = states + state;
+        bits = log_states - succinct::broadword::msb(f);
+        if ((x >> bits) < f) --bits;
+        return m_encoder[m_cumulative[s] + (x >> bits) - f];
+    }
+
+    // A state that decodes to s, to start encoding from the last symbol
+    // of a stream, whose next state is not read
+    uint64_t initial_state(uint64_t s) const {
+        return m_encoder[m_cumulative[s]];
+    }
+
+    // approximate number of bits taken by s, extra bits excluded
+    float cost(uint64_t s) const {
+        return m_cost[s];
+    }
+
+private:
+    std::vector<decoder_entry> m_decoder;
+    std::vector<uint16_t> m_encoder;
+    uint16_t m_frequencies[tans_alphabet::size];
+    uint16_t m_cumulative[tans_alphabet::size];
+    float m_cost[tans_alphabet::size];
+};
+
+// The models shared by all the blocks of tans_block. They are fixed, so
+// that the encoded blocks do not depend on the collection: the values are
+// shifted right so that what is left matches one of the shapes, which are
+// geometric distributions with means from 1/16 to 2.83 (mostly docid
+// gaps) and zeta distributions with exponents from 1.3 to 4 (mostly
+// frequencies), quantized giving each symbol a frequency of at least 1.
+struct tans_shapes {
+    static const uint64_t count = 16;
+
+    static tans_model const& get(uint64_t shape) {
+        assert(shape < count);
+        static const std::vector<tans_model> models = build();
+        return models[shape];
+    }
+
+private:
+    static std::vector<tans_model> build() {
+        static const uint16_t frequencies[count][tans_alphabet::size] = {
+            {925, 55, 3, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+             1,   1,  1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+             1,   1,  1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1},
+            {871, 101, 11, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+             1,   1,   1,  1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+             1,   1,   1,  1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1},
+            {780, 164, 33, 7, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+             1,   1,   1,  1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+             1,   1,   1,  1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1},
+            {721, 197, 51, 13, 3, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+             1,   1,   1,  1,  1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+             1,   1,   1,  1,  1, 1, 1, 1, 1, 1, 1, 1, 1, 1},
+            {646, 228, 76, 25, 8, 3, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+             1,   1,   1,  1,  1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+             1,   1,   1,  1,  1, 1, 1, 1, 1, 1, 1, 1, 1, 1},
+            {568, 248, 102, 42, 17, 7, 3, 1, 1, 1, 1, 1, 1, 1, 1,
+             1,   1,   1,   1,  1,  1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+             1,   1,   1,   1,  1,  1, 1, 1, 1, 1, 1, 1, 1, 1},
+            {479, 256, 128, 64, 32, 16, 8, 4, 2, 1, 1, 1, 1, 1, 1,
+             1,   1,   1,   1,  1,  1,  1, 1, 1, 1, 1, 1, 1, 1, 1,
+             1,   1,   1,   1,  1,  1,  1, 1, 1, 1, 1, 1, 1, 1},
+            {395, 249, 145, 85, 50, 29, 17, 10, 6, 3, 2, 1, 1, 1, 1,
+             1,   1,   1,   1,  1,  1,  1,  1,  1, 1, 1, 1, 1, 1, 1,
+             1,   1,   1,   1,  1,  1,  1,  1,  1, 1, 1, 1, 1, 1},
+            {313, 228, 152, 101, 67, 45, 30, 20, 13, 9, 6, 4, 3, 2, 1,
+             1,   2,   1,   1,   1,  1,  1,  1,  1,  1, 1, 1, 1, 1, 1,
+             1,   1,   1,   1,   1,  1,  1,  1,  1,  1, 1, 1, 1, 1},
+            {238, 198, 146, 108, 80, 59, 44, 32, 24, 18, 13, 10, 7, 5, 4,
+             3,   8,   1,   1,   1,  1,  1,  1,  1,  1,  1,  1,  1, 1, 1,
+             1,   1,   1,   1,   1,  1,  1,  1,  1,  1,  1,  1,  1, 1},
+            {257, 106, 63, 43, 32, 25, 21, 17, 15, 13, 12, 10, 9, 8, 8,
+             7,   69,  57, 47, 38, 31, 25, 20, 17, 13, 11, 9,  7, 6, 5,
+             4,   3,   3,  2,  2,  1,  1,  1,  1,  1,  1,  1,  1, 1},
+            {433, 148, 77, 49, 34, 25, 20, 16, 13, 11, 10, 8, 7, 7, 6,
+             5,   46,  31, 21, 14, 9,  6,  4,  3,  2,  1,  1, 1, 1, 1,
+             1,   1,   1,  1,  1,  1,  1,  1,  1,  1,  1,  1, 1, 1},
+            {600, 156, 69, 39, 25, 17, 13, 10, 8, 6, 5, 4, 4, 3, 3,
+             2,   19,  10, 5,  2,  1,  1,  1,  1, 1, 1, 1, 1, 1, 1,
+             1,   1,   1,  1,  1,  1,  1,  1,  1, 1, 1, 1, 1, 1},
+            {737, 135, 49, 24, 14, 9, 6, 4, 3, 2, 2, 2, 1, 1, 1,
+             1,   5,   2,  1,  1,  1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+             1,   1,   1,  1,  1,  1, 1, 1, 1, 1, 1, 1, 1, 1},
+            {822, 106, 32, 13, 7, 4, 2, 2, 1, 1, 1, 1, 1, 1, 1,
+             1,   1,   1,  1,  1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+             1,   1,   1,  1,  1, 1, 1, 1, 1, 1, 1, 1, 1, 1},
+            {908, 59, 12, 4, 2, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+             1,   1,  1,  1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+             1,   1,  1,  1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1}};
+        std::vector<tans_model> models;
+        for (uint64_t shape = 0; shape != count; ++shape) {
+            models.emplace_back(frequencies[shape]);
+        }
+        return models;
+    }
+};
+
+}  // namespace ds2i
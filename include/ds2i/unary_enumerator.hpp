@@ -0,0 +1,181 @@
+#pragma once
+
+#include <cassert>
+#include <cstdint>
+
+// pdep is microcoded (tens to hundreds of cycles) before Zen 3, so the
+// BMI2 select is not used when compiling for those AMD targets
+#if defined(__BMI2__) &&                                           \
+    !(defined(__znver1__) || defined(__znver2__) ||                \
+      defined(__tune_znver1__) || defined(__tune_znver2__) ||      \
+      defined(__bdver4__) || defined(__tune_bdver4__))
+#define DS2I_FAST_PDEP
+#endif
+
+#if defined(DS2I_FAST_PDEP) || defined(__AVX512VPOPCNTDQ__)
+#include <immintrin.h>
+#endif
+
+#include <succinct/bit_vector.hpp>
+#include <succinct/broadword.hpp>
+
+namespace ds2i {
+
+// position of the k-th (from 0) one of x, which must have more than k
+inline uint64_t select_in_word(uint64_t x, uint64_t k) {
+    assert(k < succinct::broadword::popcount(x));
+#if defined(DS2I_FAST_PDEP)
+    // deposits a one at the position of the k-th one of x
+    return __builtin_ctzll(_pdep_u64(uint64_t(1) << k, x));
+#else
+    return succinct::broadword::select_in_word(x, k);
+#endif
+}
+
+// Enumerator of the ones of a bit vector, as
+// succinct::bit_vector::unary_enumerator, with the instructions of the
+// target when they are available: the selects in a word use pdep and tzcnt
+// (BMI2, where pdep is fast) and the skips count the bits of 8 words at a
+// time (AVX-512 VPOPCNTDQ) before the one that contains their target.
+class unary_enumerator {
+public:
+    unary_enumerator()
+        : m_data(0)
+        , m_words(0)
+        , m_position(0)
+        , m_buf(0) {}
+
+    unary_enumerator(succinct::bit_vector const& bv, uint64_t pos)
+        : m_data(bv.data().data())
+        , m_words(bv.data().size())
+        , m_position(pos) {
+        m_buf = m_data[pos / 64];
+        // clear low bits
+        m_buf &= uint64_t(-1) << (pos % 64);
+    }
+
+    uint64_t position() const {
+        return m_position;
+    }
+
+    uint64_t next() {
+        uint64_t buf = m_buf;
+        while (!buf) {
+            m_position += 64;
+            buf = m_data[m_position / 64];
+        }
+        uint64_t pos_in_word = __builtin_ctzll(buf);
+        m_buf = buf & (buf - 1);  // clear LSB
+        m_position = (m_position & ~uint64_t(63)) + pos_in_word;
+        return m_position;
+    }
+
+    // skip to the k-th one after the current position
+    uint64_t skip(uint64_t k) {
+        uint64_t buf = m_buf;
+        uint64_t rank = skip_words<true>(buf, k);
+        uint64_t pos_in_word = select_in_word(buf, rank);
+        m_buf = buf & (uint64_t(-1) << pos_in_word);
+        m_position = (m_position & ~uint64_t(63)) + pos_in_word;
+        return m_position;
+    }
+
+    // skip to the k-th zero after the current position
+    uint64_t skip0(uint64_t k) {
+        uint64_t pos_in_word = m_position % 64;
+        uint64_t buf = ~m_buf & (uint64_t(-1) << pos_in_word);
+        uint64_t rank = skip_words<false>(buf, k);
+        pos_in_word = select_in_word(buf, rank);
+        m_buf = ~buf & (uint64_t(-1) << pos_in_word);
+        m_position = (m_position & ~uint64_t(63)) + pos_in_word;
+        return m_position;
+    }
+
+private:
+    template <bool Ones>
+    uint64_t word(uint64_t i) const {
+        return Ones ? m_data[i] : ~m_data[i];
+    }
+
+    // moves to the word that has the k-th one (zero, if not Ones) after
+    // the current position, where buf has the bits of the current word
+    // that are left, and returns the rank of that bit in the word, whose
+    // bits are left in buf
+    template <bool Ones>
+    uint64_t skip_words(uint64_t& buf, uint64_t k) {
+        using succinct::broadword::popcount;
+        uint64_t skipped = 0;
+        uint64_t w = 0;
+#if defined(__AVX512F__) && defined(__AVX512VPOPCNTDQ__)
+        if (skipped + (w = popcount(buf)) <= k) {
+            skipped += w;
+            m_position += 64;
+            for (uint64_t i = m_position / 64; i + 8 <= m_words; i += 8) {
+                __m512i words = _mm512_loadu_si512(m_data + i);
+                if (!Ones) {
+                    words =
+                        _mm512_ternarylogic_epi64(words, words, words, 0x55);
+                }
+                w = sum_words(_mm512_popcnt_epi64(words));
+                if (skipped + w > k) break;
+                skipped += w;
+                m_position += 512;
+            }
+            buf = word<Ones>(m_position / 64);
+        }
+#endif
+        while (skipped + (w = popcount(buf)) <= k) {
+            skipped += w;
+            m_position += 64;
+            buf = word<Ones>(m_position / 64);
+        }
+        assert(buf);
+        return k - skipped;
+    }
+
+#if defined(__AVX512F__) && defined(__AVX512VPOPCNTDQ__)
+    // the intrinsics that extract the halves of a vector (as in
+    // _mm512_reduce_add_epi64) go through _mm256_undefined_si256, which
+    // makes GCC warn (-Wmaybe-uninitialized) wherever they are inlined
+    static uint64_t sum_words(__m512i v) {
+        alignas(64) uint64_t words[8];
+        _mm512_store_si512(words, v);
+        return words[0] + words[1] + words[2] + words[3] + words[4] +
+               words[5] + words[6] + words[7];
+    }
+#endif
+
+    uint64_t const* m_data;
+    uint64_t m_words;
+    uint64_t m_position;
+    uint64_t m_buf;
+};
+
+// writes to out the positions of the first n ones from bit begin of data,
+// relative to begin and plus base; with MinusRank, each position is also
+// decreased by its rank, which gives the high parts of Elias-Fano
+template <bool MinusRank>
+inline void decode_ones(uint64_t const* data, uint64_t begin, uint64_t n,
+                        uint64_t base, uint32_t* out) {
+    uint64_t word_index = begin / 64;
+    uint64_t w = data[word_index] & (uint64_t(-1) << (begin % 64));
+    // the arithmetic is modulo 2^64, as the first word can start before begin
+    uint64_t word_base = base + word_index * 64 - begin;
+    uint64_t i = 0;
+    // all the ones of the word are in the sequence, except in the last word
+    while (i + succinct::broadword::popcount(w) < n) {
+        while (w) {
+            out[i] = word_base + __builtin_ctzll(w) - (MinusRank ? i : 0);
+            ++i;
+            w &= w - 1;
+        }
+        w = data[++word_index];
+        word_base += 64;
+    }
+    for (; i != n; ++i) {
+        out[i] = word_base + __builtin_ctzll(w) - (MinusRank ? i : 0);
+        w &= w - 1;
+    }
+}
+
+}  // namespace ds2i
@@ -4,10 +4,23 @@
 
 #include "binary_freq_collection.hpp"
 #include "bm25.hpp"
+#include "configuration.hpp"
+#include "score_opt_partition.hpp"
 #include "util.hpp"
 
 namespace ds2i {
 
+struct block_max_parameters {
+    block_max_parameters()
+        : variable_blocks(false)
+        , block_size(constants::block_size)
+        , fixed_cost(4.0) {}
+
+    bool variable_blocks;
+    uint64_t block_size;  // postings per block, for fixed-size blocks
+    double fixed_cost;    // cost of a block, for variable-sized blocks
+};
+
 template <typename Scorer = bm25>
 class wand_data {
 public:
@@ -15,7 +28,8 @@ public:
 
     template <typename LengthsIterator>
     wand_data(LengthsIterator len_it, uint64_t num_docs,
-              binary_freq_collection const& coll) {
+              binary_freq_collection const& coll,
+              block_max_parameters const& params = block_max_parameters()) {
         std::vector<float> norm_lens(num_docs);
         double lens_sum = 0;
         logger() << "Reading sizes...";
@@ -29,25 +43,115 @@ public:
             norm_lens[i] /= avg_len;
         }
 
-        logger() << "Storing max weight for each list...";
+        logger() << "Storing max weight for each list and block...";
         std::vector<float> max_term_weight;
+        std::vector<float> block_max_term_weight;
+        std::vector<uint32_t> block_docid;
+        std::vector<uint64_t> blocks_start;
+        blocks_start.push_back(0);
+        auto const& conf = configuration::get();
+        std::vector<float> scores;
         for (auto const& seq : coll) {
-            float max_score = 0;
-            for (size_t i = 0; i < seq.docs.size(); ++i) {
+            size_t n = seq.docs.size();
+            scores.resize(n);
+            for (size_t i = 0; i < n; ++i) {
                 uint64_t docid = *(seq.docs.begin() + i);
                 uint64_t freq = *(seq.freqs.begin() + i);
-                float score = Scorer::doc_term_weight(freq, norm_lens[docid]);
-                max_score = std::max(max_score, score);
+                scores[i] = Scorer::doc_term_weight(freq, norm_lens[docid]);
+            }
+
+            auto add_block = [&](size_t begin, size_t end) {
+                float block_max_score =
+                    *std::max_element(scores.begin() + begin,
+                                      scores.begin() + end);
+                block_max_term_weight.push_back(block_max_score);
+                block_docid.push_back(*(seq.docs.begin() + end - 1));
+            };
+
+            if (params.variable_blocks) {
+                score_opt_partition opt(scores, params.fixed_cost, conf.eps1,
+                                        conf.eps2);
+                size_t begin = 0;
+                for (auto end : opt.partition) {
+                    add_block(begin, end);
+                    begin = end;
+                }
+            } else {
+                for (size_t begin = 0; begin < n; begin += params.block_size) {
+                    add_block(begin, std::min(n, begin + params.block_size));
+                }
             }
+
+            float max_score = *std::max_element(
+                block_max_term_weight.begin() + blocks_start.back(),
+                block_max_term_weight.end());
             max_term_weight.push_back(max_score);
+            blocks_start.push_back(block_docid.size());
             if ((max_term_weight.size() % 1000000) == 0) {
                 logger() << max_term_weight.size() << " list processed";
             }
         }
         logger() << max_term_weight.size() << " list processed";
+        logger() << block_docid.size() << " blocks stored ("
+                 << (params.variable_blocks ? "variable" : "fixed")
+                 << "-sized)";
 
         m_norm_lens.steal(norm_lens);
         m_max_term_weight.steal(max_term_weight);
+        m_block_max_term_weight.steal(block_max_term_weight);
+        m_block_docid.steal(block_docid);
+        m_blocks_start.steal(blocks_start);
+    }
+
+    // Iterates over the block-max scores of a list: the current block is the
+    // first one whose last docid is >= the last requested lower bound.
+    class enumerator {
+    public:
+        enumerator(float const* block_max_term_weight,
+                   uint32_t const* block_docid, uint64_t num_blocks)
+            : m_block_max_term_weight(block_max_term_weight)
+            , m_block_docid(block_docid)
+            , m_num_blocks(num_blocks)
+            , m_cur_block(0) {}
+
+        void reset() {
+            m_cur_block = 0;
+        }
+
+        // if lower_bound is past the last block, the enumerator stays on
+        // the last block, whose docid is then < lower_bound
+        void DS2I_ALWAYSINLINE next_geq(uint64_t lower_bound) {
+            while (m_cur_block + 1 < m_num_blocks &&
+                   m_block_docid[m_cur_block] < lower_bound) {
+                ++m_cur_block;
+            }
+        }
+
+        // last docid of the current block
+        uint64_t docid() const {
+            return m_block_docid[m_cur_block];
+        }
+
+        float score() const {
+            return m_block_max_term_weight[m_cur_block];
+        }
+
+        uint64_t num_blocks() const {
+            return m_num_blocks;
+        }
+
+    private:
+        float const* m_block_max_term_weight;
+        uint32_t const* m_block_docid;
+        uint64_t m_num_blocks;
+        uint64_t m_cur_block;
+    };
+
+    enumerator get_block_wand(uint64_t term_id) const {
+        uint64_t begin = m_blocks_start[term_id];
+        uint64_t end = m_blocks_start[term_id + 1];
+        return enumerator(m_block_max_term_weight.data() + begin,
+                          m_block_docid.data() + begin, end - begin);
     }
 
     float norm_len(uint64_t doc_id) const {
@@ -61,17 +165,25 @@ public:
     void swap(wand_data& other) {
         m_norm_lens.swap(other.m_norm_lens);
         m_max_term_weight.swap(other.m_max_term_weight);
+        m_block_max_term_weight.swap(other.m_block_max_term_weight);
+        m_block_docid.swap(other.m_block_docid);
+        m_blocks_start.swap(other.m_blocks_start);
     }
 
     template <typename Visitor>
     void map(Visitor& visit) {
         visit(m_norm_lens, "m_norm_lens")(m_max_term_weight,
-                                          "m_max_term_weight");
+                                          "m_max_term_weight")(
+            m_block_max_term_weight, "m_block_max_term_weight")(
+            m_block_docid, "m_block_docid")(m_blocks_start, "m_blocks_start");
     }
 
 private:
     succinct::mapper::mappable_vector<float> m_norm_lens;
     succinct::mapper::mappable_vector<float> m_max_term_weight;
+    succinct::mapper::mappable_vector<float> m_block_max_term_weight;
+    succinct::mapper::mappable_vector<uint32_t> m_block_docid;
+    succinct::mapper::mappable_vector<uint64_t> m_blocks_start;
 };
 
 }  // namespace ds2i
@@ -1,5 +1,7 @@
 #pragma once
 
+#include <string>
+
 #include <boost/preprocessor/seq/for_each.hpp>
 #include <boost/preprocessor/stringize.hpp>
 #include <boost/preprocessor/cat.hpp>
@@ -12,6 +14,9 @@
 #include "block_freq_index.hpp"
 #include "block_codecs.hpp"
 #include "mixed_block.hpp"
+#include "hybrid_block.hpp"
+#include "paired_block.hpp"
+#include "roaring_freq_index.hpp"
 
 #include "dint_configuration.hpp"
 #include "dint_codecs.hpp"
@@ -36,6 +41,10 @@ typedef freq_index<partitioned_sequence<>,
 
 // pfor-based indexes
 typedef block_freq_index<optpfor_block> optpfor_index;
+typedef block_freq_index<simdfastpfor_block> simdfastpfor_index;
+
+// SIMD bit-packing index
+typedef block_freq_index<simdbp128_block> simdbp128_index;
 
 // binary interpolative coding index
 typedef block_freq_index<interpolative_block> bic_index;
@@ -62,8 +71,53 @@ typedef block_freq_index<delta_block> delta_index;
 typedef block_freq_index<delta_table_block> delta_table_index;
 typedef block_freq_index<rice_block> rice_index;
 typedef block_freq_index<zeta_block> zeta_index;
+typedef block_freq_index<gamma_table_block> gamma_table_index;
+typedef block_freq_index<rice_table_block> rice_table_index;
+typedef block_freq_index<zeta_table_block> zeta_table_index;
 typedef pvb::opt_delta opt_delta_index;
 
+// entropy-coded index
+typedef block_freq_index<tans_block> tans_index;
+
+// index with a codec chosen for each block, created by transforming a block
+// index with optimal_hybrid_index
+typedef block_freq_index<mixed_block> mixed_index;
+
+// index with a codec chosen for each list among the block codecs that work
+// best on dense (bitmaps, bit-packing, interpolative) and sparse (vbyte)
+// lists; the Elias-Fano sequences of ef and pef are not among them (see
+// hybrid_block.hpp)
+typedef block_freq_index<
+    hybrid_block<optpfor_block, simdbp128_block, interpolative_block,
+                 bitmap_block, varint_G8IU_block, maskedvbyte_block,
+                 streamvbyte_block, qmx_block>>
+    hybrid_index;
+
+// index with the docids of each list in a roaring bitmap, for the boolean
+// queries on dense lists, and the frequencies in blocks
+typedef roaring_freq_index<optpfor_block> roaring_index;
+
+// block-based indexes with a codec for the docids and one for the
+// frequencies, named "<docs>+<freqs>" after the indexes of the two codecs
+// (see with_paired_index_type)
+template <typename DocsCodec, typename FreqsCodec>
+using paired_index = block_freq_index<paired_block<DocsCodec, FreqsCodec>>;
+
+// block-based indexes with blocks of 64, 256 and 512 integers instead of
+// constants::block_size, named with the block size as suffix
+typedef block_freq_index<basic_optpfor_block<64>> optpfor_64_index;
+typedef block_freq_index<basic_optpfor_block<256>> optpfor_256_index;
+typedef block_freq_index<basic_optpfor_block<512>> optpfor_512_index;
+typedef block_freq_index<basic_interpolative_block<64>> bic_64_index;
+typedef block_freq_index<basic_interpolative_block<256>> bic_256_index;
+typedef block_freq_index<basic_interpolative_block<512>> bic_512_index;
+typedef block_freq_index<basic_qmx_block<64>> qmx_64_index;
+typedef block_freq_index<basic_qmx_block<256>> qmx_256_index;
+typedef block_freq_index<basic_qmx_block<512>> qmx_512_index;
+typedef block_freq_index<basic_streamvbyte_block<64>> streamvbyte_64_index;
+typedef block_freq_index<basic_streamvbyte_block<256>> streamvbyte_256_index;
+typedef block_freq_index<basic_streamvbyte_block<512>> streamvbyte_512_index;
+
 // DINT-based indexes
 using adjusted_collector_type = adjusted<constants::max_entry_size>;
 using adjusted_block_stats_type = block_statistics<adjusted_collector_type>;
@@ -75,6 +129,9 @@ using single_rectangular_builder =
 using single_packed_builder =
     decreasing_static_frequencies<single_dictionary_packed_type,
                                   adjusted_block_stats_type>;
+using single_compact_builder =
+    decreasing_static_frequencies<single_dictionary_compact_type,
+                                  adjusted_block_stats_type>;
 using multi_packed_builder =
     decreasing_static_frequencies<multi_dictionary_packed_type,
                                   adjusted_block_multi_stats_type>;
@@ -84,12 +141,86 @@ using single_rect_dint_index =
     dict_freq_index<single_rectangular_builder, opt_dint_single_dict_block>;
 using single_packed_dint_index =
     dict_freq_index<single_packed_builder, opt_dint_single_dict_block>;
+// 8-bit codewords, with a dictionary of 256 entries
+using single_compact_dint_index =
+    dict_freq_index<single_compact_builder, opt_dint8_single_dict_block>;
 using multi_packed_dint_index =
     dict_freq_index<multi_packed_builder, opt_dint_multi_dict_block>;
 }  // namespace ds2i
 
-#define DS2I_INDEX_TYPES                                                     \
-    (ef)(pef_uniform)(pef_opt)(optpfor)(bic)(qmx)(simple9)(simple16)(        \
-        simple8b)(vbyte)(varintg8iu)(varintgb)(maskedvbyte)(streamvbyte)(    \
-        gamma)(delta)(delta_table)(opt_delta)(rice)(zeta)(single_rect_dint)( \
-        single_packed_dint)(multi_packed_dint)(opt_vbyte)
+#define DS2I_INDEX_TYPES                                                    \
+    (ef)(pef_uniform)(pef_opt)(optpfor)(simdfastpfor)(simdbp128)(bic)(qmx)( \
+        simple9)(simple16)(simple8b)(vbyte)(varintg8iu)(varintgb)(          \
+        maskedvbyte)(streamvbyte)(gamma)(delta)(delta_table)(opt_delta)(    \
+        rice)(zeta)(gamma_table)(rice_table)(zeta_table)(single_rect_dint)( \
+        single_packed_dint)(single_compact_dint)(multi_packed_dint)(        \
+        opt_vbyte)(optpfor_64)(optpfor_256)(optpfor_512)(bic_64)(bic_256)(  \
+        bic_512)(qmx_64)(qmx_256)(qmx_512)(streamvbyte_64)(                 \
+        streamvbyte_256)(streamvbyte_512)(tans)(mixed)(hybrid)(roaring)
+
+// the indexes made of block_posting_list with constants::block_size blocks
+#define DS2I_BLOCK_INDEX_TYPES                                              \
+    (optpfor)(simdfastpfor)(simdbp128)(bic)(qmx)(simple9)(simple16)(        \
+        simple8b)(vbyte)(varintg8iu)(varintgb)(maskedvbyte)(streamvbyte)(   \
+        gamma)(delta)(delta_table)(rice)(zeta)(gamma_table)(rice_table)(    \
+        zeta_table)(tans)(mixed)(hybrid)
+
+// the indexes whose codecs can be combined in paired indexes, for the
+// docids and for the frequencies
+#define DS2I_PAIRED_DOCS_TYPES \
+    (optpfor)(simdbp128)(qmx)(varintg8iu)(maskedvbyte)(streamvbyte)
+#define DS2I_PAIRED_FREQS_TYPES (simple16)(rice)(gamma)(tans)(bic)(optpfor)
+
+namespace ds2i {
+
+template <typename IndexType>
+struct index_type_tag {
+    typedef IndexType type;
+};
+
+namespace detail {
+
+template <typename DocsCodec, typename Functor>
+bool with_paired_freqs_type(std::string const& freqs_type, Functor&& f) {
+    if (false) {
+#define LOOP_BODY(R, DATA, T)                                                \
+    }                                                                        \
+    else if (freqs_type == BOOST_PP_STRINGIZE(T)) {                          \
+        f(index_type_tag<paired_index<                                       \
+              DocsCodec, BOOST_PP_CAT(T, _index)::block_codec_type>>());     \
+        return true;                                                         \
+        /**/
+
+        BOOST_PP_SEQ_FOR_EACH(LOOP_BODY, _, DS2I_PAIRED_FREQS_TYPES);
+#undef LOOP_BODY
+    }
+    return false;
+}
+
+}  // namespace detail
+
+// If type names a paired index, "<docs>+<freqs>", calls f with its
+// index_type_tag and returns true; the pairs are not listed in
+// DS2I_INDEX_TYPES, so the tools dispatch on them with this.
+template <typename Functor>
+bool with_paired_index_type(std::string const& type, Functor&& f) {
+    size_t separator = type.find('+');
+    if (separator == std::string::npos) return false;
+    std::string docs_type = type.substr(0, separator);
+    std::string freqs_type = type.substr(separator + 1);
+
+    if (false) {
+#define LOOP_BODY(R, DATA, T)                                                \
+    }                                                                        \
+    else if (docs_type == BOOST_PP_STRINGIZE(T)) {                           \
+        return detail::with_paired_freqs_type<                               \
+            BOOST_PP_CAT(T, _index)::block_codec_type>(freqs_type, f);       \
+        /**/
+
+        BOOST_PP_SEQ_FOR_EACH(LOOP_BODY, _, DS2I_PAIRED_DOCS_TYPES);
+#undef LOOP_BODY
+    }
+    return false;
+}
+
+}  // namespace ds2i
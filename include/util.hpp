@@ -1,5 +1,6 @@
 #pragma once
 
+#include <algorithm>
 #include <cassert>
 #include <chrono>
 #include <cmath>
@@ -83,10 +84,11 @@ inline std::ostream& logger() {
     return std::cerr << ": ";
 }
 
+// monotonic, so that intervals are not affected by clock adjustments
 inline double get_time_usecs() {
-    timeval tv;
-    gettimeofday(&tv, NULL);
-    return double(tv.tv_sec) * 1000000 + double(tv.tv_usec);
+    return std::chrono::duration<double, std::micro>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
 }
 
 inline double get_user_time_usecs() {
@@ -265,4 +267,45 @@ private:
     bool first;
 };
 
+// Distribution of per-query latencies, in microseconds.
+class latency_distribution {
+public:
+    latency_distribution(std::vector<double> times)
+        : m_times(std::move(times)) {
+        std::sort(m_times.begin(), m_times.end());
+    }
+
+    // nearest-rank percentile, for 0 < p <= 100
+    double percentile(double p) const {
+        if (m_times.empty()) return 0;
+        // the epsilon avoids rounding up exact ranks, e.g. 99.9% of 1000
+        size_t rank = size_t(std::ceil(p / 100 * m_times.size() - 1e-9));
+        return m_times[std::max(rank, size_t(1)) - 1];
+    }
+
+    double max() const {
+        return m_times.empty() ? 0 : m_times.back();
+    }
+
+    // calls f(name, value) for each reported statistic
+    template <typename Functor>
+    void for_each_stat(Functor f) const {
+        f("p50_musec", percentile(50));
+        f("p90_musec", percentile(90));
+        f("p95_musec", percentile(95));
+        f("p99_musec", percentile(99));
+        f("p999_musec", percentile(99.9));
+        f("max_musec", max());
+    }
+
+    template <typename StatsLine>
+    StatsLine& dump(StatsLine& sl) const {
+        for_each_stat([&](const char* name, double value) { sl(name, value); });
+        return sl;
+    }
+
+private:
+    std::vector<double> m_times;
+};
+
 }  // namespace ds2i
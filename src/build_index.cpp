@@ -1,12 +1,18 @@
 #include <fstream>
 #include <iostream>
 #include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <new>
+#include <stdexcept>
 #include <thread>
 #include <numeric>
+#include <memory>
 
 #include <succinct/mapper.hpp>
 
 #include "configuration.hpp"
+#include "impacts.hpp"
 #include "index_types.hpp"
 #include "util.hpp"
 #include "verify_collection.hpp"
@@ -16,6 +22,28 @@
 #include "../external/s_indexes/include/s_index.hpp"
 #include "../external/s_indexes/include/builder.hpp"
 
+#ifdef DS2I_COUNT_ALLOCATIONS
+// heap allocations made so far, to report those made while encoding the
+// lists next to the construction time; replacing the global operator new
+// costs an atomic increment per allocation, so it is only compiled in on
+// request (cmake -DCOUNT_ALLOCATIONS=ON)
+static std::atomic<uint64_t> allocations(0);
+
+void* operator new(size_t size) {
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    if (void* ptr = std::malloc(size ? size : 1)) return ptr;
+    throw std::bad_alloc();
+}
+
+void operator delete(void* ptr) noexcept {
+    std::free(ptr);
+}
+
+void operator delete(void* ptr, size_t) noexcept {
+    std::free(ptr);
+}
+#endif
+
 void create_collection_slicing(sliced::parameters const& params,
                                char const* output_filename) {
     using namespace sliced;
@@ -46,7 +74,7 @@ template <typename CollectionType>
 void create_collection(std::string input_basename,
                        global_parameters const& params,
                        const char* output_filename,
-                       std::string const& seq_type) {
+                       std::string const& seq_type, uint32_t impact_bits) {
     binary_freq_collection input(input_basename.c_str());
     size_t num_docs = input.num_docs();
 
@@ -54,21 +82,47 @@ void create_collection(std::string input_basename,
     build_model<CollectionType>(input_basename, builder);
 
     std::cerr << "universe size: " << input.num_docs() << std::endl;
+
+    // when requested, the frequencies are replaced by quantized impacts
+    std::unique_ptr<wand_data<>> wdata;
+    std::unique_ptr<impact_quantizer<>> quantizer;
+    if (impact_bits) {
+        binary_collection sizes((input_basename + ".sizes").c_str());
+        wdata.reset(new wand_data<>(sizes.begin()->begin(), num_docs, input));
+        quantizer.reset(new impact_quantizer<>(num_docs, impact_bits));
+    }
+
     progress_logger plog("Encoded");
 
     essentials::timer_type t;
+#ifdef DS2I_COUNT_ALLOCATIONS
+    uint64_t allocations_before = allocations.load();
+#endif
     t.start();
     for (auto const& plist : input) {
         uint64_t n = plist.docs.size();
         if (n > constants::min_size) {
-            uint64_t freqs_sum = std::accumulate(
-                plist.freqs.begin(), plist.freqs.end(), uint64_t(0));
-            builder.add_posting_list(n, plist.docs.begin(), plist.freqs.begin(),
-                                     freqs_sum);
+            if (impact_bits) {
+                auto impacts_it =
+                    impacts_begin(plist, num_docs, *wdata, *quantizer);
+                uint64_t impacts_sum = 0;
+                auto it = impacts_it;
+                for (uint64_t i = 0; i < n; ++i, ++it) impacts_sum += *it;
+                builder.add_posting_list(n, plist.docs.begin(), impacts_it,
+                                         impacts_sum);
+            } else {
+                uint64_t freqs_sum = std::accumulate(
+                    plist.freqs.begin(), plist.freqs.end(), uint64_t(0));
+                builder.add_posting_list(n, plist.docs.begin(),
+                                         plist.freqs.begin(), freqs_sum);
+            }
             plog.done_sequence(n);
         }
     }
     t.stop();
+#ifdef DS2I_COUNT_ALLOCATIONS
+    uint64_t construction_allocations = allocations.load() - allocations_before;
+#endif
     double elapsed_secs = t.average() / 1000000;
     std::cerr << "collection built in " << elapsed_secs << " [sec]"
               << std::endl;
@@ -77,9 +131,15 @@ void create_collection(std::string input_basename,
     CollectionType coll;
     builder.build(coll);
 
-    stats_line()("type", seq_type)("worker_threads",
-                                   configuration::get().worker_threads)(
-        "construction_time", elapsed_secs);
+    {
+        stats_line sl;
+        sl("type", seq_type)("worker_threads",
+                             configuration::get().worker_threads)(
+            "construction_time", elapsed_secs)("impact_bits", impact_bits);
+#ifdef DS2I_COUNT_ALLOCATIONS
+        sl("construction_allocations", construction_allocations);
+#endif
+    }
 
     dump_stats(coll, seq_type, plog.postings);
 
@@ -93,7 +153,9 @@ int main(int argc, const char** argv) {
     if (argc < mandatory) {
         std::cerr << "Usage: " << argv[0] << ":\n"
                   << "\t index_type collection_basename "
-                     "--out output_filename"
+                     "--out output_filename [--impacts bits]\n"
+                  << "\t index_type can also be <docs>+<freqs>, as in "
+                     "simdbp128+simple16, to pair two block codecs"
                   << std::endl;
         return 1;
     }
@@ -101,8 +163,17 @@ int main(int argc, const char** argv) {
     std::string index_type = argv[1];
     const char* input_basename = argv[2];
     const char* output_filename = nullptr;
-    if (argc > mandatory and std::string(argv[mandatory]) == "--out") {
-        output_filename = argv[mandatory + 1];
+    uint32_t impact_bits = 0;
+    for (int i = mandatory; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--out" && i + 1 < argc) {
+            output_filename = argv[++i];
+        } else if (arg == "--impacts" && i + 1 < argc) {
+            impact_bits = std::stoul(argv[++i]);
+        } else {
+            // also a known option without its value
+            throw std::invalid_argument("Unknown option " + arg);
+        }
     }
 
     if (index_type == "slicing") {
@@ -114,6 +185,15 @@ int main(int argc, const char** argv) {
         return 0;
     }
 
+    // the codecs of a mixed index are chosen per block from the profile of
+    // another index, so it can only be made by optimal_hybrid_index
+    if (index_type == "mixed") {
+        logger() << "ERROR: mixed indexes are built from a block index with "
+                    "optimal_hybrid_index"
+                 << std::endl;
+        return 1;
+    }
+
     ds2i::global_parameters params;
     params.log_partition_size = configuration::get().log_partition_size;
 
@@ -122,12 +202,17 @@ int main(int argc, const char** argv) {
     }                                                             \
     else if (index_type == BOOST_PP_STRINGIZE(T)) {               \
         create_collection<BOOST_PP_CAT(T, _index)>(               \
-            input_basename, params, output_filename, index_type); \
+            input_basename, params, output_filename, index_type,  \
+            impact_bits);                                         \
         /**/
 
         BOOST_PP_SEQ_FOR_EACH(LOOP_BODY, _, DS2I_INDEX_TYPES);
 #undef LOOP_BODY
-    } else {
+    } else if (!with_paired_index_type(index_type, [&](auto tag) {
+                   create_collection<typename decltype(tag)::type>(
+                       input_basename, params, output_filename, index_type,
+                       impact_bits);
+               })) {
         logger() << "ERROR: Unknown index type " << index_type << std::endl;
     }
 
@@ -0,0 +1,199 @@
+#include <algorithm>
+#include <iostream>
+#include <stdexcept>
+#include <unordered_map>
+
+#include <succinct/mapper.hpp>
+
+#include "configuration.hpp"
+#include "index_build_utils.hpp"
+#include "index_types.hpp"
+#include "pair_index.hpp"
+#include "queries.hpp"
+#include "util.hpp"
+
+using namespace ds2i;
+
+// Intersection of two lists, with the frequencies of both terms.
+template <typename Enum>
+void intersect_pair(Enum first, Enum second, uint64_t num_docs,
+                    std::vector<uint64_t>& docs,
+                    std::vector<uint64_t>& first_freqs,
+                    std::vector<uint64_t>& second_freqs) {
+    docs.clear();
+    first_freqs.clear();
+    second_freqs.clear();
+    while (first.docid() < num_docs && second.docid() < num_docs) {
+        if (first.docid() < second.docid()) {
+            first.next_geq(second.docid());
+        } else if (second.docid() < first.docid()) {
+            second.next_geq(first.docid());
+        } else {
+            docs.push_back(first.docid());
+            first_freqs.push_back(first.freq());
+            second_freqs.push_back(second.freq());
+            first.next();
+            second.next();
+        }
+    }
+}
+
+struct pair_candidate {
+    term_id_type first;
+    term_id_type second;
+    uint64_t freq;  // occurrences in the query log
+    uint64_t size;  // of the intersection
+    double benefit;
+    double cost;
+};
+
+// The pairs are chosen greedily by benefit per byte: the benefit of a pair
+// is the number of postings it saves to read over the query log, its cost
+// is estimated from the average bits per posting of the main index (each
+// pair list is stored twice).
+template <typename IndexType>
+void build_pairs(const char* index_filename, std::string const& basename,
+                 std::vector<term_id_vec> const& queries, double budget_mib,
+                 const char* output_filename, std::string const& type) {
+    IndexType index;
+    logger() << "Loading index from " << index_filename << std::endl;
+    boost::iostreams::mapped_file_source m(index_filename);
+    succinct::mapper::map(index, m);
+    uint64_t num_docs = index.num_docs();
+
+    uint64_t postings = 0;
+    for (uint64_t t = 0; t < index.size(); ++t) postings += index[t].size();
+    double bits_per_posting =
+        8.0 * succinct::mapper::size_tree_of(index)->size / postings;
+
+    std::unordered_map<uint64_t, uint64_t> pair_freqs;
+    for (auto q : queries) {
+        remove_duplicate_terms(q);
+        for (size_t i = 0; i < q.size(); ++i) {
+            for (size_t j = i + 1; j < q.size(); ++j) {
+                pair_freqs[pair_index<IndexType>::pair_key(q[i], q[j])] += 1;
+            }
+        }
+    }
+    logger() << pair_freqs.size() << " distinct term pairs in "
+             << queries.size() << " queries" << std::endl;
+
+    std::vector<uint64_t> docs, first_freqs, second_freqs;
+    std::vector<pair_candidate> candidates;
+    for (auto const& p : pair_freqs) {
+        term_id_type first = p.first >> 32;
+        term_id_type second = p.first & 0xFFFFFFFF;
+        if (second >= index.size()) continue;
+        auto first_list = index[first];
+        auto second_list = index[second];
+        intersect_pair(first_list, second_list, num_docs, docs, first_freqs,
+                       second_freqs);
+        if (docs.empty()) continue;  // lists must be nonempty
+        pair_candidate c;
+        c.first = first;
+        c.second = second;
+        c.freq = p.second;
+        c.size = docs.size();
+        c.benefit = double(p.second) *
+                    (first_list.size() + second_list.size() - docs.size());
+        c.cost = 2 * docs.size() * bits_per_posting / 8;
+        candidates.push_back(c);
+    }
+    std::sort(candidates.begin(), candidates.end(),
+              [](pair_candidate const& lhs, pair_candidate const& rhs) {
+                  return lhs.benefit / lhs.cost > rhs.benefit / rhs.cost;
+              });
+
+    global_parameters params;
+    params.log_partition_size = configuration::get().log_partition_size;
+    typename pair_index<IndexType>::builder builder(num_docs, params);
+    builder.build_model(basename);
+
+    double budget = budget_mib * constants::MiB;
+    double estimated_bytes = 0;
+    uint64_t pair_postings = 0;
+    uint64_t covered_occurrences = 0;
+    uint64_t total_occurrences = 0;
+    progress_logger plog("Intersected");
+    for (auto const& c : candidates) {
+        total_occurrences += c.freq;
+        if (estimated_bytes + c.cost > budget) continue;
+        estimated_bytes += c.cost;
+        pair_postings += c.size;
+        covered_occurrences += c.freq;
+        intersect_pair(index[c.first], index[c.second], num_docs, docs,
+                       first_freqs, second_freqs);
+        builder.add_pair(c.first, c.second, docs, first_freqs, second_freqs);
+        plog.done_sequence(c.size);
+    }
+    plog.log();
+
+    pair_index<IndexType> pairs;
+    builder.build(pairs);
+
+    stats_line()("type", type)("budget_bytes", budget)(
+        "candidate_pairs", candidates.size())("pairs", pairs.size())(
+        "pair_postings", pair_postings)("estimated_bytes", estimated_bytes)(
+        "bytes", succinct::mapper::size_tree_of(pairs)->size)(
+        "covered_pair_occurrences",
+        double(covered_occurrences) / total_occurrences);
+
+    if (output_filename) {
+        succinct::mapper::freeze(pairs, output_filename);
+    }
+}
+
+int main(int argc, const char** argv) {
+    int mandatory = 5;
+    if (argc < mandatory) {
+        std::cerr << argv[0]
+                  << " <index_type> <collection_basename> <index_filename> "
+                     "<budget_MiB> [--out output_filename] < query_log"
+                  << std::endl;
+        return 1;
+    }
+
+    std::string type = argv[1];
+    std::string basename = argv[2];
+    const char* index_filename = argv[3];
+    double budget_mib = std::stod(argv[4]);
+    const char* output_filename = nullptr;
+    for (int i = mandatory; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--out" && i + 1 < argc) {
+            output_filename = argv[++i];
+        } else {
+            // also a known option without its value
+            throw std::invalid_argument("Unknown option " + arg);
+        }
+    }
+
+    // the pair lists would be encoded with mixed_block, whose codecs are
+    // only chosen by optimal_hybrid_index
+    if (type == "mixed") {
+        logger() << "ERROR: pair indexes cannot be built for mixed indexes"
+                 << std::endl;
+        return 1;
+    }
+
+    std::vector<term_id_vec> queries;
+    term_id_vec q;
+    while (read_query(q)) queries.push_back(q);
+
+    if (false) {
+#define LOOP_BODY(R, DATA, T)                                              \
+    }                                                                      \
+    else if (type == BOOST_PP_STRINGIZE(T)) {                              \
+        build_pairs<BOOST_PP_CAT(T, _index)>(index_filename, basename,     \
+                                             queries, budget_mib,          \
+                                             output_filename, type);       \
+        /**/
+
+        BOOST_PP_SEQ_FOR_EACH(LOOP_BODY, _, DS2I_INDEX_TYPES);
+#undef LOOP_BODY
+    } else {
+        logger() << "ERROR: Unknown type " << type << std::endl;
+    }
+
+    return 0;
+}
@@ -36,7 +36,11 @@ int main(int argc, char** argv) {
 
         BOOST_PP_SEQ_FOR_EACH(LOOP_BODY, _, DS2I_INDEX_TYPES);
 #undef LOOP_BODY
-    } else {
+    } else if (!with_paired_index_type(index_type, [&](auto tag) {
+                   verify_collection<binary_freq_collection,
+                                     typename decltype(tag)::type>(
+                       input, index_filename);
+               })) {
         logger() << "ERROR: Unknown type " << index_type << std::endl;
     }
 
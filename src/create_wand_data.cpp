@@ -10,18 +10,38 @@
 int main(int argc, const char** argv) {
     using namespace ds2i;
 
-    if (argc != 3) {
+    if (argc < 3) {
         std::cerr << "Usage: " << argv[0]
-                  << " <collection basename> <output filename>" << std::endl;
+                  << " <collection basename> <output filename>"
+                  << " [--block-size <postings> | --variable-blocks <cost>]"
+                  << std::endl;
         return 1;
     }
 
     std::string input_basename = argv[1];
     const char* output_filename = argv[2];
+    block_max_parameters params;
+    for (int i = 3; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--block-size" && i + 1 < argc) {
+            params.variable_blocks = false;
+            params.block_size = std::stoull(argv[++i]);
+        } else if (arg == "--variable-blocks" && i + 1 < argc) {
+            params.variable_blocks = true;
+            params.fixed_cost = std::stod(argv[++i]);
+        } else {
+            std::cerr << "Unknown option " << arg << std::endl;
+            return 1;
+        }
+    }
+    if (!params.variable_blocks && !params.block_size) {
+        throw std::invalid_argument("Block size must be positive");
+    }
 
     binary_collection sizes_coll((input_basename + ".sizes").c_str());
     binary_freq_collection coll(input_basename.c_str());
 
-    wand_data<> wdata(sizes_coll.begin()->begin(), coll.num_docs(), coll);
+    wand_data<> wdata(sizes_coll.begin()->begin(), coll.num_docs(), coll,
+                      params);
     succinct::mapper::freeze(wdata, output_filename);
 }
@@ -9,30 +9,23 @@
 
 using namespace ds2i;
 
-typedef single_dictionary_rectangular_type dictionary_type;
-
-int main(int argc, char** argv) {
-    if (argc < 1) {
-        std::cerr << "Usage " << argv[0] << ":\n"
-                  << "\t<dictionary_filename>" << std::endl;
-        return 1;
-    }
-
-    char const* dictionary_filename = argv[1];
-
-    dictionary_type dict;
-    typename dictionary_type::builder builder;
+// times the copy of uniformly random entries of the dictionary stored in
+// dictionary_filename
+template <typename Dictionary>
+void perftest(std::string const& type, char const* dictionary_filename) {
+    Dictionary dict;
+    typename Dictionary::builder builder;
     std::ifstream dictionary_file(dictionary_filename);
-    builder.load(dictionary_file);
+    uint64_t dict_bytes = builder.load(dictionary_file);
     uint64_t dict_size = builder.size();
-    logger() << "loaded a dictionary with " << dict_size << " entries"
-             << std::endl;
+    logger() << "loaded a " << type << " dictionary with " << dict_size
+             << " entries" << std::endl;
     builder.build(dict);
 
     constexpr uint64_t n = 10000000;
     std::random_device rd;
     std::default_random_engine eng(rd());
-    std::uniform_int_distribution<uint32_t> uniform_dist(0, dict_size);
+    std::uniform_int_distribution<uint32_t> uniform_dist(0, dict_size - 1);
 
     std::vector<uint32_t> indexes;
     indexes.reserve(n);
@@ -41,13 +34,15 @@ int main(int argc, char** argv) {
     }
 
     constexpr uint32_t runs = 10;
-    std::vector<uint32_t> out(dictionary_type::max_entry_size,
+    std::vector<uint32_t> out(Dictionary::max_entry_size,
                               0);  // output buffer
     double elapsed_time = 0;
+    uint64_t integers = 0;
     for (uint32_t run = 0; run < runs; ++run) {
         auto start = clock_type::now();
         for (auto index : indexes) {
             uint32_t decoded_ints = dict.copy(index, out.data());
+            integers += decoded_ints;
             do_not_optimize_away(decoded_ints);
         }
         auto end = clock_type::now();
@@ -62,5 +57,41 @@ int main(int argc, char** argv) {
     logger() << "avg. time x copy: " << elapsed_time / runs / n << " [ns]"
              << std::endl;
 
+    stats_line()("dictionary_type", type)("entries", dict_size)(
+        "dictionary_bytes", dict_bytes)("ns_per_copy",
+                                        elapsed_time / runs / n)(
+        "ns_per_int", elapsed_time / integers);
+}
+
+int main(int argc, char** argv) {
+    if (argc < 3 or argc % 2 == 0) {
+        std::cerr << "Usage " << argv[0] << ":\n"
+                  << "\t<dictionary_type> <dictionary_filename> "
+                     "[<dictionary_type> <dictionary_filename> ...]\n"
+                  << "where <dictionary_type> is one of rectangular, packed "
+                     "and compact"
+                  << std::endl;
+        return 1;
+    }
+
+    // the dictionaries are timed one after the other, to compare them
+    for (int i = 1; i < argc; i += 2) {
+        std::string type = argv[i];
+        char const* dictionary_filename = argv[i + 1];
+        if (type == "rectangular") {
+            perftest<single_dictionary_rectangular_type>(type,
+                                                         dictionary_filename);
+        } else if (type == "packed") {
+            perftest<single_dictionary_packed_type>(type,
+                                                    dictionary_filename);
+        } else if (type == "compact") {
+            perftest<single_dictionary_compact_type>(type,
+                                                     dictionary_filename);
+        } else {
+            logger() << "ERROR: Unknown dictionary type " << type << std::endl;
+            return 1;
+        }
+    }
+
     return 0;
 }
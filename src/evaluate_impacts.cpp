@@ -0,0 +1,157 @@
+#include <iostream>
+#include <unordered_set>
+
+#include <succinct/mapper.hpp>
+
+#include "impacts.hpp"
+#include "index_types.hpp"
+#include "queries.hpp"
+#include "util.hpp"
+#include "wand_data.hpp"
+
+// Reports the error introduced by quantized impacts for one operator: the
+// top-k of ImpactQuery on an index built with --impacts is compared with
+// the top-k of ExactQuery on the same index built with frequencies.
+template <typename IndexType, typename ExactQuery, typename ImpactQuery>
+void evaluate_operator(IndexType const& index, IndexType const& impact_index,
+                       ExactQuery exact_q, ImpactQuery impact_q,
+                       ds2i::impact_quantizer<> const& quantizer,
+                       std::vector<ds2i::term_id_vec> const& queries,
+                       std::string const& type, std::string const& query_type,
+                       uint64_t k) {
+    using namespace ds2i;
+
+    double overlap = 0;
+    double score_error = 0;
+    double max_score_error = 0;
+    size_t num_scores = 0;
+    size_t evaluated_queries = 0;
+    for (auto const& query : queries) {
+        exact_q(index, query);
+        impact_q(impact_index, query);
+        auto const& exact = exact_q.topk();
+        auto const& approx = impact_q.topk();
+        if (exact.empty()) continue;
+
+        std::unordered_set<uint64_t> exact_docs;
+        for (auto const& entry : exact) exact_docs.insert(entry.second);
+        size_t common = 0;
+        for (auto const& entry : approx) {
+            common += exact_docs.count(entry.second);
+        }
+        overlap += double(common) / exact.size();
+
+        // relative error of the (dequantized) score at each rank
+        for (size_t i = 0; i < std::min(exact.size(), approx.size()); ++i) {
+            double error =
+                std::abs(quantizer.dequantize(approx[i].first) -
+                         exact[i].first) /
+                exact[i].first;
+            score_error += error;
+            max_score_error = std::max(max_score_error, error);
+            ++num_scores;
+        }
+        ++evaluated_queries;
+    }
+
+    if (!evaluated_queries) {
+        logger() << "ERROR: no query has results for " << query_type
+                 << ", nothing to compare" << std::endl;
+        return;
+    }
+
+    stats_line()("type", type)("query", query_type)(
+        "impact_bits", quantizer.bits())("k", k)(
+        "queries", evaluated_queries)(
+        "avg_overlap", overlap / evaluated_queries)(
+        "avg_relative_score_error", num_scores ? score_error / num_scores : 0)(
+        "max_relative_score_error", max_score_error);
+}
+
+// Each operator over impacts is compared with the same operator, or with an
+// exhaustive one, over frequencies.
+template <typename IndexType>
+void evaluate(const char* index_filename, const char* impact_index_filename,
+              const char* wand_data_filename, uint32_t bits, uint64_t k,
+              std::vector<ds2i::term_id_vec> const& queries,
+              std::string const& type) {
+    using namespace ds2i;
+
+    IndexType index;
+    boost::iostreams::mapped_file_source m(index_filename);
+    succinct::mapper::map(index, m);
+
+    IndexType impact_index;
+    boost::iostreams::mapped_file_source mi(impact_index_filename);
+    succinct::mapper::map(impact_index, mi);
+
+    wand_data<> wdata;
+    boost::iostreams::mapped_file_source md(wand_data_filename);
+    succinct::mapper::map(wdata, md);
+
+    impact_quantizer<> quantizer(index.num_docs(), bits);
+
+    evaluate_operator(index, impact_index, ranked_or_query(wdata, k),
+                      ranked_or_impact_query(k), quantizer, queries, type,
+                      "ranked_or_impact", k);
+    evaluate_operator(index, impact_index, wand_query(wdata, k),
+                      wand_impact_query(wdata, quantizer, k), quantizer,
+                      queries, type, "wand_impact", k);
+    evaluate_operator(index, impact_index, maxscore_query(wdata, k),
+                      maxscore_impact_query(wdata, quantizer, k), quantizer,
+                      queries, type, "maxscore_impact", k);
+    evaluate_operator(index, impact_index, block_max_wand_query(wdata, k),
+                      block_max_wand_impact_query(wdata, quantizer, k),
+                      quantizer, queries, type, "bmw_impact", k);
+    evaluate_operator(index, impact_index, block_max_maxscore_query(wdata, k),
+                      block_max_maxscore_impact_query(wdata, quantizer, k),
+                      quantizer, queries, type, "bmm_impact", k);
+    evaluate_operator(index, impact_index, ranked_and_query(wdata, k),
+                      block_max_ranked_and_impact_query(wdata, quantizer, k),
+                      quantizer, queries, type, "bma_impact", k);
+}
+
+int main(int argc, const char** argv) {
+    using namespace ds2i;
+
+    int mandatory = 6;
+    if (argc < mandatory) {
+        std::cerr << argv[0]
+                  << " <index_type> <index_filename> <impact_index_filename> "
+                     "<wand_filename> <impact_bits> [k] < query_log"
+                  << std::endl;
+        return 1;
+    }
+
+    std::string type = argv[1];
+    const char* index_filename = argv[2];
+    const char* impact_index_filename = argv[3];
+    const char* wand_data_filename = argv[4];
+    uint32_t bits = std::stoul(argv[5]);
+    uint64_t k = 10;
+    if (argc > mandatory) {
+        k = std::stoull(argv[mandatory]);
+    }
+
+    std::vector<term_id_vec> queries;
+    term_id_vec q;
+    while (read_query(q)) queries.push_back(q);
+
+    if (false) {
+#define LOOP_BODY(R, DATA, T)                                               \
+    }                                                                       \
+    else if (type == BOOST_PP_STRINGIZE(T)) {                               \
+        evaluate<BOOST_PP_CAT(T, _index)>(index_filename,                   \
+                                          impact_index_filename,            \
+                                          wand_data_filename, bits, k,      \
+                                          queries, type);                   \
+        /**/
+
+        BOOST_PP_SEQ_FOR_EACH(LOOP_BODY, _, DS2I_INDEX_TYPES);
+#undef LOOP_BODY
+    } else {
+        logger() << "ERROR: Unknown type " << type << std::endl;
+    }
+
+    return 0;
+}
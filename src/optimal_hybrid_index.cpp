@@ -0,0 +1,297 @@
+#include <fstream>
+#include <iostream>
+#include <unordered_map>
+
+#include <succinct/mapper.hpp>
+
+#include "index_build_utils.hpp"
+#include "index_types.hpp"
+#include "mixed_block.hpp"
+#include "util.hpp"
+
+typedef ds2i::mixed_block::space_time_point point_type;
+
+// The points on the lower convex hull of the space/time tradeoffs of a
+// block, by increasing space and decreasing time: only these can minimize
+// space + lambda * time for some lambda.
+std::vector<point_type> lower_hull(std::vector<point_type> points) {
+    std::sort(points.begin(), points.end());
+    std::vector<point_type> hull;
+    for (auto const& p : points) {
+        if (!hull.empty() && p.time >= hull.back().time) continue;
+        while (hull.size() >= 2) {
+            auto const& a = hull[hull.size() - 2];
+            auto const& b = hull.back();
+            // drop b if it is not below the segment from a to p
+            if (double(b.time - a.time) * (p.space - a.space) <
+                double(p.time - a.time) * (b.space - a.space)) {
+                break;
+            }
+            hull.pop_back();
+        }
+        hull.push_back(p);
+    }
+    return hull;
+}
+
+// The options of the docs and freqs blocks of all the lists, in order, each
+// one as the range of its hull in points
+struct block_options {
+    std::vector<point_type> points;
+    std::vector<uint64_t> ends;
+
+    size_t blocks() const {
+        return ends.size();
+    }
+
+    point_type const& best(size_t block, double lambda) const {
+        size_t begin = block ? ends[block - 1] : 0;
+        size_t best = begin;
+        for (size_t i = begin + 1; i < ends[block]; ++i) {
+            if (points[i].space + lambda * points[i].time <
+                points[best].space + lambda * points[best].time) {
+                best = i;
+            }
+        }
+        return points[best];
+    }
+
+    // total space in bytes and predicted time in nanoseconds of the
+    // choices for lambda
+    std::pair<uint64_t, double> evaluate(double lambda) const {
+        uint64_t space = 0;
+        double time = 0;
+        for (size_t block = 0; block < blocks(); ++block) {
+            auto const& p = best(block, lambda);
+            space += p.space;
+            time += p.time;
+        }
+        return std::make_pair(space, time);
+    }
+};
+
+enum class budget_type { lambda, space, time };
+
+// The lambda of the smallest index within a time budget, or of the fastest
+// one within a space budget: the time of the choices does not increase with
+// lambda, while their space does not decrease.
+double find_lambda(block_options const& options, budget_type type,
+                   double budget) {
+    using namespace ds2i;
+
+    if (type == budget_type::lambda) return budget;
+
+    auto within_budget = [&](double lambda) {
+        auto st = options.evaluate(lambda);
+        return type == budget_type::space ? st.first <= budget
+                                          : st.second <= budget;
+    };
+    static const double max_lambda = 1e30;
+
+    if (type == budget_type::time) {
+        if (within_budget(0)) return 0;
+        double hi = 1;
+        while (!within_budget(hi)) {
+            if (hi > max_lambda) {
+                logger() << "WARNING: time budget not attainable, "
+                         << "using the fastest blocks" << std::endl;
+                return hi;
+            }
+            hi *= 2;
+        }
+        double lo = hi / 2;
+        for (size_t i = 0; i < 64; ++i) {
+            double mid = (lo + hi) / 2;
+            (within_budget(mid) ? hi : lo) = mid;
+        }
+        return hi;
+    } else {
+        if (!within_budget(0)) {
+            logger() << "WARNING: space budget not attainable, "
+                     << "using the smallest blocks" << std::endl;
+            return 0;
+        }
+        double lo = 1;
+        while (within_budget(lo)) {
+            if (lo > max_lambda) return lo;
+            lo *= 2;
+        }
+        double hi = lo;
+        lo /= 2;
+        if (!within_budget(lo)) lo = 0;
+        for (size_t i = 0; i < 64; ++i) {
+            double mid = (lo + hi) / 2;
+            (within_budget(mid) ? lo : hi) = mid;
+        }
+        return lo;
+    }
+}
+
+// Transcodes each block of a block index to the mixed_block type and
+// parameter that minimizes space + lambda * predicted time, where the
+// predicted time is weighted with the number of times the block was
+// decoded in the profile.
+template <typename IndexType>
+void optimal_hybrid_index(const char* predictors_filename,
+                          const char* block_stats_filename,
+                          const char* input_filename, budget_type type,
+                          double budget, const char* output_filename) {
+    using namespace ds2i;
+    static_assert(
+        IndexType::block_codec_type::block_size == mixed_block::block_size,
+        "The blocks must have the size of mixed_block ones");
+
+    auto predictors = load_predictors(predictors_filename);
+
+    IndexType input;
+    logger() << "Loading index from " << input_filename << std::endl;
+    boost::iostreams::mapped_file_source m(input_filename);
+    succinct::mapper::map(input, m);
+
+    logger() << "Loading block stats from " << block_stats_filename
+             << std::endl;
+    std::unordered_map<uint32_t, std::vector<uint32_t>> block_counts;
+    {
+        std::ifstream fin(block_stats_filename);
+        uint32_t list_id;
+        std::vector<uint32_t> counts;
+        while (time_prediction::read_block_stats(fin, list_id, counts)) {
+            block_counts[list_id] = counts;
+        }
+    }
+
+    block_options options;
+    std::vector<uint32_t> values;
+    {
+        progress_logger plog("Computed space/time tradeoffs of");
+        for (size_t l = 0; l < input.size(); ++l) {
+            auto e = input[l];
+            auto it = block_counts.find(l);
+            std::vector<uint32_t> const* counts =
+                it == block_counts.end() ? nullptr : &it->second;
+            auto blocks = e.get_blocks();
+            if (counts && counts->size() != 2 * blocks.size()) {
+                throw std::invalid_argument(
+                    "Block stats do not match the index");
+            }
+            for (auto const& block : blocks) {
+                for (size_t freqs = 0; freqs < 2; ++freqs) {
+                    uint32_t sum_of_values = uint32_t(-1);
+                    if (freqs) {
+                        block.decode_freqs(values);
+                    } else {
+                        block.decode_doc_gaps(values);
+                        sum_of_values = block.doc_gaps_universe;
+                    }
+                    uint32_t access_count =
+                        counts ? (*counts)[2 * block.index + freqs] : 0;
+                    auto hull = lower_hull(mixed_block::compute_space_time(
+                        values, sum_of_values, predictors, access_count));
+                    options.points.insert(options.points.end(), hull.begin(),
+                                          hull.end());
+                    options.ends.push_back(options.points.size());
+                }
+            }
+            plog.done_sequence(e.size());
+        }
+        plog.log();
+    }
+
+    double lambda = find_lambda(options, type, budget);
+    auto space_time = options.evaluate(lambda);
+    logger() << "lambda " << lambda << ": " << space_time.first
+             << " bytes of blocks, predicted time " << space_time.second
+             << " nsecs" << std::endl;
+
+    block_freq_index<mixed_block>::builder builder(input.num_docs(),
+                                                   global_parameters());
+    typedef typename IndexType::document_enumerator::block_data block_data;
+    typedef mixed_block::block_transformer<block_data> transformer_type;
+    std::vector<uint64_t> docs_types(mixed_block::block_types),
+        freqs_types(mixed_block::block_types);
+    uint64_t postings = 0;
+    {
+        progress_logger plog("Transcoded");
+        std::vector<transformer_type> transformed;
+        size_t option = 0;
+        for (size_t l = 0; l < input.size(); ++l) {
+            auto e = input[l];
+            transformed.clear();
+            for (auto const& block : e.get_blocks()) {
+                auto const& docs = options.best(option++, lambda);
+                auto const& freqs = options.best(option++, lambda);
+                docs_types[(size_t)docs.type] += 1;
+                freqs_types[(size_t)freqs.type] += 1;
+                transformed.emplace_back(block, docs.type, freqs.type,
+                                         docs.param, freqs.param);
+            }
+            builder.add_posting_list(e.size(), transformed);
+            postings += e.size();
+            plog.done_sequence(e.size());
+        }
+        plog.log();
+    }
+
+    block_freq_index<mixed_block> coll;
+    builder.build(coll);
+    dump_stats(coll, "mixed", postings);
+    stats_line()("lambda", lambda)("blocks_bytes", space_time.first)(
+        "predicted_nsecs", space_time.second)("docs_block_types", docs_types)(
+        "freqs_block_types", freqs_types);
+
+    logger() << "Saving index to " << output_filename << std::endl;
+    succinct::mapper::freeze(coll, output_filename);
+}
+
+int main(int argc, const char** argv) {
+    using namespace ds2i;
+
+    if (argc < 8) {
+        std::cerr << argv[0]
+                  << " <index_type> <predictors_filename> "
+                     "<block_stats_filename> <input_index_filename> "
+                     "<output_filename> --space <bytes> | --time <nsecs> | "
+                     "--lambda <lambda>"
+                  << std::endl;
+        return 1;
+    }
+
+    std::string index_type = argv[1];
+    const char* predictors_filename = argv[2];
+    const char* block_stats_filename = argv[3];
+    const char* input_filename = argv[4];
+    const char* output_filename = argv[5];
+    std::string budget_arg = argv[6];
+    double budget = std::stod(argv[7]);
+
+    budget_type type;
+    if (budget_arg == "--space") {
+        type = budget_type::space;
+    } else if (budget_arg == "--time") {
+        type = budget_type::time;
+    } else if (budget_arg == "--lambda") {
+        type = budget_type::lambda;
+    } else {
+        throw std::invalid_argument("Unknown budget " + budget_arg);
+    }
+
+    if (false) {
+#define LOOP_BODY(R, DATA, T)                                                \
+    }                                                                        \
+    else if (index_type == BOOST_PP_STRINGIZE(T)) {                          \
+        optimal_hybrid_index<BOOST_PP_CAT(T, _index)>(                       \
+            predictors_filename, block_stats_filename, input_filename, type, \
+            budget, output_filename);                                        \
+        /**/
+
+        BOOST_PP_SEQ_FOR_EACH(LOOP_BODY, _, DS2I_BLOCK_INDEX_TYPES);
+#undef LOOP_BODY
+    } else if (!with_paired_index_type(index_type, [&](auto tag) {
+                   optimal_hybrid_index<typename decltype(tag)::type>(
+                       predictors_filename, block_stats_filename,
+                       input_filename, type, budget, output_filename);
+               })) {
+        logger() << "ERROR: Unknown or non-block type " << index_type
+                 << std::endl;
+    }
+}
@@ -0,0 +1,141 @@
+#include <iostream>
+#include <random>
+
+#include <succinct/mapper.hpp>
+
+#include "index_build_utils.hpp"
+#include "index_types.hpp"
+#include "mixed_block.hpp"
+#include "util.hpp"
+
+// nanoseconds taken by mixed_block to decode the block, averaged on a few
+// runs after a warm-up one
+double decode_nsecs(std::vector<uint8_t> const& block, uint32_t sum_of_values,
+                    size_t n, std::vector<uint32_t>& out) {
+    static const size_t runs = 100;
+    ds2i::mixed_block::decode(block.data(), out.data(), sum_of_values, n);
+    auto tick = ds2i::get_time_usecs();
+    for (size_t run = 0; run < runs; ++run) {
+        ds2i::mixed_block::decode(block.data(), out.data(), sum_of_values, n);
+        ds2i::do_not_optimize_away(out[0]);
+    }
+    return (ds2i::get_time_usecs() - tick) * 1000 / runs;
+}
+
+// Encodes the full blocks of a sample of the lists with every block type
+// and parameter of mixed_block, measures their decoding time and fits to
+// the times the predictors used by optimal_hybrid_index.
+template <typename IndexType>
+void profile_decoding(const char* index_filename, double p,
+                      const char* predictors_filename) {
+    using namespace ds2i;
+    using namespace ds2i::time_prediction;
+    static_assert(
+        IndexType::block_codec_type::block_size == mixed_block::block_size,
+        "The blocks must have the size of mixed_block ones");
+
+    IndexType index;
+    logger() << "Loading index from " << index_filename << std::endl;
+    boost::iostreams::mapped_file_source m(index_filename);
+    succinct::mapper::map(index, m);
+
+    std::vector<std::vector<feature_vector>> samples(mixed_block::block_types);
+    std::vector<std::vector<double>> times(mixed_block::block_types);
+
+    std::mt19937 rng(1729);
+    std::bernoulli_distribution sample(p);
+    std::vector<uint32_t> values;
+    std::vector<uint32_t> out(mixed_block::block_size +
+                              mixed_block::overflow);
+    std::vector<uint8_t> buf;
+    progress_logger plog("Profiled");
+    for (size_t l = 0; l < index.size(); ++l) {
+        if (!sample(rng)) continue;
+        auto e = index[l];
+        for (auto const& block : e.get_blocks()) {
+            if (block.size != mixed_block::block_size) continue;
+            for (bool docs : {true, false}) {
+                uint32_t sum_of_values = uint32_t(-1);
+                if (docs) {
+                    block.decode_doc_gaps(values);
+                    sum_of_values = block.doc_gaps_universe;
+                } else {
+                    block.decode_freqs(values);
+                }
+
+                feature_vector fv;
+                values_statistics(values, fv);
+                for (uint8_t t = 0; t < mixed_block::block_types; ++t) {
+                    auto type = (mixed_block::block_type)t;
+                    for (mixed_block::compr_param_type param = 0;
+                         param < mixed_block::compr_params(type); ++param) {
+                        buf.clear();
+                        if (!mixed_block::compression_stats(
+                                type, param, values.data(), sum_of_values,
+                                values.size(), buf, fv)) {
+                            continue;
+                        }
+                        samples[t].push_back(fv);
+                        times[t].push_back(decode_nsecs(buf, sum_of_values,
+                                                        values.size(), out));
+                    }
+                }
+            }
+        }
+        plog.done_sequence(e.size());
+    }
+    plog.log();
+
+    predictors_vec_type predictors(mixed_block::block_types);
+    for (size_t t = 0; t < mixed_block::block_types; ++t) {
+        predictors[t] = fit_predictor(samples[t], times[t]);
+
+        double total_time = 0, total_error = 0;
+        for (size_t i = 0; i < samples[t].size(); ++i) {
+            total_time += times[t][i];
+            total_error +=
+                std::abs(predictors[t](samples[t][i]) - times[t][i]);
+        }
+        size_t count = std::max(samples[t].size(), size_t(1));
+        stats_line()("block_type", t)("samples", samples[t].size())(
+            "avg_nsecs", total_time / count)("avg_abs_error",
+                                              total_error / count);
+    }
+
+    logger() << "Saving predictors to " << predictors_filename << std::endl;
+    save_predictors(predictors_filename, predictors);
+}
+
+int main(int argc, const char** argv) {
+    using namespace ds2i;
+
+    if (argc < 5) {
+        std::cerr << argv[0]
+                  << " <index_type> <index_filename> <sample_probability> "
+                     "<predictors_filename>"
+                  << std::endl;
+        return 1;
+    }
+
+    std::string type = argv[1];
+    const char* index_filename = argv[2];
+    double p = std::stod(argv[3]);
+    const char* predictors_filename = argv[4];
+
+    if (false) {
+#define LOOP_BODY(R, DATA, T)                                            \
+    }                                                                    \
+    else if (type == BOOST_PP_STRINGIZE(T)) {                            \
+        profile_decoding<BOOST_PP_CAT(T, _index)>(index_filename, p,     \
+                                                  predictors_filename);  \
+        /**/
+
+        BOOST_PP_SEQ_FOR_EACH(LOOP_BODY, _, DS2I_BLOCK_INDEX_TYPES);
+#undef LOOP_BODY
+    } else if (!with_paired_index_type(type, [&](auto tag) {
+                   profile_decoding<typename decltype(tag)::type>(
+                       index_filename, p, predictors_filename);
+               })) {
+        logger() << "ERROR: Unknown or non-block type " << type << std::endl;
+    }
+}
@@ -0,0 +1,121 @@
+#include <iostream>
+
+#include <boost/algorithm/string/classification.hpp>
+#include <boost/algorithm/string/split.hpp>
+
+#include <succinct/mapper.hpp>
+
+#include "index_types.hpp"
+#include "queries.hpp"
+#include "wand_data.hpp"
+#include "util.hpp"
+
+template <typename QueryOperator, typename IndexType>
+void op_profile(IndexType const& index, QueryOperator const& query_op,
+                std::vector<ds2i::term_id_vec> const& queries) {
+    using namespace ds2i;
+
+    QueryOperator op(query_op);
+    for (auto const& query : queries) {
+        do_not_optimize_away(op(index, query));
+    }
+}
+
+// Runs each query once on the index opened with block profiling, so that
+// the blocks decoded by the query operators are counted.
+template <typename IndexType>
+void profile(const char* index_filename, const char* wand_data_filename,
+             std::vector<ds2i::term_id_vec> const& queries,
+             std::string const& query_type) {
+    using namespace ds2i;
+
+    typedef block_freq_index<typename IndexType::block_codec_type, true>
+        profiled_index_type;
+    profiled_index_type index;
+    logger() << "Loading index from " << index_filename << std::endl;
+    boost::iostreams::mapped_file_source m(index_filename);
+    succinct::mapper::map(index, m);
+
+    wand_data<> wdata;
+    boost::iostreams::mapped_file_source md;
+    if (wand_data_filename) {
+        md.open(wand_data_filename);
+        succinct::mapper::map(wdata, md, succinct::mapper::map_flags::warmup);
+    }
+
+    std::vector<std::string> query_types;
+    boost::algorithm::split(query_types, query_type, boost::is_any_of(":"));
+
+    for (auto const& t : query_types) {
+        logger() << "Profiling " << t << " queries" << std::endl;
+        if (t == "and") {
+            op_profile(index, and_query<false>(), queries);
+        } else if (t == "and_freq") {
+            op_profile(index, and_query<true>(), queries);
+        } else if (t == "or") {
+            op_profile(index, or_query<false>(), queries);
+        } else if (t == "or_freq") {
+            op_profile(index, or_query<true>(), queries);
+        } else if (t == "wand" && wand_data_filename) {
+            op_profile(index, wand_query(wdata, 10), queries);
+        } else if (t == "bmw" && wand_data_filename) {
+            op_profile(index, block_max_wand_query(wdata, 10), queries);
+        } else if (t == "ranked_and" && wand_data_filename) {
+            op_profile(index, ranked_and_query(wdata, 10), queries);
+        } else if (t == "bma" && wand_data_filename) {
+            op_profile(index, block_max_ranked_and_query(wdata, 10), queries);
+        } else if (t == "ranked_or" && wand_data_filename) {
+            op_profile(index, ranked_or_query(wdata, 10), queries);
+        } else if (t == "maxscore" && wand_data_filename) {
+            op_profile(index, maxscore_query(wdata, 10), queries);
+        } else if (t == "bmm" && wand_data_filename) {
+            op_profile(index, block_max_maxscore_query(wdata, 10), queries);
+        } else {
+            logger() << "Unsupported query type: " << t << std::endl;
+        }
+    }
+
+    // one line per list that was opened, with the docs and freqs decode
+    // counts of each block, as read by time_prediction::read_block_stats
+    block_profiler::dump(std::cout);
+}
+
+int main(int argc, const char** argv) {
+    using namespace ds2i;
+
+    if (argc < 4) {
+        std::cerr << argv[0]
+                  << " <index_type> <query_type> <index_filename> "
+                     "[wand_filename] < query_log > block_stats"
+                  << std::endl;
+        return 1;
+    }
+
+    std::string type = argv[1];
+    std::string query_type = argv[2];
+    const char* index_filename = argv[3];
+    const char* wand_data_filename = argc > 4 ? argv[4] : nullptr;
+
+    std::vector<term_id_vec> queries;
+    term_id_vec q;
+    while (read_query(q)) queries.push_back(q);
+
+    if (false) {
+#define LOOP_BODY(R, DATA, T)                                            \
+    }                                                                    \
+    else if (type == BOOST_PP_STRINGIZE(T)) {                            \
+        profile<BOOST_PP_CAT(T, _index)>(index_filename,                 \
+                                         wand_data_filename, queries,    \
+                                         query_type);                    \
+        /**/
+
+        BOOST_PP_SEQ_FOR_EACH(LOOP_BODY, _, DS2I_BLOCK_INDEX_TYPES);
+#undef LOOP_BODY
+    } else if (!with_paired_index_type(type, [&](auto tag) {
+                   profile<typename decltype(tag)::type>(
+                       index_filename, wand_data_filename, queries,
+                       query_type);
+               })) {
+        logger() << "ERROR: Unknown or non-block type " << type << std::endl;
+    }
+}
@@ -1,33 +1,69 @@
+#include <algorithm>
+#include <atomic>
+#include <fstream>
 #include <iostream>
+#include <memory>
+#include <thread>
 
 #include <boost/algorithm/string/classification.hpp>
 #include <boost/algorithm/string/split.hpp>
 
 #include <succinct/mapper.hpp>
 
+#include "configuration.hpp"
+#include "impacts.hpp"
 #include "index_types.hpp"
 #include "wand_data.hpp"
+#include "pair_index.hpp"
 #include "queries.hpp"
+#include "query_cache.hpp"
 #include "util.hpp"
 
 const size_t runs = 10 + 1;
 
+typedef std::pair<size_t, double> query_time;  // query id, musec
+
+// Raw per-query times, as <query_type> <threads> <query_id> <musec> lines.
+void dump_query_times(std::ostream& os, std::string const& query_type,
+                      size_t threads, std::vector<query_time> const& times) {
+    for (auto const& t : times) {
+        os << query_type << '\t' << threads << '\t' << t.first << '\t'
+           << t.second << '\n';
+    }
+}
+
+std::vector<double> latencies(std::vector<query_time> const& times) {
+    std::vector<double> musecs;
+    musecs.reserve(times.size());
+    for (auto const& t : times) musecs.push_back(t.second);
+    return musecs;
+}
+
 template <typename QueryOperator, typename IndexType>
 void op_perftest(IndexType const& index,
                  QueryOperator&& query_op,  // XXX!!!
                  std::vector<ds2i::term_id_vec> const& queries,
                  std::string const& index_type, std::string const& query_type,
-                 size_t runs) {
+                 size_t runs, ds2i::query_cache* cache = nullptr,
+                 std::ostream* times_out = nullptr) {
     using namespace ds2i;
 
     std::vector<double> query_times;
+    std::vector<query_time> times;
+    times.reserve(queries.size() * (runs - 1));
     size_t total = 0;
     for (size_t run = 0; run != runs; ++run) {
+        if (cache) cache->clear();  // every run starts from a cold cache
         auto tick = get_time_usecs();
-        for (auto const& query : queries) {
-            uint64_t results = query_op(index, query);
+        for (size_t i = 0; i != queries.size(); ++i) {
+            auto query_tick = get_time_usecs();
+            uint64_t results = query_op(index, queries[i]);
+            double elapsed = get_time_usecs() - query_tick;
             // do_not_optimize_away(results);
             total += results;
+            if (run != 0) {
+                times.emplace_back(i, elapsed);
+            }
         }
         double elapsed = double(get_time_usecs() - tick);
         if (run != 0) {  // first run is not timed
@@ -40,14 +76,185 @@ void op_perftest(IndexType const& index,
     double avg_per_run =
         std::accumulate(query_times.begin(), query_times.end(), double(0.0)) /
         query_times.size();
-    stats_line()("type", index_type)("query", query_type)(
-        "avg_musec_per_query", avg_per_run / queries.size());
+    {
+        stats_line sl;
+        sl("type", index_type)("query", query_type)(
+            "avg_musec_per_query", avg_per_run / queries.size())(
+            latency_distribution(latencies(times)));
+        if (cache) sl(*cache);
+    }
+
+    if (times_out) dump_query_times(*times_out, query_type, 1, times);
+}
+
+// Throughput mode: the query log is replayed (runs - 1) times by a pool of
+// workers sharing the index, each with its own copy of the operator (and
+// thus of its top-k queue). Queries are handed out through a shared counter.
+// The thread counts are run in increasing order, always starting from 1,
+// which is the baseline of the scaling efficiency.
+template <typename QueryOperator, typename IndexType>
+void op_throughput_test(IndexType const& index, QueryOperator const& query_op,
+                        std::vector<ds2i::term_id_vec> const& queries,
+                        std::string const& index_type,
+                        std::string const& query_type,
+                        std::vector<size_t> num_threads, size_t runs,
+                        ds2i::query_cache* cache = nullptr,
+                        std::ostream* times_out = nullptr) {
+    using namespace ds2i;
+
+    {  // first run is not timed
+        QueryOperator op(query_op);
+        for (auto const& query : queries) {
+            do_not_optimize_away(op(index, query));
+        }
+    }
+
+    std::sort(num_threads.begin(), num_threads.end());
+    num_threads.erase(std::unique(num_threads.begin(), num_threads.end()),
+                      num_threads.end());
+    if (num_threads.front() != 1) num_threads.insert(num_threads.begin(), 1);
+
+    size_t total_queries = queries.size() * (runs - 1);
+    double base_qps_per_thread = 0;
+    for (auto threads : num_threads) {
+        if (cache) cache->clear();
+        std::atomic<size_t> next_query(0);
+        std::vector<double> thread_usecs(threads, 0);
+        std::vector<size_t> thread_queries(threads, 0);
+        std::vector<uint64_t> thread_results(threads, 0);
+        // a worker may end up running all the queries; reserving here
+        // keeps the allocations out of the timed loop
+        std::vector<std::vector<query_time>> thread_times(threads);
+        for (auto& t : thread_times) t.reserve(total_queries);
+
+        std::vector<std::thread> workers;
+        auto tick = get_time_usecs();
+        for (size_t i = 0; i != threads; ++i) {
+            workers.emplace_back([&, i]() {
+                QueryOperator op(query_op);
+                double usecs = 0;
+                size_t processed = 0;
+                uint64_t results = 0;
+                auto& times = thread_times[i];
+                size_t q;
+                while ((q = next_query++) < total_queries) {
+                    auto query_tick = get_time_usecs();
+                    results += op(index, queries[q % queries.size()]);
+                    double elapsed = get_time_usecs() - query_tick;
+                    usecs += elapsed;
+                    times.emplace_back(q % queries.size(), elapsed);
+                    ++processed;
+                }
+                thread_usecs[i] = usecs;
+                thread_queries[i] = processed;
+                thread_results[i] = results;
+            });
+        }
+        for (auto& w : workers) w.join();
+        double elapsed = double(get_time_usecs() - tick);
+
+        std::cout << std::accumulate(thread_results.begin(),
+                                     thread_results.end(), uint64_t(0))
+                  << std::endl;
+
+        std::vector<double> thread_avg_musec(threads, 0);
+        for (size_t i = 0; i != threads; ++i) {
+            if (thread_queries[i]) {
+                thread_avg_musec[i] = thread_usecs[i] / thread_queries[i];
+            }
+        }
+        double avg_musec =
+            std::accumulate(thread_usecs.begin(), thread_usecs.end(),
+                            double(0.0)) /
+            total_queries;
+        double qps = total_queries / (elapsed / 1000000);
+        if (!base_qps_per_thread) {
+            base_qps_per_thread = qps / threads;
+        }
+
+        std::vector<query_time> times;
+        times.reserve(total_queries);
+        for (auto const& t : thread_times) {
+            times.insert(times.end(), t.begin(), t.end());
+        }
+
+        {
+            stats_line sl;
+            sl("type", index_type)("query", query_type)("threads", threads)(
+                "queries_per_sec", qps)("avg_musec_per_query", avg_musec)(
+                latency_distribution(latencies(times)))(
+                "thread_avg_musec_per_query", thread_avg_musec)(
+                "scaling_efficiency", qps / (threads * base_qps_per_thread));
+            if (cache) sl(*cache);
+        }
+
+        if (times_out) dump_query_times(*times_out, query_type, threads, times);
+    }
+}
+
+struct perftest_options {
+    perftest_options()
+        : impact_bits(0)
+        , pairs_filename(nullptr)
+        , times_out(nullptr)
+        , use_cache(false)
+        , cache_policy(ds2i::query_cache::policy_type::lru)
+        , cache_bytes(0) {}
+
+    std::vector<size_t> num_threads;  // throughput mode, if not empty
+    uint32_t impact_bits;
+    const char* pairs_filename;
+    std::ostream* times_out;  // raw per-query times, if not null
+    bool use_cache;
+    ds2i::query_cache::policy_type cache_policy;
+    uint64_t cache_bytes;
+    // the static part of static_dynamic is trained on a separate log, or
+    // all its hits on the replayed queries would be guaranteed
+    std::vector<ds2i::term_id_vec> cache_training;
+};
+
+template <typename QueryOperator, typename IndexType>
+void op_test(IndexType const& index, QueryOperator const& query_op,
+             std::vector<ds2i::term_id_vec> const& queries,
+             std::string const& index_type, std::string const& query_type,
+             perftest_options const& options, ds2i::query_cache* cache) {
+    if (options.num_threads.empty()) {
+        QueryOperator op(query_op);
+        op_perftest(index, op, queries, index_type, query_type, runs, cache,
+                    options.times_out);
+    } else {
+        op_throughput_test(index, query_op, queries, index_type, query_type,
+                           options.num_threads, runs, cache,
+                           options.times_out);
+    }
+}
+
+template <typename QueryOperator, typename IndexType>
+void op_test(IndexType const& index, QueryOperator const& query_op,
+             std::vector<ds2i::term_id_vec> const& queries,
+             std::string const& index_type, std::string const& query_type,
+             perftest_options const& options) {
+    using namespace ds2i;
+
+    if (!options.use_cache) {
+        op_test(index, query_op, queries, index_type, query_type, options,
+                nullptr);
+        return;
+    }
+
+    // results depend on the operator, so each one has its own cache
+    query_cache cache(options.cache_policy, options.cache_bytes);
+    cache.set_static_queries(options.cache_training,
+                             !ignores_duplicate_terms<QueryOperator>::value);
+    op_test(index, cached_query<QueryOperator>(query_op, cache), queries,
+            index_type, query_type, options, &cache);
 }
 
 template <typename IndexType>
 void perftest(const char* index_filename, const char* wand_data_filename,
               std::vector<ds2i::term_id_vec> const& queries,
-              std::string const& type, std::string const& query_type) {
+              std::string const& type, std::string const& query_type,
+              perftest_options const& options) {
     using namespace ds2i;
 
     IndexType index;
@@ -73,26 +280,98 @@ void perftest(const char* index_filename, const char* wand_data_filename,
         succinct::mapper::map(wdata, md, succinct::mapper::map_flags::warmup);
     }
 
+    std::unique_ptr<impact_quantizer<>> quantizer;
+    if (options.impact_bits) {
+        quantizer.reset(
+            new impact_quantizer<>(index.num_docs(), options.impact_bits));
+    }
+
+    typedef pair_index<IndexType> pair_index_type;
+    pair_index_type pairs;
+    boost::iostreams::mapped_file_source mp;
+    if (options.pairs_filename) {
+        mp.open(options.pairs_filename);
+        succinct::mapper::map(pairs, mp, succinct::mapper::map_flags::warmup);
+    }
+
     std::vector<std::string> query_types;
     boost::algorithm::split(query_types, query_type, boost::is_any_of(":"));
 
     for (auto const& t : query_types) {
         if (t == "and") {
-            op_perftest(index, and_query<false>(), queries, type, t, runs);
+            op_test(index, and_query<false>(), queries, type, t, options);
         } else if (t == "and_freq") {
-            op_perftest(index, and_query<true>(), queries, type, t, runs);
+            op_test(index, and_query<true>(), queries, type, t, options);
         } else if (t == "or") {
-            op_perftest(index, or_query<false>(), queries, type, t, runs);
+            op_test(index, or_query<false>(), queries, type, t, options);
         } else if (t == "or_freq") {
-            op_perftest(index, or_query<true>(), queries, type, t, runs);
+            op_test(index, or_query<true>(), queries, type, t, options);
         } else if (t == "wand" && wand_data_filename) {
-            op_perftest(index, wand_query(wdata, 10), queries, type, t, runs);
+            op_test(index, wand_query(wdata, 10), queries, type, t,
+                    options);
+        } else if (t == "bmw" && wand_data_filename) {
+            op_test(index, block_max_wand_query(wdata, 10), queries, type, t,
+                    options);
         } else if (t == "ranked_and" && wand_data_filename) {
-            op_perftest(index, ranked_and_query(wdata, 10), queries, type, t,
-                        runs);
+            op_test(index, ranked_and_query(wdata, 10), queries, type, t,
+                    options);
+        } else if (t == "bma" && wand_data_filename) {
+            op_test(index, block_max_ranked_and_query(wdata, 10), queries,
+                    type, t, options);
+        } else if (t == "pair_and" && options.pairs_filename) {
+            op_test(index, pair_and_query<pair_index_type, false>(pairs),
+                    queries, type, t, options);
+        } else if (t == "pair_ranked_and" && wand_data_filename &&
+                   options.pairs_filename) {
+            op_test(index,
+                    pair_ranked_and_query<pair_index_type>(pairs, wdata, 10),
+                    queries, type, t, options);
+        } else if (t == "ranked_or" && wand_data_filename) {
+            op_test(index, ranked_or_query(wdata, 10), queries, type, t,
+                    options);
+        } else if (t == "parallel_wand" && wand_data_filename) {
+            op_test(index,
+                    parallel_ranked_query<wand_query>(
+                        wand_query(wdata, 10), 10,
+                        configuration::get().worker_threads),
+                    queries, type, t, options);
+        } else if (t == "parallel_ranked_or" && wand_data_filename) {
+            op_test(index,
+                    parallel_ranked_query<ranked_or_query>(
+                        ranked_or_query(wdata, 10), 10,
+                        configuration::get().worker_threads),
+                    queries, type, t, options);
+        } else if (t == "ranked_or_impact" && options.impact_bits) {
+            op_test(index, ranked_or_impact_query(10), queries, type, t,
+                    options);
+        } else if (t == "wand_impact" && wand_data_filename &&
+                   options.impact_bits) {
+            op_test(index, wand_impact_query(wdata, *quantizer, 10), queries,
+                    type, t, options);
+        } else if (t == "maxscore_impact" && wand_data_filename &&
+                   options.impact_bits) {
+            op_test(index, maxscore_impact_query(wdata, *quantizer, 10),
+                    queries, type, t, options);
+        } else if (t == "bmw_impact" && wand_data_filename &&
+                   options.impact_bits) {
+            op_test(index, block_max_wand_impact_query(wdata, *quantizer, 10),
+                    queries, type, t, options);
+        } else if (t == "bma_impact" && wand_data_filename &&
+                   options.impact_bits) {
+            op_test(index,
+                    block_max_ranked_and_impact_query(wdata, *quantizer, 10),
+                    queries, type, t, options);
+        } else if (t == "bmm_impact" && wand_data_filename &&
+                   options.impact_bits) {
+            op_test(index,
+                    block_max_maxscore_impact_query(wdata, *quantizer, 10),
+                    queries, type, t, options);
         } else if (t == "maxscore" && wand_data_filename) {
-            op_perftest(index, maxscore_query(wdata, 10), queries, type, t,
-                        runs);
+            op_test(index, maxscore_query(wdata, 10), queries, type, t,
+                    options);
+        } else if (t == "bmm" && wand_data_filename) {
+            op_test(index, block_max_maxscore_query(wdata, 10), queries,
+                    type, t, options);
         } else {
             logger() << "Unsupported query type: " << t << std::endl;
         }
@@ -106,7 +385,10 @@ int main(int argc, const char** argv) {
     if (argc < mandatory) {
         std::cerr << argv[0]
                   << " <index_type> <query_type> <index_filename> "
-                     "[wand_filename] < query_log"
+                     "[wand_filename] [--threads <n1:n2:...>] "
+                     "[--impacts <bits>] [--pairs <pair_index_filename>] "
+                     "[--cache <policy>:<MiB>] [--cache-train <query_log>] "
+                     "[--dump-times <filename>] < query_log"
                   << std::endl;
         return 1;
     }
@@ -115,9 +397,59 @@ int main(int argc, const char** argv) {
     std::string query_type = argv[2];
     const char* index_filename = argv[3];
     const char* wand_data_filename = nullptr;
+    perftest_options options;
+    std::ofstream times_out;
 
-    if (argc > mandatory) {
-        wand_data_filename = argv[mandatory];
+    for (int i = mandatory; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--threads" && i + 1 < argc) {
+            std::vector<std::string> values;
+            std::string list = argv[++i];
+            boost::algorithm::split(values, list, boost::is_any_of(":"));
+            for (auto const& v : values) {
+                size_t threads = std::stoull(v);
+                if (!threads) {
+                    throw std::invalid_argument(
+                        "Number of threads must be positive");
+                }
+                options.num_threads.push_back(threads);
+            }
+        } else if (arg == "--impacts" && i + 1 < argc) {
+            options.impact_bits = std::stoul(argv[++i]);
+        } else if (arg == "--dump-times" && i + 1 < argc) {
+            times_out.open(argv[++i]);
+            options.times_out = &times_out;
+        } else if (arg == "--pairs" && i + 1 < argc) {
+            options.pairs_filename = argv[++i];
+        } else if (arg == "--cache" && i + 1 < argc) {
+            // <policy>:<MiB>
+            std::vector<std::string> values;
+            std::string spec = argv[++i];
+            boost::algorithm::split(values, spec, boost::is_any_of(":"));
+            if (values.size() != 2) {
+                throw std::invalid_argument("Cache must be <policy>:<MiB>");
+            }
+            options.use_cache = true;
+            options.cache_policy = query_cache::parse_policy(values[0]);
+            options.cache_bytes = std::stoull(values[1]) * constants::MiB;
+        } else if (arg == "--cache-train" && i + 1 < argc) {
+            options.cache_training = read_queries(argv[++i]);
+        } else if (arg.compare(0, 2, "--") == 0) {
+            // also a known option without its value
+            throw std::invalid_argument("Unknown option " + arg);
+        } else if (!wand_data_filename) {
+            wand_data_filename = argv[i];
+        } else {
+            throw std::invalid_argument("Unexpected argument " + arg);
+        }
+    }
+
+    if (options.use_cache &&
+        options.cache_policy == query_cache::policy_type::static_dynamic &&
+        options.cache_training.empty()) {
+        throw std::invalid_argument(
+            "The static_dynamic cache needs a training log other than the "
+            "replayed one: --cache-train <query_log>");
     }
 
     std::vector<term_id_vec> queries;
@@ -129,12 +461,17 @@ int main(int argc, const char** argv) {
     }                                                                         \
     else if (type == BOOST_PP_STRINGIZE(T)) {                                 \
         perftest<BOOST_PP_CAT(T, _index)>(index_filename, wand_data_filename, \
-                                          queries, type, query_type);         \
+                                          queries, type, query_type,          \
+                                          options);                           \
         /**/
 
         BOOST_PP_SEQ_FOR_EACH(LOOP_BODY, _, DS2I_INDEX_TYPES);
 #undef LOOP_BODY
-    } else {
+    } else if (!with_paired_index_type(type, [&](auto tag) {
+                   perftest<typename decltype(tag)::type>(
+                       index_filename, wand_data_filename, queries, type,
+                       query_type, options);
+               })) {
         logger() << "ERROR: Unknown type " << type << std::endl;
     }
 
@@ -2,6 +2,7 @@
 
 #include "succinct/test_common.hpp"
 #include "block_codecs.hpp"
+#include "mixed_block.hpp"
 #include <vector>
 #include <cstdlib>
 #include <random>
@@ -38,6 +39,18 @@ void test_block_codec() {
                 BOOST_REQUIRE_EQUAL_COLLECTIONS(
                     values.begin(), values.end(), decoded.begin(),
                     decoded.begin() + values.size());
+
+                // values as docid gaps
+                uint32_t base = uint32_t(mag * tcase);
+                out = ds2i::decode_prefix_sum<BlockCodec>(
+                    encoded.data(), decoded.data(), sum_of_values,
+                    values.size(), base);
+                BOOST_REQUIRE_EQUAL(encoded.size(), out - encoded.data());
+                for (size_t i = 0; i < values.size(); ++i) {
+                    base += values[i];
+                    BOOST_REQUIRE_EQUAL(base, decoded[i]);
+                    base += 1;
+                }
             }
         }
     }
@@ -50,4 +63,218 @@ BOOST_AUTO_TEST_CASE(block_codecs) {
     test_block_codec<ds2i::qmx_block>();
     test_block_codec<ds2i::vbyte_block>();
     test_block_codec<ds2i::simple16_block>();
+    test_block_codec<ds2i::simdbp128_block>();
+    test_block_codec<ds2i::simdfastpfor_block>();
+    test_block_codec<ds2i::bitmap_block>();
+}
+
+BOOST_AUTO_TEST_CASE(block_codecs_block_size) {
+    test_block_codec<ds2i::basic_optpfor_block<64>>();
+    test_block_codec<ds2i::basic_optpfor_block<256>>();
+    test_block_codec<ds2i::basic_optpfor_block<512>>();
+    test_block_codec<ds2i::basic_interpolative_block<512>>();
+    test_block_codec<ds2i::basic_qmx_block<64>>();
+    test_block_codec<ds2i::basic_qmx_block<512>>();
+}
+
+// Values encoded with BlockCodec must decode with TableCodec, which may be
+// BlockCodec itself for the codecs that read past the end of their blocks.
+// The codecs that fall back to interpolative_block on partial blocks need
+// values of at most MaxPartialBits bits there, so that they sum up to less
+// than 2^32.
+template <typename BlockCodec, typename TableCodec,
+          uint32_t MaxPartialBits = 32>
+void test_same_format() {
+    std::mt19937 gen(12345);
+    for (size_t size : {1, 7, 128}) {
+        for (uint32_t max_bits = 0; max_bits <= 32; ++max_bits) {
+            uint32_t size_bits = size < BlockCodec::block_size
+                                     ? std::min(max_bits, MaxPartialBits)
+                                     : max_bits;
+            // mostly small values, as in the table, with some long codes
+            std::vector<uint32_t> values(size);
+            std::generate(values.begin(), values.end(), [&]() {
+                uint64_t bits = gen() % (size_bits + 1);
+                return uint32_t(uint64_t(uint32_t(gen())) >> (32 - bits));
+            });
+            std::vector<uint8_t> encoded;
+            BlockCodec::encode(values.data(), uint32_t(-1), size, encoded);
+            size_t encoded_size = encoded.size();
+            // the bit readers load words past the end
+            encoded.resize(encoded_size + 16);
+            std::vector<uint32_t> decoded(size);
+            uint8_t const* out = TableCodec::decode(
+                encoded.data(), decoded.data(), uint32_t(-1), size);
+            BOOST_REQUIRE_EQUAL(encoded_size, out - encoded.data());
+            BOOST_REQUIRE_EQUAL_COLLECTIONS(values.begin(), values.end(),
+                                            decoded.begin(), decoded.end());
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(bytes_bit_writer) {
+    // the same bits as succinct::bit_vector_builder, after what is already
+    // in the output
+    std::mt19937 gen(12345);
+    std::vector<uint8_t> out = {42, 43, 44};
+    succinct::bit_vector_builder bvb;
+    ds2i::bytes_bit_writer bw(out);
+    for (size_t i = 0; i < 10000; ++i) {
+        size_t len = gen() % 65;
+        uint64_t bits = len ? uint64_t(gen()) << 32 | gen() : 0;
+        if (len && len < 64) bits &= (uint64_t(1) << len) - 1;
+        bvb.append_bits(bits, len);
+        bw.append_bits(bits, len);
+        ds2i::write_gamma(bvb, bits & 0xffff);
+        ds2i::write_gamma(bw, bits & 0xffff);
+    }
+    bw.flush();
+    BOOST_REQUIRE_EQUAL(bvb.size(), bw.size());
+    BOOST_REQUIRE_EQUAL(3 + succinct::util::ceil_div(bvb.size(), 8),
+                        out.size());
+    BOOST_REQUIRE_EQUAL(42, out[0]);
+    auto const& words = bvb.move_bits();
+    uint8_t const* bytes = reinterpret_cast<uint8_t const*>(words.data());
+    BOOST_REQUIRE_EQUAL_COLLECTIONS(bytes, bytes + out.size() - 3,
+                                    out.begin() + 3, out.end());
+}
+
+template <typename BlockCodec>
+void test_append() {
+    // the codecs encode in place at the end of the output, which must be
+    // the same as encoding into an empty one
+    std::mt19937 gen(12345);
+    std::vector<uint32_t> values(BlockCodec::block_size);
+    std::vector<uint8_t> out, block;
+    for (size_t b = 0; b < 16; ++b) {
+        std::generate(values.begin(), values.end(),
+                      [&]() { return uint32_t(gen() % (1 << b)); });
+        size_t begin = out.size();
+        BlockCodec::encode(values.data(), uint32_t(-1), values.size(), out);
+        block.clear();
+        BlockCodec::encode(values.data(), uint32_t(-1), values.size(),
+                           block);
+        BOOST_REQUIRE_EQUAL_COLLECTIONS(block.begin(), block.end(),
+                                        out.begin() + begin, out.end());
+    }
+}
+
+BOOST_AUTO_TEST_CASE(block_codecs_append) {
+    test_append<ds2i::vbyte_block>();
+    test_append<ds2i::streamvbyte_block>();
+    test_append<ds2i::maskedvbyte_block>();
+    test_append<ds2i::varintgb_block>();
+    test_append<ds2i::simple16_block>();
+    test_append<ds2i::simdfastpfor_block>();
+    test_append<ds2i::gamma_block>();
+    test_append<ds2i::delta_table_block>();
+    test_append<ds2i::rice_block>();
+    test_append<ds2i::zeta_block>();
+    test_append<ds2i::tans_block>();
+}
+
+BOOST_AUTO_TEST_CASE(table_codecs) {
+    test_same_format<ds2i::gamma_block, ds2i::gamma_table_block>();
+    test_same_format<ds2i::rice_block, ds2i::rice_table_block>();
+    test_same_format<ds2i::zeta_block, ds2i::zeta_table_block>();
+}
+
+BOOST_AUTO_TEST_CASE(tans_block) {
+    test_same_format<ds2i::tans_block, ds2i::tans_block, 24>();
+}
+
+BOOST_AUTO_TEST_CASE(mixed_block) {
+    // every block type and parameter the optimizer can choose
+    typedef ds2i::mixed_block codec;
+    std::mt19937 gen(12345);
+    std::vector<size_t> sizes = {1, 16, codec::block_size - 1,
+                                 codec::block_size};
+    // interpolative needs values summing up to less than 2^32
+    for (uint32_t max_bits = 1; max_bits <= 24; ++max_bits) {
+        for (auto size : sizes) {
+            std::vector<uint32_t> values(size);
+            std::generate(values.begin(), values.end(), [&]() {
+                uint64_t bits = gen() % (max_bits + 1);
+                return uint32_t(uint64_t(uint32_t(gen())) >> (32 - bits));
+            });
+            ds2i::time_prediction::feature_vector fv;
+            ds2i::time_prediction::values_statistics(values, fv);
+            for (uint8_t t = 0; t < codec::block_types; ++t) {
+                auto type = (codec::block_type)t;
+                for (codec::compr_param_type param = 0;
+                     param < codec::compr_params(type); ++param) {
+                    std::vector<uint8_t> encoded;
+                    if (!codec::compression_stats(type, param, values.data(),
+                                                  uint32_t(-1), size, encoded,
+                                                  fv)) {
+                        continue;
+                    }
+                    std::vector<uint32_t> decoded(size + codec::overflow);
+                    uint8_t const* out = codec::decode(
+                        encoded.data(), decoded.data(), uint32_t(-1), size);
+                    BOOST_REQUIRE_EQUAL(encoded.size(), out - encoded.data());
+                    BOOST_REQUIRE_EQUAL_COLLECTIONS(
+                        values.begin(), values.end(), decoded.begin(),
+                        decoded.begin() + size);
+                }
+            }
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(simd_bitpacking) {
+    // every bit width, with values using all of them
+    std::mt19937 gen(12345);
+    std::vector<uint32_t> values(ds2i::simd_bitpacking::block_size);
+    std::vector<uint32_t> packed(ds2i::simd_bitpacking::packed_words(32));
+    std::vector<uint32_t> unpacked(values.size());
+    for (uint32_t b = 0; b <= 32; ++b) {
+        uint32_t mask = b == 32 ? uint32_t(-1) : (uint32_t(1) << b) - 1;
+        std::generate(values.begin(), values.end(),
+                      [&]() { return uint32_t(gen()) & mask; });
+        ds2i::simd_bitpacking::pack(values.data(), b, packed.data());
+        ds2i::simd_bitpacking::unpack(packed.data(), b, unpacked.data());
+        BOOST_REQUIRE_EQUAL_COLLECTIONS(values.begin(), values.end(),
+                                        unpacked.begin(), unpacked.end());
+    }
+}
+
+BOOST_AUTO_TEST_CASE(prefix_sum) {
+    std::mt19937 gen(12345);
+    auto prefix_sum = [](std::vector<uint32_t> v, size_t n, uint32_t base) {
+        uint32_t sum = base - 1;
+        for (size_t k = 0; k < n; ++k) {
+            sum += v[k] + 1;
+            v[k] = sum;
+        }
+        return v;
+    };
+
+    for (size_t n = 0; n <= 300; ++n) {
+        std::vector<uint32_t> gaps(n);
+        std::generate(gaps.begin(), gaps.end(),
+                      [&]() { return uint32_t(gen()) & 0xFFFF; });
+        uint32_t base = n % 3 ? uint32_t(gen()) : 0;
+        std::vector<uint32_t> docs(gaps);
+        ds2i::prefix_sum_d1(docs.data(), n, base);
+        auto expected = prefix_sum(gaps, n, base);
+        BOOST_REQUIRE_EQUAL_COLLECTIONS(expected.begin(), expected.end(),
+                                        docs.begin(), docs.end());
+    }
+
+    std::vector<uint32_t> values(ds2i::simd_bitpacking::block_size);
+    std::vector<uint32_t> packed(ds2i::simd_bitpacking::packed_words(32));
+    std::vector<uint32_t> unpacked(values.size());
+    for (uint32_t b = 0; b <= 32; ++b) {
+        uint32_t mask = b == 32 ? uint32_t(-1) : (uint32_t(1) << b) - 1;
+        std::generate(values.begin(), values.end(),
+                      [&]() { return uint32_t(gen()) & mask; });
+        uint32_t base = uint32_t(gen());
+        ds2i::simd_bitpacking::pack(values.data(), b, packed.data());
+        ds2i::simd_bitpacking::unpack_prefix_sum(packed.data(), b,
+                                                 unpacked.data(), base);
+        auto expected = prefix_sum(values, values.size(), base);
+        BOOST_REQUIRE_EQUAL_COLLECTIONS(expected.begin(), expected.end(),
+                                        unpacked.begin(), unpacked.end());
+    }
 }
@@ -4,6 +4,9 @@
 
 #include "block_freq_index.hpp"
 #include "block_codecs.hpp"
+#include "mixed_block.hpp"
+#include "hybrid_block.hpp"
+#include "paired_block.hpp"
 #include <succinct/mapper.hpp>
 
 #include <vector>
@@ -63,4 +66,73 @@ BOOST_AUTO_TEST_CASE(block_freq_index) {
     test_block_freq_index<ds2i::interpolative_block>();
     test_block_freq_index<ds2i::vbyte_block>();
     test_block_freq_index<ds2i::simple16_block>();
+    test_block_freq_index<
+        ds2i::hybrid_block<ds2i::optpfor_block, ds2i::interpolative_block,
+                           ds2i::varint_G8IU_block>>();
+    test_block_freq_index<
+        ds2i::paired_block<ds2i::simdbp128_block, ds2i::simple16_block>>();
+}
+
+BOOST_AUTO_TEST_CASE(mixed_block_transformation) {
+    using ds2i::mixed_block;
+    ds2i::global_parameters params;
+    uint64_t universe = 20000;
+    typedef ds2i::block_freq_index<ds2i::optpfor_block> input_type;
+    typedef ds2i::block_freq_index<mixed_block> collection_type;
+    input_type::builder ib(universe, params);
+
+    typedef std::vector<uint64_t> vec_type;
+    std::vector<std::pair<vec_type, vec_type>> posting_lists(30);
+    for (auto& plist : posting_lists) {
+        double avg_gap = 1.1 + double(rand()) / RAND_MAX * 10;
+        uint64_t n = uint64_t(universe / avg_gap);
+        plist.first = random_sequence(universe, n, true);
+        plist.second.resize(n);
+        std::generate(plist.second.begin(), plist.second.end(),
+                      []() { return (rand() % 256) + 1; });
+
+        ib.add_posting_list(n, plist.first.begin(), plist.second.begin(), 0);
+    }
+    input_type input;
+    ib.build(input);
+
+    // every block gets one of its space/time options, in turn
+    typedef mixed_block::block_transformer<
+        input_type::document_enumerator::block_data>
+        transformer_type;
+    ds2i::predictors_vec_type predictors(mixed_block::block_types);
+    collection_type::builder b(universe, params);
+    std::vector<uint32_t> values;
+    size_t choice = 0;
+    for (size_t i = 0; i < input.size(); ++i) {
+        auto e = input[i];
+        std::vector<transformer_type> blocks;
+        for (auto const& block : e.get_blocks()) {
+            block.decode_doc_gaps(values);
+            auto docs = mixed_block::compute_space_time(
+                values, block.doc_gaps_universe, predictors, 1);
+            block.decode_freqs(values);
+            auto freqs = mixed_block::compute_space_time(values, uint32_t(-1),
+                                                         predictors, 1);
+            auto const& d = docs[choice++ % docs.size()];
+            auto const& f = freqs[choice++ % freqs.size()];
+            blocks.emplace_back(block, d.type, f.type, d.param, f.param);
+        }
+        b.add_posting_list(e.size(), blocks);
+    }
+
+    collection_type coll;
+    b.build(coll);
+    for (size_t i = 0; i < posting_lists.size(); ++i) {
+        auto const& plist = posting_lists[i];
+        auto doc_enum = coll[i];
+        BOOST_REQUIRE_EQUAL(plist.first.size(), doc_enum.size());
+        for (size_t p = 0; p < plist.first.size(); ++p, doc_enum.next()) {
+            MY_REQUIRE_EQUAL(plist.first[p], doc_enum.docid(),
+                             "i = " << i << " p = " << p);
+            MY_REQUIRE_EQUAL(plist.second[p], doc_enum.freq(),
+                             "i = " << i << " p = " << p);
+        }
+        BOOST_REQUIRE_EQUAL(coll.num_docs(), doc_enum.docid());
+    }
 }
@@ -4,6 +4,8 @@
 
 #include "block_posting_list.hpp"
 #include "block_codecs.hpp"
+#include "hybrid_block.hpp"
+#include "paired_block.hpp"
 
 #include <vector>
 #include <cstdlib>
@@ -97,6 +99,65 @@ BOOST_AUTO_TEST_CASE(block_posting_list) {
     test_block_posting_list<ds2i::interpolative_block>();
     test_block_posting_list<ds2i::simple16_block>();
     test_block_posting_list<ds2i::vbyte_block>();
+    test_block_posting_list<ds2i::bitmap_block>();
+    test_block_posting_list<
+        ds2i::hybrid_block<ds2i::optpfor_block, ds2i::interpolative_block,
+                           ds2i::varint_G8IU_block>>();
+    test_block_posting_list<
+        ds2i::paired_block<ds2i::simdbp128_block, ds2i::simple16_block>>();
+    test_block_posting_list<
+        ds2i::paired_block<ds2i::optpfor_block, ds2i::interpolative_block>>();
+}
+
+template <typename BlockCodec>
+size_t encoded_list_size(uint64_t n, std::vector<uint64_t> const& docs,
+                         std::vector<uint64_t> const& freqs) {
+    std::vector<uint8_t> data;
+    ds2i::block_posting_list<BlockCodec>::encode_blocks(data, n, docs.begin(),
+                                                        freqs.begin());
+    return data.size();
+}
+
+BOOST_AUTO_TEST_CASE(hybrid_block_choice) {
+    typedef ds2i::hybrid_block<ds2i::interpolative_block, ds2i::bitmap_block,
+                               ds2i::vbyte_block>
+        codec_type;
+    typedef ds2i::block_posting_list<codec_type> posting_list_type;
+    uint64_t universe = 20000;
+    for (double avg_gap : {1.02, 1.1, 1.5, 4.0, 50.0}) {
+        uint64_t n = uint64_t(universe / avg_gap);
+        std::vector<uint64_t> docs, freqs;
+        random_posting_data(n, universe, docs, freqs);
+        // mostly 1, as in the dense lists
+        std::generate(freqs.begin(), freqs.end(),
+                      []() { return rand() % 4 ? 1 : (rand() % 8) + 1; });
+        std::vector<size_t> sizes = {
+            encoded_list_size<ds2i::interpolative_block>(n, docs, freqs),
+            encoded_list_size<ds2i::bitmap_block>(n, docs, freqs),
+            encoded_list_size<ds2i::vbyte_block>(n, docs, freqs)};
+        size_t smallest =
+            std::min_element(sizes.begin(), sizes.end()) - sizes.begin();
+
+        // the smallest list, preceded by its codec
+        std::vector<uint8_t> data;
+        codec_type::write(data, n, docs.begin(), freqs.begin());
+        BOOST_REQUIRE_EQUAL(smallest, data[0]);
+        BOOST_REQUIRE_EQUAL(sizes[smallest] + 1, data.size());
+        test_block_posting_list_ops<posting_list_type>(data.data(), n,
+                                                       universe, docs, freqs);
+
+        // and the same bytes every time the list is written
+        std::vector<uint8_t> again;
+        codec_type::write(again, n, docs.begin(), freqs.begin());
+        BOOST_REQUIRE(data == again);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(block_posting_list_block_size) {
+    test_block_posting_list<ds2i::basic_optpfor_block<64>>();
+    test_block_posting_list<ds2i::basic_optpfor_block<512>>();
+    test_block_posting_list<ds2i::basic_interpolative_block<256>>();
+    test_block_posting_list<ds2i::basic_qmx_block<256>>();
 }
 
 BOOST_AUTO_TEST_CASE(block_posting_list_reordering) {
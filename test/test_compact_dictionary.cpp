@@ -0,0 +1,176 @@
+#define BOOST_TEST_MODULE compact_dictionary
+
+#include "test_generic_sequence.hpp"
+
+#include "index_types.hpp"
+#include <succinct/mapper.hpp>
+
+#include <boost/filesystem.hpp>
+#include <fstream>
+#include <random>
+#include <vector>
+
+typedef ds2i::single_dictionary_compact_type dictionary_type;
+
+// an entry whose largest value takes exactly the given bytes
+std::vector<uint32_t> random_entry(std::mt19937& gen, uint32_t size,
+                                   uint32_t bytes) {
+    uint64_t max = uint64_t(1) << (8 * bytes);
+    uint64_t min = bytes == 1 ? 0 : uint64_t(1) << (4 * bytes);
+    std::vector<uint32_t> entry(size);
+    for (auto& v : entry) v = uint32_t(gen() % max);
+    entry[gen() % size] = uint32_t(min + gen() % (max - min));
+    return entry;
+}
+
+template <typename Copy>
+void test_copy(dictionary_type const& dict,
+               std::vector<std::vector<uint32_t>> const& entries, Copy copy) {
+    std::vector<uint32_t> out(dictionary_type::max_entry_size);
+    // the runs are written as slots of 0s
+    for (uint32_t i = EXCEPTIONS, size = 256; i != dictionary_type::reserved;
+         ++i, size /= 2) {
+        std::fill(out.begin(), out.end(), uint32_t(-1));
+        BOOST_REQUIRE_EQUAL(size, copy(dict, i, out.data()));
+        for (auto v : out) BOOST_REQUIRE_EQUAL(0, v);
+    }
+    for (size_t e = 0; e < entries.size(); ++e) {
+        auto const& entry = entries[e];
+        std::fill(out.begin(), out.end(), uint32_t(-1));
+        uint32_t i = dictionary_type::reserved + e;
+        BOOST_REQUIRE_EQUAL(entry.size(), copy(dict, i, out.data()));
+        BOOST_REQUIRE_EQUAL_COLLECTIONS(entry.begin(), entry.end(),
+                                        out.begin(),
+                                        out.begin() + entry.size());
+        // the rest of the slot is 0s
+        for (size_t j = entry.size(); j < out.size(); ++j) {
+            BOOST_REQUIRE_EQUAL(0, out[j]);
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(compact_dictionary_copy) {
+    std::mt19937 gen(12345);
+    dictionary_type::builder builder;
+    builder.init();
+    std::vector<std::vector<uint32_t>> entries;
+    for (uint32_t bytes : {1, 2, 4}) {
+        for (uint32_t size = 1; size * bytes <= dictionary_type::slot_bytes;
+             ++size) {
+            for (size_t k = 0; k < 3; ++k) {
+                entries.push_back(random_entry(gen, size, bytes));
+                auto const& entry = entries.back();
+                BOOST_REQUIRE(builder.append(entry.data(), size, 0));
+            }
+        }
+        // one value more does not fit in a slot
+        if (bytes > 1) {
+            auto entry = random_entry(
+                gen, dictionary_type::slot_bytes / bytes + 1, bytes);
+            BOOST_REQUIRE(!builder.append(entry.data(), entry.size(), 0));
+        }
+    }
+
+    std::vector<uint32_t> out(dictionary_type::max_entry_size);
+    for (size_t e = 0; e < entries.size(); ++e) {
+        uint32_t size = builder.get(dictionary_type::reserved + e, out.data());
+        BOOST_REQUIRE_EQUAL_COLLECTIONS(entries[e].begin(), entries[e].end(),
+                                        out.begin(), out.begin() + size);
+    }
+
+    dictionary_type dict;
+    builder.build(dict);
+    test_copy(dict, entries,
+              [](dictionary_type const& d, uint32_t i, uint32_t* out) {
+                  return d.copy(i, out);
+              });
+    test_copy(dict, entries,
+              [](dictionary_type const& d, uint32_t i, uint32_t* out) {
+                  return d.copy_scalar(i, out);
+              });
+#if defined(__SSSE3__)
+    test_copy(dict, entries,
+              [](dictionary_type const& d, uint32_t i, uint32_t* out) {
+                  return d.copy_ssse3(i, out);
+              });
+#endif
+}
+
+void write_sequence(std::ofstream& out, std::vector<uint32_t> const& seq) {
+    uint32_t size = seq.size();
+    out.write(reinterpret_cast<char const*>(&size), sizeof(size));
+    out.write(reinterpret_cast<char const*>(seq.data()),
+              seq.size() * sizeof(seq[0]));
+}
+
+BOOST_AUTO_TEST_CASE(single_compact_dint_index) {
+    typedef ds2i::single_compact_dint_index collection_type;
+    // the dictionaries are built from a collection on disk, and stored
+    // next to it with their statistics: remove those of a previous run
+    std::string basename = "temp_compact_dint";
+    std::vector<boost::filesystem::path> old_files;
+    for (auto const& file : boost::filesystem::directory_iterator(".")) {
+        if (file.path().filename().string().find(basename) !=
+            std::string::npos) {
+            old_files.push_back(file.path());
+        }
+    }
+    for (auto const& path : old_files) boost::filesystem::remove(path);
+
+    uint32_t universe = 20000;
+    typedef std::vector<uint32_t> vec_type;
+    std::vector<std::pair<vec_type, vec_type>> posting_lists(30);
+    {
+        std::ofstream docs_file(basename + ".docs", std::ios::binary);
+        std::ofstream freqs_file(basename + ".freqs", std::ios::binary);
+        write_sequence(docs_file, {universe});
+        for (auto& plist : posting_lists) {
+            double avg_gap = 1.1 + double(rand()) / RAND_MAX * 10;
+            uint64_t n = uint64_t(universe / avg_gap);
+            auto docs = random_sequence(universe, n, true);
+            plist.first.assign(docs.begin(), docs.end());
+            plist.second.resize(n);
+            // mostly small, so that the dictionary has runs and short
+            // entries
+            std::generate(plist.second.begin(), plist.second.end(), []() {
+                return rand() % 4 ? (rand() % 3) + 1 : (rand() % 256) + 1;
+            });
+            write_sequence(docs_file, plist.first);
+            write_sequence(freqs_file, plist.second);
+        }
+    }
+
+    ds2i::global_parameters params;
+    collection_type::builder b(universe, params);
+    b.build_model(basename);
+    for (auto const& plist : posting_lists) {
+        b.add_posting_list(plist.first.size(), plist.first.begin(),
+                           plist.second.begin(), 0);
+    }
+
+    {
+        collection_type coll;
+        b.build(coll);
+        succinct::mapper::freeze(coll, "temp.bin");
+    }
+
+    {
+        collection_type coll;
+        boost::iostreams::mapped_file_source m("temp.bin");
+        succinct::mapper::map(coll, m);
+
+        BOOST_REQUIRE_EQUAL(posting_lists.size(), coll.size());
+        for (size_t i = 0; i < posting_lists.size(); ++i) {
+            auto const& plist = posting_lists[i];
+            auto doc_enum = coll[i];
+            BOOST_REQUIRE_EQUAL(plist.first.size(), doc_enum.size());
+            for (size_t p = 0; p < plist.first.size(); ++p, doc_enum.next()) {
+                MY_REQUIRE_EQUAL(plist.first[p], doc_enum.docid(),
+                                 "i = " << i << " p = " << p);
+                MY_REQUIRE_EQUAL(plist.second[p], doc_enum.freq(),
+                                 "i = " << i << " p = " << p);
+            }
+            BOOST_REQUIRE_EQUAL(coll.num_docs(), doc_enum.docid());
+        }
+    }
+}
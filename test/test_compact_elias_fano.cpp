@@ -86,3 +86,26 @@ BOOST_FIXTURE_TEST_CASE(compact_elias_fano_weakly_monotone,
     std::vector<uint64_t> seq = random_sequence(universe, n, false);
     test_sequence(ds2i::compact_elias_fano(), params, universe, seq);
 }
+
+BOOST_FIXTURE_TEST_CASE(compact_elias_fano_decode, sequence_initialization) {
+    // bulk decoding, also from offsets that are not aligned to words
+    uint32_t base = 5;
+    std::vector<uint64_t> offsets = {0, 7, 63};
+    for (uint64_t offset : offsets) {
+        succinct::bit_vector_builder bvb;
+        bvb.zero_extend(offset);
+        ds2i::compact_elias_fano::write(bvb, seq.begin(), universe, seq.size(),
+                                        params);
+        succinct::bit_vector bv(&bvb);
+        ds2i::compact_elias_fano::enumerator r(bv, offset, universe,
+                                               seq.size(), params);
+        std::vector<uint32_t> out(seq.size());
+        BOOST_REQUIRE_EQUAL(seq.size(),
+                            ds2i::compact_elias_fano::decode(r, base,
+                                                             out.data()));
+        for (size_t i = 0; i < seq.size(); ++i) {
+            MY_REQUIRE_EQUAL(seq[i] + base, out[i],
+                             "offset = " << offset << " i = " << i);
+        }
+    }
+}
@@ -79,3 +79,29 @@ BOOST_FIXTURE_TEST_CASE(compact_ranked_bitvector_enumerator,
                                                  params);
     test_sequence(r, seq);
 }
+
+BOOST_FIXTURE_TEST_CASE(compact_ranked_bitvector_decode,
+                        sequence_initialization) {
+    // bulk decoding, also from offsets that are not aligned to words
+    uint32_t base = 5;
+    std::vector<uint64_t> offsets = {0, 7, 63};
+    for (uint64_t offset : offsets) {
+        succinct::bit_vector_builder bvb;
+        bvb.zero_extend(offset);
+        ds2i::compact_ranked_bitvector::write(bvb, seq.begin(), universe,
+                                              seq.size(), params);
+        // ones after the sequence must not be decoded
+        bvb.append_bits(uint64_t(-1), 64);
+        succinct::bit_vector bv(&bvb);
+        ds2i::compact_ranked_bitvector::enumerator r(bv, offset, universe,
+                                                     seq.size(), params);
+        std::vector<uint32_t> out(seq.size());
+        BOOST_REQUIRE_EQUAL(seq.size(),
+                            ds2i::compact_ranked_bitvector::decode(
+                                r, base, out.data()));
+        for (size_t i = 0; i < seq.size(); ++i) {
+            MY_REQUIRE_EQUAL(seq[i] + base, out[i],
+                             "offset = " << offset << " i = " << i);
+        }
+    }
+}
@@ -0,0 +1,78 @@
+#define BOOST_TEST_MODULE optimal_partition
+
+#include "test_generic_sequence.hpp"
+
+#include "optimal_partition.hpp"
+#include "indexed_sequence.hpp"
+#include <vector>
+#include <cstdlib>
+
+// lists with runs of very different density, so that the partitions are
+// not uniform
+std::vector<uint64_t> random_clustered_sequence(uint64_t n) {
+    srand(42);
+    std::vector<uint64_t> seq;
+    uint64_t value = 0;
+    while (seq.size() < n) {
+        uint64_t run = 1 + rand() % 5000;
+        uint64_t max_gap = 1 + rand() % 200;
+        for (uint64_t i = 0; i < run && seq.size() < n; ++i) {
+            value += 1 + rand() % max_gap;
+            seq.push_back(value);
+        }
+    }
+    return seq;
+}
+
+BOOST_AUTO_TEST_CASE(optimal_partition_segments) {
+    ds2i::global_parameters params;
+    uint64_t fix_cost = 64;
+    double eps1 = 0.03;
+    double eps2 = 0.3;
+    auto cost_fun = [&](uint64_t universe, uint64_t n) {
+        return ds2i::indexed_sequence::bitsize(params, universe, n) +
+               fix_cost;
+    };
+
+    uint64_t n = 300000;
+    auto seq = random_clustered_sequence(n);
+    uint64_t universe = seq.back() + 1;
+    ds2i::optimal_partition opt(seq.begin(), universe, n, cost_fun, eps1,
+                                eps2);
+
+    std::vector<uint64_t> segment_sizes = {1000, 7777, 50000, 150000};
+    for (uint64_t segment_size : segment_sizes) {
+        ds2i::optimal_partition par_opt(seq.begin(), universe, n, cost_fun,
+                                        eps1, eps2, segment_size, 4);
+        auto const& partition = par_opt.partition;
+        BOOST_REQUIRE(!partition.empty());
+        BOOST_REQUIRE_EQUAL(n, partition.back());
+
+        ds2i::cost_t cost = 0;
+        uint64_t begin = 0;
+        for (auto end : partition) {
+            BOOST_REQUIRE(begin < end);
+            uint64_t base = begin ? seq[begin - 1] + 1 : seq[0];
+            cost += cost_fun(seq[end - 1] - base + 1, end - begin);
+            begin = end;
+        }
+        MY_REQUIRE_EQUAL(cost, par_opt.cost_opt,
+                         "segment_size = " << segment_size);
+
+        // about one fix_cost lost per cut at most
+        uint64_t cuts = n / segment_size - 1;
+        MY_REQUIRE_EQUAL(true,
+                         par_opt.cost_opt <=
+                             opt.cost_opt + 2 * cuts * fix_cost,
+                         "segment_size = " << segment_size << " cost = "
+                                           << par_opt.cost_opt
+                                           << " sequential cost = "
+                                           << opt.cost_opt);
+    }
+
+    // short lists are partitioned sequentially
+    ds2i::optimal_partition short_opt(seq.begin(), universe, n, cost_fun, eps1,
+                                      eps2, n, 4);
+    BOOST_REQUIRE(opt.partition == short_opt.partition);
+    BOOST_REQUIRE_EQUAL(opt.cost_opt, short_opt.cost_opt);
+}
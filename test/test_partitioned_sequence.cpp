@@ -7,6 +7,7 @@
 #include "test_generic_sequence.hpp"
 #include "partitioned_sequence.hpp"
 #include "strict_sequence.hpp"
+#include "decode.hpp"
 
 namespace ds2i {
 
@@ -55,6 +56,22 @@ void test_partitioned_sequence(uint64_t universe,
     test_sequence(r, seq);
 }
 
+void test_decode_sequence(uint64_t universe, std::vector<uint64_t> const& seq) {
+    ds2i::global_parameters params;
+    typedef ds2i::partitioned_sequence<ds2i::indexed_sequence> sequence_type;
+
+    succinct::bit_vector_builder bvb;
+    sequence_type::write(bvb, seq.begin(), universe, seq.size(), params);
+    succinct::bit_vector bv(&bvb);
+
+    sequence_type::enumerator r(bv, 0, universe, seq.size(), params);
+    std::vector<uint32_t> out(seq.size());
+    BOOST_REQUIRE_EQUAL(seq.size(), ds2i::decode_sequence(r, out.data()));
+    for (size_t i = 0; i < seq.size(); ++i) {
+        MY_REQUIRE_EQUAL(seq[i], out[i], "i = " << i);
+    }
+}
+
 BOOST_AUTO_TEST_CASE(partitioned_sequence) {
     using ds2i::indexed_sequence;
     using ds2i::strict_sequence;
@@ -93,6 +110,7 @@ BOOST_AUTO_TEST_CASE(partitioned_sequence) {
         auto seq = random_sequence(universe, n, true);
         test_partitioned_sequence<indexed_sequence>(universe, seq);
         test_partitioned_sequence<strict_sequence>(universe, seq);
+        test_decode_sequence(universe, seq);
     }
 
     // test also short (singleton partition) sequences with large universe
@@ -103,5 +121,6 @@ BOOST_AUTO_TEST_CASE(partitioned_sequence) {
         for (auto& v : short_seq) v += initial_gap;
         test_partitioned_sequence<indexed_sequence>(universe, short_seq);
         test_partitioned_sequence<strict_sequence>(universe, short_seq);
+        test_decode_sequence(universe, short_seq);
     }
 }
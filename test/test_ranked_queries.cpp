@@ -2,10 +2,13 @@
 
 #include "succinct/test_common.hpp"
 #include <boost/test/floating_point_comparison.hpp>
+#include <set>
 
 #include "ds2i_config.hpp"
 #include "index_types.hpp"
+#include "pair_index.hpp"
 #include "queries.hpp"
+#include "query_cache.hpp"
 
 namespace ds2i {
 namespace test {
@@ -40,20 +43,31 @@ struct index_initialization {
     std::vector<term_id_vec> queries;
     wand_data<> wdata;
 
-    template <typename QueryOp>
-    void test_against_or(QueryOp& op_q) const {
-        ranked_or_query or_q(wdata, 10);
-
+    template <typename ReferenceOp, typename QueryOp>
+    void test_against(ReferenceOp& ref_q, QueryOp& op_q) const {
         for (auto const& q : queries) {
-            or_q(index, q);
+            ref_q(index, q);
             op_q(index, q);
-            BOOST_REQUIRE_EQUAL(or_q.topk().size(), op_q.topk().size());
-            for (size_t i = 0; i < or_q.topk().size(); ++i) {
-                BOOST_REQUIRE_CLOSE(or_q.topk()[i], op_q.topk()[i],
+            BOOST_REQUIRE_EQUAL(ref_q.topk().size(), op_q.topk().size());
+            for (size_t i = 0; i < ref_q.topk().size(); ++i) {
+                BOOST_REQUIRE_CLOSE(ref_q.topk()[i].first,
+                                    op_q.topk()[i].first,
                                     0.1);  // tolerance is % relative
             }
         }
     }
+
+    template <typename QueryOp>
+    void test_against_or(QueryOp& op_q) const {
+        ranked_or_query or_q(wdata, 10);
+        test_against(or_q, op_q);
+    }
+
+    template <typename QueryOp>
+    void test_against_and(QueryOp& op_q) const {
+        ranked_and_query and_q(wdata, 10);
+        test_against(and_q, op_q);
+    }
 };
 
 }  // namespace test
@@ -64,7 +78,184 @@ BOOST_FIXTURE_TEST_CASE(wand, ds2i::test::index_initialization) {
     test_against_or(wand_q);
 }
 
+BOOST_AUTO_TEST_CASE(topk_queue_ties) {
+    ds2i::topk_queue topk(3);
+    BOOST_REQUIRE(topk.would_enter(0));
+    topk.insert(1.0, 5);
+    topk.insert(3.0, 1);
+    topk.insert(2.0, 4);
+    BOOST_REQUIRE_EQUAL(topk.threshold(), 1.0);
+    BOOST_REQUIRE(!topk.would_enter(1.0));
+    BOOST_REQUIRE(topk.insert(1.0, 2));   // wins the tie against docid 5
+    BOOST_REQUIRE(!topk.insert(1.0, 3));  // loses the tie against docid 2
+    BOOST_REQUIRE(topk.insert(2.0, 7));
+    topk.finalize();
+
+    std::vector<ds2i::topk_queue::entry_type> expected = {
+        {3.0, 1}, {2.0, 4}, {2.0, 7}};
+    BOOST_REQUIRE(topk.topk() == expected);
+}
+
+BOOST_FIXTURE_TEST_CASE(block_max_wand, ds2i::test::index_initialization) {
+    ds2i::block_max_wand_query bmw_q(wdata, 10);
+    test_against_or(bmw_q);
+}
+
 BOOST_FIXTURE_TEST_CASE(maxscore, ds2i::test::index_initialization) {
     ds2i::maxscore_query maxscore_q(wdata, 10);
     test_against_or(maxscore_q);
 }
+
+BOOST_FIXTURE_TEST_CASE(block_max_maxscore,
+                        ds2i::test::index_initialization) {
+    ds2i::block_max_maxscore_query bmm_q(wdata, 10);
+    test_against_or(bmm_q);
+}
+
+BOOST_FIXTURE_TEST_CASE(block_max_ranked_and,
+                        ds2i::test::index_initialization) {
+    ds2i::block_max_ranked_and_query bma_q(wdata, 10);
+    test_against_and(bma_q);
+}
+
+BOOST_FIXTURE_TEST_CASE(block_max_wand_variable_blocks,
+                        ds2i::test::index_initialization) {
+    ds2i::block_max_parameters block_params;
+    block_params.variable_blocks = true;
+    ds2i::wand_data<> variable_wdata(document_sizes.begin()->begin(),
+                                     collection.num_docs(), collection,
+                                     block_params);
+    ds2i::block_max_wand_query bmw_q(variable_wdata, 10);
+    test_against_or(bmw_q);
+    ds2i::block_max_maxscore_query bmm_q(variable_wdata, 10);
+    test_against_or(bmm_q);
+}
+
+BOOST_FIXTURE_TEST_CASE(parallel_ranked_queries,
+                        ds2i::test::index_initialization) {
+    for (size_t threads : {1, 2, 5}) {
+        ds2i::parallel_ranked_query<ds2i::wand_query> wand_q(
+            ds2i::wand_query(wdata, 10), 10, threads);
+        test_against_or(wand_q);
+        ds2i::parallel_ranked_query<ds2i::ranked_or_query> or_q(
+            ds2i::ranked_or_query(wdata, 10), 10, threads);
+        test_against_or(or_q);
+    }
+}
+
+BOOST_FIXTURE_TEST_CASE(impact_queries, ds2i::test::index_initialization) {
+    ds2i::impact_quantizer<> quantizer(collection.num_docs(), 16);
+    index_type::builder builder(collection.num_docs(), params);
+    for (auto const& plist : collection) {
+        auto impacts_it = ds2i::impacts_begin(plist, collection.num_docs(),
+                                              wdata, quantizer);
+        uint64_t impacts_sum = 0;
+        auto it = impacts_it;
+        for (size_t i = 0; i < plist.docs.size(); ++i, ++it) {
+            impacts_sum += *it;
+        }
+        builder.add_posting_list(plist.docs.size(), plist.docs.begin(),
+                                 impacts_it, impacts_sum);
+    }
+    index_type impact_index;
+    builder.build(impact_index);
+
+    ds2i::ranked_or_query or_q(wdata, 10);
+    ds2i::ranked_or_impact_query or_impact_q(10);
+    ds2i::wand_impact_query wand_impact_q(wdata, quantizer, 10);
+    for (auto const& q : queries) {
+        or_q(index, q);
+        or_impact_q(impact_index, q);
+        wand_impact_q(impact_index, q);
+        BOOST_REQUIRE(or_impact_q.topk() == wand_impact_q.topk());
+        BOOST_REQUIRE_EQUAL(or_q.topk().size(), or_impact_q.topk().size());
+        for (size_t i = 0; i < or_q.topk().size(); ++i) {
+            BOOST_REQUIRE_CLOSE(
+                or_q.topk()[i].first,
+                quantizer.dequantize(or_impact_q.topk()[i].first), 0.1);
+        }
+    }
+}
+
+BOOST_FIXTURE_TEST_CASE(cached_queries, ds2i::test::index_initialization) {
+    using ds2i::query_cache;
+    for (auto policy : {query_cache::policy_type::lru,
+                        query_cache::policy_type::slru,
+                        query_cache::policy_type::static_dynamic}) {
+        // the small cache keeps evicting, the large one holds every query
+        for (uint64_t capacity : {ds2i::constants::KiB, ds2i::constants::MiB}) {
+            query_cache cache(policy, capacity);
+            cache.set_static_queries(queries);
+            ds2i::cached_query<ds2i::wand_query> wand_q(
+                ds2i::wand_query(wdata, 10), cache);
+            test_against_or(wand_q);
+            test_against_or(wand_q);
+            BOOST_REQUIRE_EQUAL(cache.lookups(), 2 * queries.size());
+            if (capacity == ds2i::constants::MiB) {
+                BOOST_REQUIRE_GE(cache.hits(), queries.size());
+            }
+
+            cache.clear();
+            ds2i::and_query<false> and_q;
+            ds2i::cached_query<ds2i::and_query<false>> cached_and_q(and_q,
+                                                                    cache);
+            for (int run = 0; run < 2; ++run) {
+                for (auto const& q : queries) {
+                    BOOST_REQUIRE_EQUAL(and_q(index, q),
+                                        cached_and_q(index, q));
+                }
+            }
+        }
+    }
+}
+
+BOOST_FIXTURE_TEST_CASE(pair_queries, ds2i::test::index_initialization) {
+    typedef ds2i::pair_index<index_type> pair_index_type;
+    pair_index_type::builder builder(collection.num_docs(), params);
+    // store the first two terms of every other query, so that some queries
+    // are not covered
+    std::set<uint64_t> added;
+    for (size_t i = 0; i < queries.size(); i += 2) {
+        auto terms = queries[i];
+        ds2i::remove_duplicate_terms(terms);
+        if (terms.size() < 2 ||
+            !added.insert(pair_index_type::pair_key(terms[0], terms[1]))
+                 .second) {
+            continue;
+        }
+        auto first = index[terms[0]];
+        auto second = index[terms[1]];
+        std::vector<uint64_t> docs, first_freqs, second_freqs;
+        while (first.docid() < index.num_docs() &&
+               second.docid() < index.num_docs()) {
+            if (first.docid() < second.docid()) {
+                first.next_geq(second.docid());
+            } else if (second.docid() < first.docid()) {
+                second.next_geq(first.docid());
+            } else {
+                docs.push_back(first.docid());
+                first_freqs.push_back(first.freq());
+                second_freqs.push_back(second.freq());
+                first.next();
+                second.next();
+            }
+        }
+        if (!docs.empty()) {
+            builder.add_pair(terms[0], terms[1], docs, first_freqs,
+                             second_freqs);
+        }
+    }
+    pair_index_type pairs;
+    builder.build(pairs);
+    BOOST_REQUIRE(pairs.size() > 0);
+
+    ds2i::and_query<false> and_q;
+    ds2i::pair_and_query<pair_index_type, false> pair_and_q(pairs);
+    for (auto const& q : queries) {
+        BOOST_REQUIRE_EQUAL(and_q(index, q), pair_and_q(index, q));
+    }
+
+    ds2i::pair_ranked_and_query<pair_index_type> pair_ranked_and_q(pairs,
+                                                                   wdata, 10);
+    test_against_and(pair_ranked_and_q);
+}
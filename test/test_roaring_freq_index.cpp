@@ -0,0 +1,158 @@
+#define BOOST_TEST_MODULE roaring_freq_index
+
+#include "test_generic_sequence.hpp"
+
+#include "roaring_freq_index.hpp"
+#include "block_codecs.hpp"
+#include <succinct/mapper.hpp>
+
+#include <vector>
+#include <cstdlib>
+#include <algorithm>
+#include <iterator>
+
+typedef std::vector<uint64_t> vec_type;
+
+// lists from very dense (bitmap containers) to sparse (array containers),
+// on a universe of several containers
+std::vector<std::pair<vec_type, vec_type>> random_posting_lists(
+    uint64_t universe) {
+    std::vector<std::pair<vec_type, vec_type>> posting_lists(30);
+    for (auto& plist : posting_lists) {
+        double avg_gap = 1.1 + double(rand()) / RAND_MAX * 100;
+        uint64_t n = uint64_t(universe / avg_gap);
+        plist.first = random_sequence(universe, n, true);
+        plist.second.resize(n);
+        std::generate(plist.second.begin(), plist.second.end(),
+                      []() { return (rand() % 256) + 1; });
+    }
+    return posting_lists;
+}
+
+template <typename FreqsCodec>
+void test_roaring_freq_index() {
+    ds2i::global_parameters params;
+    uint64_t universe = 300000;
+    typedef ds2i::roaring_freq_index<FreqsCodec> collection_type;
+    typename collection_type::builder b(universe, params);
+
+    auto posting_lists = random_posting_lists(universe);
+    for (auto const& plist : posting_lists) {
+        b.add_posting_list(plist.first.size(), plist.first.begin(),
+                           plist.second.begin(), 0);
+    }
+
+    {
+        collection_type coll;
+        b.build(coll);
+        succinct::mapper::freeze(coll, "temp.bin");
+    }
+
+    {
+        collection_type coll;
+        boost::iostreams::mapped_file_source m("temp.bin");
+        succinct::mapper::map(coll, m);
+
+        for (size_t i = 0; i < posting_lists.size(); ++i) {
+            auto const& plist = posting_lists[i];
+            auto doc_enum = coll[i];
+            BOOST_REQUIRE_EQUAL(plist.first.size(), doc_enum.size());
+            for (size_t p = 0; p < plist.first.size(); ++p, doc_enum.next()) {
+                MY_REQUIRE_EQUAL(plist.first[p], doc_enum.docid(),
+                                 "i = " << i << " p = " << p);
+                MY_REQUIRE_EQUAL(plist.second[p], doc_enum.freq(),
+                                 "i = " << i << " p = " << p);
+            }
+            BOOST_REQUIRE_EQUAL(coll.num_docs(), doc_enum.docid());
+
+            // the positions after next_geq are those of the docids found
+            doc_enum.reset();
+            for (uint64_t lower_bound = 0; lower_bound < universe;
+                 lower_bound += rand() % 3000) {
+                doc_enum.next_geq(lower_bound);
+                auto it = std::lower_bound(plist.first.begin(),
+                                           plist.first.end(), lower_bound);
+                if (it == plist.first.end()) {
+                    BOOST_REQUIRE_EQUAL(coll.num_docs(), doc_enum.docid());
+                    break;
+                }
+                uint64_t p = it - plist.first.begin();
+                MY_REQUIRE_EQUAL(*it, doc_enum.docid(),
+                                 "i = " << i << " lower_bound = "
+                                        << lower_bound);
+                MY_REQUIRE_EQUAL(p, doc_enum.position(),
+                                 "i = " << i << " lower_bound = "
+                                        << lower_bound);
+                MY_REQUIRE_EQUAL(plist.second[p], doc_enum.freq(),
+                                 "i = " << i << " p = " << p);
+            }
+
+            for (size_t t = 0; t < 100; ++t) {
+                uint64_t p = rand() % plist.first.size();
+                doc_enum.move(p);
+                MY_REQUIRE_EQUAL(plist.first[p], doc_enum.docid(),
+                                 "i = " << i << " p = " << p);
+                MY_REQUIRE_EQUAL(plist.second[p], doc_enum.freq(),
+                                 "i = " << i << " p = " << p);
+            }
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(roaring_freq_index) {
+    test_roaring_freq_index<ds2i::optpfor_block>();
+    test_roaring_freq_index<ds2i::simple16_block>();
+    test_roaring_freq_index<ds2i::interpolative_block>();
+}
+
+BOOST_AUTO_TEST_CASE(roaring_boolean_queries) {
+    ds2i::global_parameters params;
+    uint64_t universe = 300000;
+    typedef ds2i::roaring_freq_index<ds2i::optpfor_block> collection_type;
+    collection_type::builder b(universe, params);
+
+    auto posting_lists = random_posting_lists(universe);
+    for (auto const& plist : posting_lists) {
+        b.add_posting_list(plist.first.size(), plist.first.begin(),
+                           plist.second.begin(), 0);
+    }
+    collection_type coll;
+    b.build(coll);
+
+    std::vector<uint32_t> out(universe);
+    std::vector<collection_type::document_enumerator> enums;
+    for (size_t q = 0; q < 50; ++q) {
+        enums.clear();
+        vec_type expected_and, expected_or;
+        size_t terms = 1 + rand() % 4;
+        for (size_t t = 0; t < terms; ++t) {
+            auto const& docs = posting_lists[rand() % posting_lists.size()];
+            enums.push_back(coll[&docs - posting_lists.data()]);
+            vec_type tmp;
+            if (!t) {
+                expected_and = docs.first;
+                expected_or = docs.first;
+                continue;
+            }
+            std::set_intersection(expected_and.begin(), expected_and.end(),
+                                  docs.first.begin(), docs.first.end(),
+                                  std::back_inserter(tmp));
+            expected_and.swap(tmp);
+            tmp.clear();
+            std::set_union(expected_or.begin(), expected_or.end(),
+                           docs.first.begin(), docs.first.end(),
+                           std::back_inserter(tmp));
+            expected_or.swap(tmp);
+        }
+
+        uint64_t size = ds2i::roaring_intersection(enums, out.data());
+        BOOST_REQUIRE_EQUAL(expected_and.size(), size);
+        BOOST_REQUIRE(
+            std::equal(expected_and.begin(), expected_and.end(), out.begin()));
+
+        size = ds2i::roaring_union(enums, out.data());
+        BOOST_REQUIRE_EQUAL(expected_or.size(), size);
+        BOOST_REQUIRE(
+            std::equal(expected_or.begin(), expected_or.end(), out.begin()));
+    }
+}